@@ -157,6 +157,14 @@ Line GitGraph::addCommit(const std::string& commit,
    return result;
 }
 
+GitGraphState GitGraph::state() const
+{
+   GitGraphState state;
+   state.nextColumnId = nextColumnId_;
+   state.pendingLine = pendingLine_;
+   return state;
+}
+
 } // namespace gitgraph
 } // namespace core
 } // namespace rstudio
@@ -0,0 +1,94 @@
+/*
+ * GitGraphTests.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <core/GitGraph.hpp>
+
+namespace rstudio {
+namespace core {
+namespace gitgraph {
+
+namespace {
+
+// a small history with a merge:
+//
+//   e (merge of d and c)
+//   d
+//   c
+//   b
+//   a (root)
+//
+struct Commit
+{
+   const char* id;
+   std::vector<std::string> parents;
+};
+
+std::vector<Commit> history()
+{
+   return {
+      { "e", { "d", "c" } },
+      { "d", { "b" } },
+      { "c", { "b" } },
+      { "b", { "a" } },
+      { "a", {} }
+   };
+}
+
+} // anonymous namespace
+
+test_context("Git Graph")
+{
+   test_that("Graph lines are produced for linear and merged history")
+   {
+      GitGraph graph;
+      std::vector<std::string> lines;
+      for (const Commit& commit : history())
+         lines.push_back(graph.addCommit(commit.id, commit.parents).string());
+
+      expect_true(lines[0] == "*+0 +1");
+      expect_true(lines[lines.size() - 1] == "*-0");
+   }
+
+   test_that("Resuming a graph from saved state produces the same lines")
+   {
+      std::vector<Commit> commits = history();
+
+      GitGraph graph;
+      std::vector<std::string> expected;
+      for (const Commit& commit : commits)
+         expected.push_back(graph.addCommit(commit.id, commit.parents).string());
+
+      for (std::size_t split = 0; split <= commits.size(); split++)
+      {
+         std::vector<std::string> lines;
+
+         GitGraph first;
+         for (std::size_t i = 0; i < split; i++)
+            lines.push_back(first.addCommit(commits[i].id, commits[i].parents).string());
+
+         GitGraph resumed(first.state());
+         for (std::size_t i = split; i < commits.size(); i++)
+            lines.push_back(resumed.addCommit(commits[i].id, commits[i].parents).string());
+
+         expect_true(lines == expected);
+      }
+   }
+}
+
+} // namespace gitgraph
+} // namespace core
+} // namespace rstudio
@@ -15,17 +15,52 @@
 
 #include <core/Settings.hpp>
 
+#ifndef _WIN32
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
 #include <core/Log.hpp>
 #include <shared_core/FilePath.hpp>
 #include <shared_core/SafeConvert.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/system/System.hpp>
 
 namespace rstudio {
 namespace core {
 
+namespace {
+
+// flush the contents of a file (or directory entry) to disk
+Error syncPath(const FilePath& filePath)
+{
+#ifndef _WIN32
+   int fd = ::open(filePath.getAbsolutePath().c_str(), O_RDONLY);
+   if (fd == -1)
+      return systemError(errno, ERROR_LOCATION);
+
+   int result = ::fsync(fd);
+   int errorNumber = errno;
+   ::close(fd);
+
+   if (result == -1)
+      return systemError(errorNumber, ERROR_LOCATION);
+#endif
+
+   // NOTE: on Windows the rename below is already write-through for the
+   // directory entry and we don't have a handle with which to flush the
+   // file contents, so this is a no-op
+   return Success();
+}
+
+} // anonymous namespace
+
 Settings::Settings()
    : updatePending_(false),
-     isDirty_(false)
+     isDirty_(false),
+     writeBehind_(false),
+     syncOnWrite_(false),
+     flushRequested_(false)
 {
 }
 
@@ -60,7 +95,7 @@ void Settings::set(const std::string& name, const std::string& value)
       isDirty_ = true;
       
       if (!updatePending_)
-         writeSettings();
+         requestWrite();
    }
 }
    
@@ -143,19 +178,84 @@ void Settings::endUpdate()
 {
    updatePending_ = false;
    if (isDirty_)
-      writeSettings();
+      requestWrite();
 }
 
-void Settings::writeSettings() 
+void Settings::setWriteBehind(const boost::function<void()>& onDirty)
 {
-   isDirty_ = false;
-   Error error = core::writeStringMapToFile(settingsFile_, settingsMap_);
-   if (error)
-     LOG_ERROR(error);
+   writeBehind_ = true;
+   onDirty_ = onDirty;
 }
 
+Error Settings::flush()
+{
+   flushRequested_ = false;
+   if (!isDirty_)
+      return Success();
+
+   return writeSettings();
+}
 
+void Settings::requestWrite()
+{
+   if (writeBehind_)
+   {
+      // only notify once per flush; subsequent changes are picked up
+      // by the flush that is already pending
+      if (!flushRequested_)
+      {
+         flushRequested_ = true;
+         if (onDirty_)
+            onDirty_();
+      }
+   }
+   else
+   {
+      Error error = writeSettings();
+      if (error)
+         LOG_ERROR(error);
+   }
 }
+
+Error Settings::writeSettings() 
+{
+   // write to a temporary file and then rename it over the settings file,
+   // so that a reader (or a crash mid-write) never sees a partial file
+   FilePath tempFile(settingsFile_.getAbsolutePath() + ".tmp-" +
+                     safe_convert::numberToString(core::system::currentProcessId()));
+
+   Error error = core::writeStringMapToFile(tempFile, settingsMap_);
+   if (error)
+   {
+      tempFile.removeIfExists();
+      return error;
+   }
+
+   if (syncOnWrite_)
+   {
+      error = syncPath(tempFile);
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   error = tempFile.move(settingsFile_, FilePath::MoveDirect);
+   if (error)
+   {
+      tempFile.removeIfExists();
+      return error;
+   }
+
+   if (syncOnWrite_)
+   {
+      error = syncPath(settingsFile_.getParent());
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   isDirty_ = false;
+   return Success();
 }
 
 
+}
+}
@@ -0,0 +1,138 @@
+/*
+ * SettingsTests.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <map>
+
+#include <boost/bind/bind.hpp>
+
+#include <core/Settings.hpp>
+#include <core/FileSerializer.hpp>
+
+#include <shared_core/Error.hpp>
+#include <shared_core/FilePath.hpp>
+
+namespace rstudio {
+namespace core {
+
+namespace {
+
+void increment(int* pCount)
+{
+   ++*pCount;
+}
+
+// a burst of sets, like those made while a session starts up
+void setStartupState(Settings* pSettings)
+{
+   pSettings->set("active-client-id", std::string("7e9a41c2-0c4b-4bd9-a0b8-5d6e1f0a2b3c"));
+   pSettings->set("abend", true);
+   pSettings->set("activeClientUrl", std::string("http://localhost:8787/"));
+   pSettings->set("activeEnvironmentName", std::string("R_GlobalEnv"));
+   pSettings->set("portToken", std::string("d4c1b2a3"));
+   pSettings->set("environmentMonitoring", true);
+   pSettings->set("packratLibraryHash", std::string("0123456789abcdef"));
+   pSettings->set("packratLockfileHash", std::string("fedcba9876543210"));
+   pSettings->set("displayName", std::string("Test User"));
+}
+
+} // anonymous namespace
+
+test_context("Settings")
+{
+   FilePath settingsDir;
+   expect_false(FilePath::tempFilePath(settingsDir));
+   expect_false(settingsDir.ensureDirectory());
+   FilePath settingsFile = settingsDir.completeChildPath("settings");
+
+   test_that("Changes are written immediately by default")
+   {
+      Settings settings;
+      expect_false(settings.initialize(settingsFile));
+
+      settings.set("name", std::string("value"));
+      expect_false(settings.isDirty());
+
+      std::map<std::string, std::string> written;
+      expect_false(readStringMapFromFile(settingsFile, &written));
+      expect_true(written["name"] == "value");
+   }
+
+   test_that("Write-behind settings are only written when flushed")
+   {
+      expect_false(settingsFile.removeIfExists());
+
+      int flushRequests = 0;
+      Settings settings;
+      expect_false(settings.initialize(settingsFile));
+      settings.setWriteBehind(boost::bind(increment, &flushRequests));
+
+      setStartupState(&settings);
+      expect_true(settings.isDirty());
+      expect_true(flushRequests == 1);
+      expect_false(settingsFile.exists());
+
+      expect_false(settings.flush());
+      expect_false(settings.isDirty());
+      std::map<std::string, std::string> written;
+      expect_false(readStringMapFromFile(settingsFile, &written));
+      expect_true(written.size() == 9);
+      expect_true(written["portToken"] == "d4c1b2a3");
+
+      // flushing again without changes doesn't write the file again
+      expect_false(settingsFile.remove());
+      expect_false(settings.flush());
+      expect_false(settingsFile.exists());
+
+      // a new change requests a new flush
+      settings.set("abend", false);
+      expect_true(flushRequests == 2);
+
+      // batched updates request a single flush
+      settings.beginUpdate();
+      settings.set("a", 1);
+      settings.set("b", 2);
+      settings.endUpdate();
+      expect_true(flushRequests == 2);
+
+      expect_false(settings.flush());
+
+      Settings reloaded;
+      expect_false(reloaded.initialize(settingsFile));
+      expect_true(reloaded.get("activeEnvironmentName") == "R_GlobalEnv");
+      expect_true(reloaded.getBool("abend", true) == false);
+      expect_true(reloaded.getInt("b") == 2);
+   }
+
+   test_that("Writes replace the settings file without leaving temporary files")
+   {
+      Settings settings;
+      expect_false(settings.initialize(settingsFile));
+      settings.setSyncOnWrite(true);
+      settings.set("name", std::string("replaced"));
+
+      std::vector<FilePath> children;
+      expect_false(settingsDir.getChildren(children));
+      expect_true(children.size() == 1);
+      expect_true(children[0].getFilename() == "settings");
+      expect_true(settings.get("name") == "replaced");
+   }
+
+   settingsDir.removeIfExists();
+}
+
+} // end namespace core
+} // end namespace rstudio
@@ -55,17 +55,22 @@ Error writeCollectionToFile(
 
    try
    {
-      // write each line
+      // write each line (buffered, so that the file is written with as
+      // few system calls as possible rather than one per line)
       for (typename CollectionType::const_iterator
             it = collection.begin();
             it != collection.end();
             ++it)
       {
-         *pOfs << stringifyFunction(*it) << std::endl;
+         *pOfs << stringifyFunction(*it) << '\n';
 
         if (pOfs->fail())
              return systemError(io_error, ERROR_LOCATION);
       }
+
+      pOfs->flush();
+      if (pOfs->fail())
+         return systemError(io_error, ERROR_LOCATION);
    }
    catch(const std::exception& e)
    {
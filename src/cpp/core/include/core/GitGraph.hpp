@@ -56,6 +56,18 @@ public:
    std::string string() const;
 };
 
+// The state of a graph between calls to addCommit; this can be saved
+// so that a graph can later be resumed (e.g. when a subsequent page of
+// history is requested).
+struct GitGraphState
+{
+   GitGraphState() : nextColumnId(0)
+   {}
+
+   int nextColumnId;
+   Line pendingLine;
+};
+
 // Encapsulates the state and logic used to build up a graph,
 // based on repeated calls with commit-and-parent info.
 // This class doesn't hold all of the result lines; the caller
@@ -67,6 +79,11 @@ public:
    GitGraph() : nextColumnId_(0)
    {}
 
+   // Resume a graph from previously saved state.
+   explicit GitGraph(const GitGraphState& state)
+      : nextColumnId_(state.nextColumnId), pendingLine_(state.pendingLine)
+   {}
+
    // Call addCommit to yield the next line of the graph.
    // Note that GitGraph is stateful; each call to addCommit
    // builds on the state of previous calls to addCommit.
@@ -75,6 +92,9 @@ public:
    Line addCommit(const std::string& commit,
                   const std::vector<std::string>& parents);
 
+   // Save the current state of the graph.
+   GitGraphState state() const;
+
 private:
    int nextColumnId_;
    Line pendingLine_;
@@ -57,16 +57,36 @@ public:
    void beginUpdate();
    void endUpdate();
 
+   // write-behind mode: changes are held in memory until flush() is called
+   // rather than being written on every set. onDirty is called whenever the
+   // settings go from clean to dirty so the owner can schedule a flush (the
+   // owner is also responsible for flushing before suspend and exit)
+   void setWriteBehind(const boost::function<void()>& onDirty);
+
+   // whether writes are synced to disk before replacing the settings file
+   // (off by default; on network filesystems a sync is a round trip)
+   void setSyncOnWrite(bool syncOnWrite) { syncOnWrite_ = syncOnWrite; }
+
+   // write pending changes (if any)
+   Error flush();
+
+   bool isDirty() const { return isDirty_; }
+
    const FilePath& filePath() const { return settingsFile_; }
 
 private:
-   void writeSettings();
+   void requestWrite();
+   Error writeSettings();
 
 private:
    FilePath settingsFile_;
    std::map<std::string, std::string> settingsMap_;
    bool updatePending_;
    bool isDirty_;
+   bool writeBehind_;
+   bool syncOnWrite_;
+   bool flushRequested_;
+   boost::function<void()> onDirty_;
 };
 
 }
@@ -110,6 +110,24 @@ public:
       END_LOCK_MUTEX
    }
 
+   void clear()
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         // break the links between nodes so that they can be freed
+         for (auto& entry : map_)
+         {
+            entry.second->pLeft.reset();
+            entry.second->pRight.reset();
+         }
+
+         map_.clear();
+         frontNode_.reset();
+         backNode_.reset();
+      }
+      END_LOCK_MUTEX
+   }
+
    size_t size()
    {
       LOCK_MUTEX(mutex_)
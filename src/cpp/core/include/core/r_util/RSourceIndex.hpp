@@ -197,6 +197,11 @@ public:
    RSourceIndex(const std::string& context,
                 const std::string& code);
 
+   // index pre-tokenized code; the tokens must have been produced with
+   // both RTokens::StripWhitespace and RTokens::StripComments
+   RSourceIndex(const std::string& context,
+                const RTokens& rTokens);
+
    const std::string& context() const { return context_; }
 
    template <typename OutputIterator>
@@ -271,6 +276,8 @@ public:
    }
    
 private:
+   void index(const RTokens& rTokens);
+   
    RSourceItem noSuchItem_;
    
    const RSourceItem& get(const std::string& name,
@@ -279,13 +279,21 @@ public:
    {
       while (RToken token = tokenizer_.nextToken())
       {
-         if ((flags & StripWhitespace) && token.type() == RToken::WHITESPACE)
-            continue;
-
-         if ((flags & StripComments) && token.type() == RToken::COMMENT)
-            continue;
+         if (!isStripped(token, flags))
+            push_back(token);
+      }
+   }
 
-         push_back(token);
+   // A view of already tokenized code, without the tokens stripped by the
+   // given flags. The tokens still refer to the code held by 'tokens', which
+   // must outlive the view.
+   RTokens(const RTokens& tokens, int flags)
+      : tokenizer_(std::wstring())
+   {
+      for (const RToken& token : tokens)
+      {
+         if (!isStripped(token, flags))
+            push_back(token);
       }
    }
    
@@ -297,6 +305,13 @@ public:
       return os;
    }
 
+private:
+   static bool isStripped(const RToken& token, int flags)
+   {
+      return ((flags & StripWhitespace) && token.type() == RToken::WHITESPACE) ||
+             ((flags & StripComments) && token.type() == RToken::COMMENT);
+   }
+
 private:
     RTokenizer tokenizer_;
     Tokens tokens_;
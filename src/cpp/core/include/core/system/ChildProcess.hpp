@@ -212,8 +212,14 @@ public:
       }
    }
 
-   // poll for input and exit status
-   void poll();
+   // poll for input and exit status. when pollIO is false only the
+   // periodic callbacks (onContinue, subprocess and cwd tracking) are run;
+   // this is used by the supervisor for children it knows to be idle
+   void poll(bool pollIO = true);
+
+   // descriptors which become readable when the child has output
+   // or has exited (empty if not supported on this platform)
+   std::vector<int> activityDescriptors() const;
 
    // has it exited?
    virtual bool exited();
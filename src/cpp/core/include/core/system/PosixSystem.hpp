@@ -251,6 +251,37 @@ std::vector<SubprocInfo> getSubprocessesViaPgrep(PidType pid);
 // subprocesses or unable to determine if there are subprocesses
 #ifndef __APPLE__
 std::vector<SubprocInfo> getSubprocessesViaProcFs(PidType pid);
+
+// Are the per-thread /proc/<pid>/task/<tid>/children lists available?
+// (they require a kernel built with CONFIG_PROC_CHILDREN)
+bool hasProcChildren();
+
+// Reads the children of each of a process's threads from their procfs
+// children lists, optionally counting the files read
+void readProcChildren(PidType pid,
+                      std::vector<PidType>* pChildren,
+                      std::size_t* pFilesRead = nullptr);
+
+// Detect subprocesses by reading the process' /proc/<pid>/task/*/children
+// lists; much cheaper than scanning all of procfs, but requires a kernel
+// built with CONFIG_PROC_CHILDREN
+std::vector<SubprocInfo> getSubprocessesViaProcChildren(PidType pid);
+
+// Cumulative cost of procfs-based subprocess detection
+struct SubprocScanStatistics
+{
+   SubprocScanStatistics()
+      : scans(0), fullScans(0), filesRead(0), elapsedMicroseconds(0)
+   {
+   }
+
+   std::size_t scans;
+   std::size_t fullScans;
+   std::size_t filesRead;
+   std::size_t elapsedMicroseconds;
+};
+
+SubprocScanStatistics subprocessScanStatistics();
 #endif // !__APPLE__
 
 #ifdef __APPLE__
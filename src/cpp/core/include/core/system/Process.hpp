@@ -418,6 +418,10 @@ public:
    // Check whether any children are currently running
    bool hasRunningChildren();
 
+   // Get the process ids of all running children (e.g. for resource
+   // accounting of their process trees)
+   std::vector<PidType> childPids();
+
    // Check whether any children consider themselves active; non-active
    // processes may be terminated without warning.
    bool hasActiveChildren();
@@ -426,6 +430,15 @@ public:
    // are still children being supervised after the poll
    bool poll();
 
+   // Watch children started after this call for output and exit from a
+   // background thread, invoking onActivity (on that thread) whenever a
+   // child has events pending. Once enabled, poll() only reads from and
+   // reaps children which have reported activity (plus a periodic sweep of
+   // all children), so the caller can wake up to call poll() promptly
+   // rather than depending on its polling interval. Not supported on all
+   // platforms, in which case all children continue to be polled.
+   void setActivityHandler(const boost::function<void()>& onActivity);
+
    // Terminate all running children
    void terminateAll();
 
@@ -16,7 +16,11 @@
 #ifndef CORE_SYSTEM_RESOURCES_HPP
 #define CORE_SYSTEM_RESOURCES_HPP
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
+#include <core/system/System.hpp>
 
 namespace rstudio {
 namespace core {
@@ -67,6 +71,28 @@ Error getTotalMemoryUsed(long *pUsedKb, MemoryProvider *pProvider);
 // RAM) or a virtual one (e.g., a cgroup-imposed limit)
 Error getTotalMemory(long *pTotalKb, MemoryProvider *pProvider);
 
+// Resources used by a process together with all of its descendants.
+struct ProcessTreeResourceUsage
+{
+   ProcessTreeResourceUsage()
+      : pid(0), processes(0), cpuSeconds(0), residentKb(0), readBytes(0), writeBytes(0)
+   {
+   }
+
+   PidType pid;            // root of the process tree
+   std::string name;       // command name of the root process
+   int processes;          // number of (live) processes in the tree
+   double cpuSeconds;      // user + system CPU time consumed
+   long residentKb;        // resident set size
+   uint64_t readBytes;     // bytes read from storage
+   uint64_t writeBytes;    // bytes written to storage
+};
+
+// Returns the resources used by each of the given processes and their descendants; processes
+// which have exited are omitted. Currently only supported on Linux.
+Error getProcessTreeResourceUsage(const std::vector<PidType>& pids,
+                                  std::vector<ProcessTreeResourceUsage>* pUsage);
+
 } // namespace system
 } // namespace core
 } // namespace rstudio
@@ -39,6 +39,17 @@ std::string stripSecondaryBuffer(
       const std::string& str, // string to parse
       bool* pAltModeActive); // (optional in/out) is string "in" alt-buffer mode?
 
+// Discard all but the final maxLines lines of output bound for a terminal
+// whose scrollback holds maxLines lines, i.e. the part of the output which
+// would immediately scroll out of the terminal anyway. Output which is
+// (or switches into or out of) the alt-buffer is left alone, as full-screen
+// programs rely on every escape sequence reaching the terminal. Returns
+// true if the output was trimmed.
+bool trimScrolledOutput(
+      int maxLines,
+      bool altModeActive, // is the terminal in alt-buffer mode?
+      std::string* pOutput);
+
 } // namespace text
 } // namespace core
 } // namespace rstudio
@@ -552,18 +552,30 @@ std::vector<Indexer> makeIndexers()
 
 RSourceIndex::RSourceIndex(const std::string& context, const std::string& code)
    : context_(context)
+{
+   // tokenize and index
+   std::wstring wCode = string_utils::utf8ToWide(code, context);
+   RTokens rTokens(wCode, RTokens::StripWhitespace | RTokens::StripComments);
+   index(rTokens);
+}
+
+RSourceIndex::RSourceIndex(const std::string& context, const RTokens& rTokens)
+   : context_(context)
+{
+   index(rTokens);
+}
+
+void RSourceIndex::index(const RTokens& rTokens)
 {
    static std::vector<Indexer> indexers = makeIndexers();
    
    // clear any (source-local) inferred packages
    inferredPkgNames_.clear();
 
-   // tokenize and create token cursor
-   std::wstring wCode = string_utils::utf8ToWide(code, context);
-   RTokens rTokens(wCode, RTokens::StripWhitespace | RTokens::StripComments);
    if (rTokens.empty())
       return;
    
+   // create token cursor
    RTokenCursor cursor(rTokens);
    
    // run over tokens and apply indexers
@@ -0,0 +1,363 @@
+/*
+ * ChildProcessActivityMonitor.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "ChildProcessActivityMonitor.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+# include <unistd.h>
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+# include <sys/syscall.h>
+#endif
+
+#include <boost/bind/bind.hpp>
+
+#include <shared_core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/Thread.hpp>
+
+using namespace boost::placeholders;
+
+namespace rstudio {
+namespace core {
+namespace system {
+
+namespace {
+
+// identifier used for the descriptor which stops the monitor thread
+// (children are identified by address so this can never collide)
+const std::uintptr_t kStopId = 0;
+
+// maximum number of events to collect per wait
+const int kMaxEvents = 64;
+
+// minimum time between activity notifications; bounds the rate at which
+// a very chatty child can wake up the polling thread
+const int kMinActivityIntervalMs = 10;
+
+} // anonymous namespace
+
+#ifdef __linux__
+
+ChildProcessActivityMonitor::ChildProcessActivityMonitor(
+      const boost::function<void()>& onActivity)
+   : onActivity_(onActivity),
+     epollFd_(-1),
+     wakeFd_(-1),
+     ownerPid_(::getpid())
+{
+   epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+   if (epollFd_ == -1)
+   {
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+      return;
+   }
+
+   wakeFd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+   if (wakeFd_ == -1)
+   {
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+      ::close(epollFd_);
+      epollFd_ = -1;
+      return;
+   }
+
+   struct epoll_event event = {};
+   event.events = EPOLLIN;
+   event.data.u64 = kStopId;
+   if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &event) == -1)
+   {
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+      ::close(wakeFd_);
+      ::close(epollFd_);
+      wakeFd_ = -1;
+      epollFd_ = -1;
+      return;
+   }
+
+   core::thread::safeLaunchThread(
+            boost::bind(&ChildProcessActivityMonitor::monitorThread, this),
+            &thread_);
+}
+
+ChildProcessActivityMonitor::~ChildProcessActivityMonitor()
+{
+   try
+   {
+      if (!supported())
+         return;
+
+      // a forked child shares our descriptors but not our thread, so
+      // it must not signal (and thereby stop) the parent's monitor
+      if (::getpid() != ownerPid_)
+         return;
+
+      std::uint64_t value = 1;
+      if (::write(wakeFd_, &value, sizeof(value)) == -1)
+         LOG_ERROR(systemError(errno, ERROR_LOCATION));
+      else if (thread_.joinable())
+         thread_.join();
+
+      LOCK_MUTEX(mutex_)
+      {
+         for (auto& entry : registrations_)
+         {
+            if (entry.second.pidFd != -1)
+               ::close(entry.second.pidFd);
+         }
+         registrations_.clear();
+      }
+      END_LOCK_MUTEX
+
+      ::close(wakeFd_);
+      ::close(epollFd_);
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+bool ChildProcessActivityMonitor::supported() const
+{
+   return epollFd_ != -1;
+}
+
+bool ChildProcessActivityMonitor::watch(std::uintptr_t id, int fd, int op)
+{
+   struct epoll_event event = {};
+   event.events = EPOLLIN | EPOLLONESHOT;
+   event.data.u64 = id;
+   return ::epoll_ctl(epollFd_, op, fd, &event) != -1;
+}
+
+bool ChildProcessActivityMonitor::add(std::uintptr_t id,
+                                      PidType pid,
+                                      const std::vector<int>& fds)
+{
+   if (!supported())
+      return false;
+
+   LOCK_MUTEX(mutex_)
+   {
+      Registration registration;
+      for (int fd : fds)
+      {
+         // skip closed and duplicate descriptors (e.g. a pseudoterminal
+         // uses the same descriptor for all of its streams)
+         if (fd < 0 || std::count(registration.fds.begin(), registration.fds.end(), fd))
+            continue;
+
+         if (!watch(id, fd, EPOLL_CTL_ADD))
+         {
+            LOG_ERROR(systemError(errno, ERROR_LOCATION));
+            for (int registeredFd : registration.fds)
+               ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, registeredFd, nullptr);
+            return false;
+         }
+
+         registration.fds.push_back(fd);
+      }
+
+      // a pidfd becomes readable when the child exits, which lets us notice
+      // exits even when descendents hold the output pipes open (older
+      // kernels don't support this, in which case the supervisor relies on
+      // its periodic sweep to reap such children)
+#ifdef SYS_pidfd_open
+      int pidFd = static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+      if (pidFd != -1)
+      {
+         if (watch(id, pidFd, EPOLL_CTL_ADD))
+            registration.pidFd = pidFd;
+         else
+            ::close(pidFd);
+      }
+#endif
+
+      registrations_[id] = registration;
+   }
+   END_LOCK_MUTEX
+
+   return true;
+}
+
+void ChildProcessActivityMonitor::remove(std::uintptr_t id)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      auto it = registrations_.find(id);
+      if (it == registrations_.end())
+         return;
+
+      // note that we deliberately don't remove the child's output descriptors
+      // from the epoll set: by the time a child is removed they have been
+      // closed (which removes them implicitly) and their numbers may already
+      // have been reused by another child's descriptors
+      if (it->second.pidFd != -1)
+         ::close(it->second.pidFd);
+
+      registrations_.erase(it);
+      ready_.erase(id);
+   }
+   END_LOCK_MUTEX
+}
+
+void ChildProcessActivityMonitor::rearm(std::uintptr_t id)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      auto it = registrations_.find(id);
+      if (it == registrations_.end())
+         return;
+
+      for (int fd : it->second.fds)
+         watch(id, fd, EPOLL_CTL_MOD);
+
+      if (it->second.pidFd != -1)
+         watch(id, it->second.pidFd, EPOLL_CTL_MOD);
+   }
+   END_LOCK_MUTEX
+}
+
+bool ChildProcessActivityMonitor::watching(std::uintptr_t id)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      return registrations_.count(id) > 0;
+   }
+   END_LOCK_MUTEX
+
+   return false;
+}
+
+std::set<std::uintptr_t> ChildProcessActivityMonitor::takeReady()
+{
+   std::set<std::uintptr_t> ready;
+   LOCK_MUTEX(mutex_)
+   {
+      ready.swap(ready_);
+   }
+   END_LOCK_MUTEX
+
+   return ready;
+}
+
+void ChildProcessActivityMonitor::monitorThread()
+{
+   try
+   {
+      struct epoll_event events[kMaxEvents];
+
+      while (true)
+      {
+         int count = ::epoll_wait(epollFd_, events, kMaxEvents, -1);
+         if (count == -1)
+         {
+            if (errno == EINTR)
+               continue;
+
+            LOG_ERROR(systemError(errno, ERROR_LOCATION));
+            return;
+         }
+
+         bool notify = false;
+         LOCK_MUTEX(mutex_)
+         {
+            bool wasEmpty = ready_.empty();
+            for (int i = 0; i < count; ++i)
+            {
+               std::uintptr_t id = static_cast<std::uintptr_t>(events[i].data.u64);
+               if (id == kStopId)
+                  return;
+
+               // ignore events for children which have since been removed
+               if (registrations_.count(id))
+                  ready_.insert(id);
+            }
+            notify = wasEmpty && !ready_.empty();
+         }
+         END_LOCK_MUTEX
+
+         if (notify)
+         {
+            if (onActivity_)
+               onActivity_();
+
+            boost::this_thread::sleep(
+                     boost::posix_time::milliseconds(kMinActivityIntervalMs));
+         }
+      }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+#else
+
+ChildProcessActivityMonitor::ChildProcessActivityMonitor(
+      const boost::function<void()>& onActivity)
+   : onActivity_(onActivity),
+     epollFd_(-1),
+     wakeFd_(-1),
+     ownerPid_(0)
+{
+}
+
+ChildProcessActivityMonitor::~ChildProcessActivityMonitor()
+{
+}
+
+bool ChildProcessActivityMonitor::supported() const
+{
+   return false;
+}
+
+bool ChildProcessActivityMonitor::watch(std::uintptr_t, int, int)
+{
+   return false;
+}
+
+bool ChildProcessActivityMonitor::add(std::uintptr_t,
+                                      PidType,
+                                      const std::vector<int>&)
+{
+   return false;
+}
+
+void ChildProcessActivityMonitor::remove(std::uintptr_t)
+{
+}
+
+void ChildProcessActivityMonitor::rearm(std::uintptr_t)
+{
+}
+
+bool ChildProcessActivityMonitor::watching(std::uintptr_t)
+{
+   return false;
+}
+
+std::set<std::uintptr_t> ChildProcessActivityMonitor::takeReady()
+{
+   return std::set<std::uintptr_t>();
+}
+
+void ChildProcessActivityMonitor::monitorThread()
+{
+}
+
+#endif
+
+} // namespace system
+} // namespace core
+} // namespace rstudio
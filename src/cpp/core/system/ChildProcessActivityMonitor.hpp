@@ -0,0 +1,100 @@
+/*
+ * ChildProcessActivityMonitor.hpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_SYSTEM_CHILD_PROCESS_ACTIVITY_MONITOR_HPP
+#define CORE_SYSTEM_CHILD_PROCESS_ACTIVITY_MONITOR_HPP
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/utility.hpp>
+
+#include <core/BoostThread.hpp>
+#include <core/system/System.hpp>
+
+namespace rstudio {
+namespace core {
+namespace system {
+
+// Watches the output descriptors (and, where the kernel supports it, a
+// pidfd) of supervised child processes from a background thread, so that
+// the ProcessSupervisor only needs to read from and reap children which
+// actually have something to report.
+//
+// Descriptors are registered as one-shot: once a child has been reported
+// as ready it is not reported again until rearm() is called for it (which
+// the supervisor does after draining the child). The onActivity callback is
+// invoked on the monitor thread when the set of ready children goes from
+// empty to non-empty, and is typically used to wake up the thread which
+// calls ProcessSupervisor::poll.
+//
+// Only supported on Linux (epoll); on other platforms supported() returns
+// false and the supervisor falls back to polling every child.
+class ChildProcessActivityMonitor : boost::noncopyable
+{
+public:
+   explicit ChildProcessActivityMonitor(const boost::function<void()>& onActivity);
+   virtual ~ChildProcessActivityMonitor();
+
+   // was the monitor successfully initialized?
+   bool supported() const;
+
+   // start watching a child; returns false if the child could not be
+   // watched (in which case it should be polled unconditionally)
+   bool add(std::uintptr_t id, PidType pid, const std::vector<int>& fds);
+
+   // stop watching a child
+   void remove(std::uintptr_t id);
+
+   // re-enable notifications for a child after it has been polled
+   void rearm(std::uintptr_t id);
+
+   // is the child being watched?
+   bool watching(std::uintptr_t id);
+
+   // take the set of children which have become ready since the last call
+   std::set<std::uintptr_t> takeReady();
+
+private:
+   struct Registration
+   {
+      Registration() : pidFd(-1) {}
+      std::vector<int> fds;
+      int pidFd;
+   };
+
+   void monitorThread();
+   bool watch(std::uintptr_t id, int fd, int op);
+
+   boost::function<void()> onActivity_;
+
+   int epollFd_;
+   int wakeFd_;
+   PidType ownerPid_;
+   boost::thread thread_;
+
+   boost::mutex mutex_;
+   std::map<std::uintptr_t, Registration> registrations_;
+   std::set<std::uintptr_t> ready_;
+};
+
+} // namespace system
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_SYSTEM_CHILD_PROCESS_ACTIVITY_MONITOR_HPP
@@ -17,6 +17,7 @@
 #include <shared_core/FilePath.hpp>
 #include <shared_core/SafeConvert.hpp>
 
+#include <core/system/PosixSystem.hpp>
 #include <core/system/Resources.hpp>
 
 #include <core/Log.hpp>
@@ -27,6 +28,9 @@
 
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
 
 #include <sys/sysinfo.h>
 
@@ -393,9 +397,145 @@ boost::shared_ptr<LinuxMemoryProvider> getMemoryProvider()
    return s_provider;
 }
 
+/**
+ * Per-process statistics read from /proc/<pid>/stat.
+ */
+struct ProcStat
+{
+   ProcStat() : ppid(0), cpuSeconds(0), residentKb(0) {}
+
+   PidType ppid;
+   std::string name;
+   double cpuSeconds;
+   long residentKb;
+};
+
+bool readProcStat(const std::string& procPath, ProcStat* pStat)
+{
+   std::ifstream statFile(procPath + "/stat");
+   std::string contents;
+   if (!std::getline(statFile, contents))
+      return false;
+
+   // the command name is in parentheses and may itself contain spaces or
+   // parentheses, so locate the fields relative to the final ')'
+   std::size_t nameStart = contents.find('(');
+   std::size_t nameEnd = contents.rfind(')');
+   if (nameStart == std::string::npos || nameEnd == std::string::npos || nameEnd < nameStart)
+      return false;
+
+   pStat->name = contents.substr(nameStart + 1, nameEnd - nameStart - 1);
+
+   // fields following the name, starting with field 3 (state)
+   std::vector<std::string> fields;
+   std::istringstream fieldStream(contents.substr(nameEnd + 1));
+   std::string field;
+   while (fieldStream >> field && fields.size() < 22)
+      fields.push_back(field);
+
+   if (fields.size() < 22)
+      return false;
+
+   static const double ticksPerSecond = static_cast<double>(::sysconf(_SC_CLK_TCK));
+   static const long pageKib = ::sysconf(_SC_PAGE_SIZE) / 1024;
+
+   pStat->ppid = safe_convert::stringTo<PidType>(fields[1], 0);                 // field 4
+   double ticks = safe_convert::stringTo<double>(fields[11], 0) +               // field 14 (utime)
+                  safe_convert::stringTo<double>(fields[12], 0);                // field 15 (stime)
+   pStat->cpuSeconds = ticksPerSecond > 0 ? ticks / ticksPerSecond : 0;
+   pStat->residentKb = safe_convert::stringTo<long>(fields[21], 0) * pageKib;   // field 24 (rss)
+   return true;
+}
+
+void readProcIo(const std::string& procPath, uint64_t* pReadBytes, uint64_t* pWriteBytes)
+{
+   // not readable for processes running as another user; those simply
+   // don't contribute IO statistics
+   std::ifstream ioFile(procPath + "/io");
+   std::string key;
+   uint64_t value;
+   while (ioFile >> key >> value)
+   {
+      if (key == "read_bytes:")
+         *pReadBytes += value;
+      else if (key == "write_bytes:")
+         *pWriteBytes += value;
+   }
+}
+
+// Builds a map of parent to child processes by scanning all of /proc; used when the
+// per-thread children lists are unavailable
+void readProcessTree(std::map<PidType, std::vector<PidType> >* pTree)
+{
+   std::vector<FilePath> entries;
+   Error error = FilePath("/proc").getChildren(entries);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   for (const FilePath& entry : entries)
+   {
+      PidType pid = safe_convert::stringTo<PidType>(entry.getFilename(), 0);
+      if (pid <= 0)
+         continue;
+
+      ProcStat stat;
+      if (readProcStat(entry.getAbsolutePath(), &stat))
+         (*pTree)[stat.ppid].push_back(pid);
+   }
+}
+
 } // anonymous namespace
 
+Error getProcessTreeResourceUsage(const std::vector<PidType>& pids,
+                                  std::vector<ProcessTreeResourceUsage>* pUsage)
+{
+   // without per-thread children lists, scan /proc once for the whole batch
+   std::map<PidType, std::vector<PidType> > tree;
+   bool useChildrenLists = hasProcChildren();
+   if (!useChildrenLists)
+      readProcessTree(&tree);
+
+   for (PidType root : pids)
+   {
+      ProcessTreeResourceUsage usage;
+      usage.pid = root;
+
+      std::set<PidType> visited;
+      std::vector<PidType> pending(1, root);
+      while (!pending.empty())
+      {
+         PidType pid = pending.back();
+         pending.pop_back();
+         if (!visited.insert(pid).second)
+            continue;
+
+         std::string procPath = "/proc/" + safe_convert::numberToString(pid);
+         ProcStat stat;
+         if (!readProcStat(procPath, &stat))
+            continue; // exited
+
+         if (pid == root)
+            usage.name = stat.name;
+         usage.processes++;
+         usage.cpuSeconds += stat.cpuSeconds;
+         usage.residentKb += stat.residentKb;
+         readProcIo(procPath, &usage.readBytes, &usage.writeBytes);
+
+         if (useChildrenLists)
+            readProcChildren(pid, &pending);
+         else if (tree.count(pid))
+            pending.insert(pending.end(), tree[pid].begin(), tree[pid].end());
+      }
 
+      if (usage.processes > 0)
+         pUsage->push_back(usage);
+   }
+
+   return Success();
+}
 
 Error getTotalMemoryUsed(long *pUsedKb, MemoryProvider *pProvider)
 {
@@ -93,6 +93,12 @@ Error getProcessMemoryUsed(long *pUsedKb, MemoryProvider *pProvider)
     return systemError(ret, "Failed to get memory resource usage from task_info", ERROR_LOCATION);
 }
 
+Error getProcessTreeResourceUsage(const std::vector<PidType>&,
+                                  std::vector<ProcessTreeResourceUsage>*)
+{
+   return systemError(boost::system::errc::not_supported, ERROR_LOCATION);
+}
+
 } // namespace system
 } // namespace core
 } // namespace rstudio
@@ -32,6 +32,17 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 
+// posix_spawn can be used in place of fork when the C library lets us close
+// inherited descriptors (posix_spawn_file_actions_addclosefrom_np, which
+// also implies support for changing directory and creating a new session)
+#if defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+# if __GLIBC_PREREQ(2, 34)
+#  define RSTUDIO_HAVE_POSIX_SPAWN_CLOSEFROM
+#  include <spawn.h>
+extern char** environ;
+# endif
+#endif
+
 #include <boost/asio.hpp>
 #include <boost/bind/bind.hpp>
 
@@ -112,22 +123,152 @@ void closePipe(int* pipeDescriptors, const ErrorLocation& location)
    closePipe(pipeDescriptors[WRITE], location);
 }
 
+#ifdef RSTUDIO_HAVE_POSIX_SPAWN_CLOSEFROM
+
+// can the child be launched with posix_spawn? glibc implements posix_spawn
+// with clone(CLONE_VM | CLONE_VFORK), which avoids copying the (potentially
+// very large) page tables of the session when launching short-lived children.
+// options which need code to run in the child after fork aren't supported
+bool canSpawnChild(const ProcessOptions& options)
+{
+   return !options.pseudoterminal &&
+          options.runAsUser.empty() &&
+          !options.onAfterFork;
+}
+
+Error spawnChild(const std::string& exe,
+                 ProcessArgs* pArgs,
+                 ProcessArgs* pEnvironment,
+                 const ProcessOptions& options,
+                 PidType* pPid,
+                 int* pFdStdin,
+                 int* pFdStdout,
+                 int* pFdStderr)
+{
+   int fdInput[2] = {-1, -1};
+   int fdOutput[2] = {-1, -1};
+   int fdError[2] = {-1, -1};
+
+   Error error = posix::posixCall<int>(boost::bind(::pipe, fdInput), ERROR_LOCATION);
+   if (error)
+      return error;
+
+   error = posix::posixCall<int>(boost::bind(::pipe, fdOutput), ERROR_LOCATION);
+   if (error)
+   {
+      closePipe(fdInput, ERROR_LOCATION);
+      return error;
+   }
+
+   error = posix::posixCall<int>(boost::bind(::pipe, fdError), ERROR_LOCATION);
+   if (error)
+   {
+      closePipe(fdInput, ERROR_LOCATION);
+      closePipe(fdOutput, ERROR_LOCATION);
+      return error;
+   }
+
+   // wire standard streams, then close everything else we've inherited
+   posix_spawn_file_actions_t actions;
+   ::posix_spawn_file_actions_init(&actions);
+   ::posix_spawn_file_actions_adddup2(&actions, fdInput[READ], STDIN_FILENO);
+   ::posix_spawn_file_actions_adddup2(&actions, fdOutput[WRITE], STDOUT_FILENO);
+   ::posix_spawn_file_actions_adddup2(
+            &actions,
+            options.redirectStdErrToStdOut ? fdOutput[WRITE] : fdError[WRITE],
+            STDERR_FILENO);
+   ::posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+
+   std::string workingDir;
+   if (!options.workingDir.isEmpty())
+   {
+      workingDir = options.workingDir.getAbsolutePath();
+      ::posix_spawn_file_actions_addchdir_np(&actions, workingDir.c_str());
+   }
+
+   // clear the signal mask, and create a new session or process
+   // group as requested (see the corresponding code in run)
+   posix_spawnattr_t attr;
+   ::posix_spawnattr_init(&attr);
+
+   sigset_t emptyMask;
+   ::sigemptyset(&emptyMask);
+   ::posix_spawnattr_setsigmask(&attr, &emptyMask);
+
+   short flags = POSIX_SPAWN_SETSIGMASK;
+   if (options.detachSession)
+   {
+      flags |= POSIX_SPAWN_SETSID;
+   }
+   else if (options.terminateChildren)
+   {
+      flags |= POSIX_SPAWN_SETPGROUP;
+      ::posix_spawnattr_setpgroup(&attr, 0);
+   }
+   ::posix_spawnattr_setflags(&attr, flags);
+
+   PidType pid = -1;
+   int result = ::posix_spawn(&pid,
+                              exe.c_str(),
+                              &actions,
+                              &attr,
+                              pArgs->args(),
+                              pEnvironment ? pEnvironment->args() : environ);
+
+   ::posix_spawnattr_destroy(&attr);
+   ::posix_spawn_file_actions_destroy(&actions);
+
+   if (result != 0)
+   {
+      closePipe(fdInput, ERROR_LOCATION);
+      closePipe(fdOutput, ERROR_LOCATION);
+      closePipe(fdError, ERROR_LOCATION);
+
+      Error error = systemError(result, ERROR_LOCATION);
+      error.addProperty("exe", exe);
+      return error;
+   }
+
+   // close the child's ends of the pipes
+   closePipe(fdInput[READ], ERROR_LOCATION);
+   closePipe(fdOutput[WRITE], ERROR_LOCATION);
+   closePipe(fdError[WRITE], ERROR_LOCATION);
+
+   *pPid = pid;
+   *pFdStdin = fdInput[WRITE];
+   *pFdStdout = fdOutput[READ];
+   *pFdStderr = fdError[READ];
+   return Success();
+}
+
+#endif // RSTUDIO_HAVE_POSIX_SPAWN_CLOSEFROM
+
 Error readPipe(int pipeFd, std::string* pOutput, bool *pEOF = nullptr)
 {
    // default to not eof
    if (pEOF)
       *pEOF = false;
 
-   // setup and read into buffer
-   const std::size_t kBufferSize = 512;
-   char buffer[kBufferSize];
-   std::size_t bytesRead = posix::posixCall<std::size_t>(
-                     boost::bind(::read, pipeFd, buffer, kBufferSize));
+   // read directly into the output, starting small (most reads are a
+   // keystroke echo or a line of output) and doubling the size of each
+   // read while the pipe keeps filling it, so a burst of output is
+   // drained in a few large reads rather than many small ones
+   const std::size_t kInitialReadSize = 4096;
+   const std::size_t kMaxReadSize = 64 * 1024;
+   std::size_t readSize = kInitialReadSize;
+
    while (true)
    {
+      std::size_t offset = pOutput->size();
+      pOutput->resize(offset + readSize);
+      std::size_t bytesRead = posix::posixCall<std::size_t>(
+                        boost::bind(::read, pipeFd, &(*pOutput)[offset], readSize));
+
       // check for error
       if (bytesRead == READ_ERR)
       {
+         pOutput->resize(offset);
+
          if (errno == EAGAIN) // carve-out for O_NONBLOCK pipes
             return Success();
 
@@ -147,18 +288,18 @@ Error readPipe(int pipeFd, std::string* pOutput, bool *pEOF = nullptr)
       // check for eof
       else if (bytesRead == 0)
       {
+         pOutput->resize(offset);
+
          if (pEOF)
             *pEOF = true;
 
          return Success();
       }
 
-      // append to output
-      pOutput->append(buffer, bytesRead);
-
-      // read more bytes
-      bytesRead = posix::posixCall<std::size_t>(
-                        boost::bind(::read, pipeFd, buffer, kBufferSize));
+      // keep what was read
+      pOutput->resize(offset + bytesRead);
+      if (bytesRead == readSize && readSize < kMaxReadSize)
+         readSize *= 2;
    }
 
    // keep compiler happy
@@ -508,6 +649,28 @@ Error ChildProcess::run()
                          ERROR_LOCATION);
    }
 
+#ifdef RSTUDIO_HAVE_POSIX_SPAWN_CLOSEFROM
+   // launch without forking where possible. posix_spawn reports failures
+   // (e.g. a missing executable or working directory) to us directly; in that
+   // case we fall back to forking so that the child fails in the usual way
+   if (canSpawnChild(options_))
+   {
+      int fdStdin = -1, fdStdout = -1, fdStderr = -1;
+      error = spawnChild(exe_, pProcessArgs, pEnvironment, options_,
+                         &pid, &fdStdin, &fdStdout, &fdStderr);
+      if (!error)
+      {
+         pImpl_->init(pid, fdStdin, fdStdout, fdStderr);
+         delete pProcessArgs;
+         delete pEnvironment;
+         return Success();
+      }
+
+      LOG_DEBUG_MESSAGE("Unable to spawn child process; falling back to fork: " +
+                        error.asString());
+   }
+#endif
+
    // pseudoterminal mode: fork using the special forkpty call
    if (options_.pseudoterminal)
    {
@@ -1013,7 +1176,17 @@ bool AsyncChildProcess::hasRecentOutput() const
       return true;
 }
 
-void AsyncChildProcess::poll()
+std::vector<int> AsyncChildProcess::activityDescriptors() const
+{
+   std::vector<int> fds;
+   if (pImpl_->fdStdout != -1)
+      fds.push_back(pImpl_->fdStdout);
+   if (pImpl_->fdStderr != -1)
+      fds.push_back(pImpl_->fdStderr);
+   return fds;
+}
+
+void AsyncChildProcess::poll(bool pollIO)
 {
    // skip polling if we're not on the main thread,
    // and the process options request we run on the main thread only
@@ -1047,6 +1220,9 @@ void AsyncChildProcess::poll()
       if (callbacks_.onStarted)
          callbacks_.onStarted(*this);
       pAsyncImpl_->calledOnStarted_ = true;
+
+      // always check for output on the first poll
+      pollIO = true;
    }
    // call onContinue
    if (callbacks_.onContinue)
@@ -1063,7 +1239,7 @@ void AsyncChildProcess::poll()
    bool hasRecentOutput = false;
 
    // check stdout and fire event if we got output
-   if (!pAsyncImpl_->finishedStdout_)
+   if (pollIO && !pAsyncImpl_->finishedStdout_)
    {
       bool eof;
       std::string out;
@@ -1086,7 +1262,7 @@ void AsyncChildProcess::poll()
    }
 
    // check stderr and fire event if we got output
-   if (!pAsyncImpl_->finishedStderr_)
+   if (pollIO && !pAsyncImpl_->finishedStderr_)
    {
       bool eof;
       std::string err;
@@ -1116,8 +1292,12 @@ void AsyncChildProcess::poll()
    // case we'll allow the exit sequence to proceed and simply pass -1 as
    // the exit status.
    int status;
-   PidType result = posix::posixCall<PidType>(
-            boost::bind(::waitpid, pImpl_->pid, &status, WNOHANG));
+   PidType result = 0;
+   if (pollIO)
+   {
+      result = posix::posixCall<PidType>(
+               boost::bind(::waitpid, pImpl_->pid, &status, WNOHANG));
+   }
 
    // either a normal exit or an error while waiting
    if (result != 0)
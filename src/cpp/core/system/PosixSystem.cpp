@@ -17,6 +17,7 @@
 
 #include <stdio.h>
 
+#include <atomic>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -51,6 +52,7 @@
 
 #ifndef __APPLE__
 #include <sys/prctl.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
 #include <linux/kernel.h>
 #include <dirent.h>
@@ -557,11 +559,23 @@ namespace {
 //  - getrlimit(RLIMIT_NOFILE, &rl)
 //  - gettdtablesize
 //  - read from /proc/self/fd, /proc/<pid>/fd, or /dev/fd
+//  - close_range (Linux 5.9+), which avoids the need to enumerate at all
 //
 // Note that the above functions may return either -1 or MAX_INT, in
 // which case substituting/truncating to an appropriate number (1024?)
 // is still required
 
+// close all descriptors in [first, last] with a single system call; returns
+// false if not supported by the kernel. async signal safe
+bool closeRange(unsigned int first, unsigned int last)
+{
+#ifdef SYS_close_range
+   return ::syscall(SYS_close_range, first, last, 0) == 0;
+#else
+   return false;
+#endif
+}
+
 #if !defined(__APPLE__) && !defined(HAVE_PROCSELF)
 // worst case scenario - close all file descriptors possible
 // this can be EXTREMELY slow when max fd is set to a high value
@@ -570,6 +584,9 @@ namespace {
 // as a remainder of what was being done in the recent past
 Error closeFileDescriptorsFrom(int fdStart)
 {
+   if (closeRange(fdStart, ~0U))
+      return Success();
+
    // get limit
    struct rlimit rl;
    if (::getrlimit(RLIMIT_NOFILE, &rl) < 0)
@@ -591,6 +608,9 @@ Error closeFileDescriptorsFrom(int fdStart)
 // iterate over them and close - much faster than the above method
 Error closeFileDescriptorsFrom(int fdStart)
 {
+   if (closeRange(fdStart, ~0U))
+      return Success();
+
    std::vector<unsigned int> fds;
    Error error = getOpenFds(&fds);
    if (error)
@@ -762,6 +782,12 @@ void closeFileDescriptorsFromSafe(uint32_t fdStart, rlim_t fdLimit)
    // this is necessary when invoked in a signal handler or
    // during a fork in multithreaded processes to prevent hangs
 
+   if (fdStart >= fdLimit)
+      return;
+
+   if (closeRange(fdStart, fdLimit == RLIM_INFINITY ? ~0U : fdLimit - 1))
+      return;
+
    if (fdLimit == RLIM_INFINITY)
       fdLimit = 1024; // default on linux
 
@@ -1125,8 +1151,130 @@ std::vector<SubprocInfo> getSubprocessesMac(PidType pid)
 
 #else
 
+namespace {
+
+// cumulative cost of subprocess detection; see subprocessScanStatistics
+std::atomic<std::size_t> s_subprocScans(0);
+std::atomic<std::size_t> s_subprocFullScans(0);
+std::atomic<std::size_t> s_subprocFilesRead(0);
+std::atomic<std::size_t> s_subprocScanMicroseconds(0);
+
+class SubprocScanTimer : boost::noncopyable
+{
+public:
+   SubprocScanTimer()
+      : start_(boost::posix_time::microsec_clock::universal_time())
+   {
+      ++s_subprocScans;
+   }
+
+   ~SubprocScanTimer()
+   {
+      boost::posix_time::time_duration elapsed =
+            boost::posix_time::microsec_clock::universal_time() - start_;
+      s_subprocScanMicroseconds += static_cast<std::size_t>(elapsed.total_microseconds());
+   }
+
+private:
+   boost::posix_time::ptime start_;
+};
+
+} // anonymous namespace
+
+bool hasProcChildren()
+{
+   static const bool hasChildren = FilePath(
+            "/proc/self/task/" + safe_convert::numberToString(::getpid()) +
+            "/children").exists();
+   return hasChildren;
+}
+
+void readProcChildren(PidType pid,
+                      std::vector<PidType>* pChildren,
+                      std::size_t* pFilesRead)
+{
+   // every thread of the process has its own list of children
+   std::string taskPath = "/proc/" + safe_convert::numberToString(pid) + "/task";
+   DIR* pDir = ::opendir(taskPath.c_str());
+   if (pDir == nullptr)
+      return;
+
+   struct dirent* pDirent;
+   while ((pDirent = ::readdir(pDir)))
+   {
+      if (pDirent->d_name[0] == '.')
+         continue;
+
+      std::string contents;
+      FilePath childrenFile(taskPath + "/" + pDirent->d_name + "/children");
+      Error error = rstudio::core::readStringFromFile(childrenFile, &contents);
+      if (pFilesRead)
+         ++*pFilesRead;
+      if (error)
+         continue;
+
+      // space separated list of child pids
+      std::vector<std::string> pids;
+      boost::algorithm::split(pids, contents, boost::algorithm::is_space(),
+                              boost::algorithm::token_compress_on);
+      for (const std::string& childPid : pids)
+      {
+         PidType child = safe_convert::stringTo<PidType>(childPid, -1);
+         if (child != -1)
+            pChildren->push_back(child);
+      }
+   }
+
+   ::closedir(pDir);
+}
+
+std::vector<SubprocInfo> getSubprocessesViaProcChildren(PidType pid)
+{
+   SubprocScanTimer timer;
+   std::vector<SubprocInfo> subprocs;
+
+   std::vector<PidType> children;
+   std::size_t filesRead = 0;
+   readProcChildren(pid, &children, &filesRead);
+   s_subprocFilesRead += filesRead;
+
+   for (PidType child : children)
+   {
+      // comm holds the same (possibly truncated) executable
+      // name as is reported in the stat file
+      std::string comm;
+      FilePath commFile("/proc/" + safe_convert::numberToString(child) + "/comm");
+      Error error = rstudio::core::readStringFromFile(commFile, &comm);
+      ++s_subprocFilesRead;
+      if (error)
+      {
+         // the child exited since we listed it
+         continue;
+      }
+
+      SubprocInfo info;
+      info.pid = child;
+      info.exe = boost::algorithm::trim_right_copy_if(comm, boost::algorithm::is_any_of("\n"));
+      subprocs.push_back(info);
+   }
+
+   return subprocs;
+}
+
+SubprocScanStatistics subprocessScanStatistics()
+{
+   SubprocScanStatistics stats;
+   stats.scans = s_subprocScans;
+   stats.fullScans = s_subprocFullScans;
+   stats.filesRead = s_subprocFilesRead;
+   stats.elapsedMicroseconds = s_subprocScanMicroseconds;
+   return stats;
+}
+
 std::vector<SubprocInfo> getSubprocessesViaProcFs(PidType pid)
 {
+   SubprocScanTimer timer;
+   ++s_subprocFullScans;
    std::vector<SubprocInfo> subprocs;
 
    core::FilePath procFsPath("/proc");
@@ -1181,6 +1329,7 @@ std::vector<SubprocInfo> getSubprocessesViaProcFs(PidType pid)
       std::string contents;
       FilePath statFile(child.completePath("stat"));
       Error error = rstudio::core::readStringFromFile(statFile, &contents);
+      ++s_subprocFilesRead;
       if (error)
       {
          continue;
@@ -1256,7 +1405,11 @@ std::vector<SubprocInfo> getSubprocesses(PidType pid)
 #ifdef __APPLE__
    return getSubprocessesMac(pid);
 #else // Linux
-   return getSubprocessesViaProcFs(pid);
+   // only scan the entire process table if we can't list children directly
+   if (hasProcChildren())
+      return getSubprocessesViaProcChildren(pid);
+   else
+      return getSubprocessesViaProcFs(pid);
 #endif
 }
 
@@ -17,6 +17,8 @@
 
 #include <core/system/PosixSystem.hpp>
 #include <core/system/PosixGroup.hpp>
+#include <core/system/Resources.hpp>
+#include <shared_core/SafeConvert.hpp>
 #include <signal.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -251,8 +253,84 @@ test_context("PosixSystemTests")
          ::waitpid(pid, nullptr, 0);
       }
    }
+
+   test_that("Subprocess detected correctly with procfs children method")
+   {
+      // requires a kernel built with CONFIG_PROC_CHILDREN
+      if (!FilePath("/proc/self/task/" + safe_convert::numberToString(getpid()) + "/children").exists())
+         return;
+
+      pid_t pid = fork();
+      expect_false(pid == -1);
+      std::string exe = "sleep";
+
+      if (pid == 0)
+      {
+         execlp(exe.c_str(), exe.c_str(), "10000", nullptr);
+         expect_true(false); // shouldn't get here!
+      }
+      else
+      {
+         ::sleep(1);
+         std::vector<SubprocInfo> children = getSubprocessesViaProcChildren(getpid());
+         bool found = false;
+         for (SubprocInfo info : children)
+         {
+            if (info.pid == pid && info.exe.compare(exe) == 0)
+            {
+               found = true;
+               break;
+            }
+         }
+         expect_true(found);
+
+         // the sleep process itself has no children
+         expect_true(getSubprocessesViaProcChildren(pid).empty());
+
+         ::kill(pid, SIGKILL);
+         ::waitpid(pid, nullptr, 0);
+      }
+   }
 #endif // !__APPLE__
 
+#ifdef __linux__
+   test_that("Process tree resource usage includes descendants")
+   {
+      pid_t pid = fork();
+      expect_false(pid == -1);
+
+      if (pid == 0)
+      {
+         ::sleep(1);
+         _exit(0);
+      }
+      else
+      {
+         std::vector<ProcessTreeResourceUsage> usage;
+         Error error = getProcessTreeResourceUsage({ ::getpid(), pid }, &usage);
+         expect_true(error == Success());
+         expect_true(usage.size() == 2);
+         if (usage.size() == 2)
+         {
+            expect_true(usage[0].pid == ::getpid());
+            expect_true(usage[0].processes >= 2);
+            expect_true(usage[0].residentKb > 0);
+            expect_true(usage[1].pid == pid);
+            expect_true(usage[1].processes == 1);
+         }
+
+         ::kill(pid, SIGKILL);
+         ::waitpid(pid, nullptr, 0);
+
+         // exited processes are omitted
+         usage.clear();
+         error = getProcessTreeResourceUsage({ pid }, &usage);
+         expect_true(error == Success());
+         expect_true(usage.empty());
+      }
+   }
+#endif // __linux__
+
    test_that("Empty list of subprocesses returned correctly with generic method")
    {
       pid_t pid = fork();
@@ -16,6 +16,7 @@
 #include <core/system/Process.hpp>
 
 #include <iostream>
+#include <set>
 
 #include <boost/algorithm/cxx11/any_of.hpp>
 #include <boost/bind/bind.hpp>
@@ -30,6 +31,8 @@
 
 #include <core/Thread.hpp>
 
+#include "ChildProcessActivityMonitor.hpp"
+
 using namespace boost::placeholders;
 
 namespace rstudio {
@@ -81,11 +84,28 @@ Error runCommand(const std::string& command,
 }
 
 
+namespace {
+
+// when children are monitored for activity, how often all of them
+// are polled regardless (this catches exits which the monitor can't
+// observe, e.g. a child whose output pipes are held open by a daemon
+// it launched on a kernel without pidfd support)
+const boost::posix_time::milliseconds kActivitySweepInterval(1000);
+
+std::uintptr_t childId(const boost::shared_ptr<AsyncChildProcess>& pChild)
+{
+   return reinterpret_cast<std::uintptr_t>(pChild.get());
+}
+
+} // anonymous namespace
+
 struct ProcessSupervisor::Impl
 {
    Impl() : isPolling(false) {}
    bool isPolling;
    std::vector<boost::shared_ptr<AsyncChildProcess> > children;
+   boost::scoped_ptr<ChildProcessActivityMonitor> pMonitor;
+   boost::posix_time::ptime nextSweepTime;
 };
 
 ProcessSupervisor::ProcessSupervisor()
@@ -101,6 +121,7 @@ namespace {
 
 Error runChild(boost::shared_ptr<AsyncChildProcess> pChild,
                std::vector<boost::shared_ptr<AsyncChildProcess> >* pChildren,
+               ChildProcessActivityMonitor* pMonitor,
                boost::recursive_mutex* pMutex,
                const ProcessCallbacks& callbacks)
 {
@@ -113,6 +134,15 @@ Error runChild(boost::shared_ptr<AsyncChildProcess> pChild,
 
       // add to the list of children
       pChildren->push_back(pChild);
+
+      // watch for activity if requested (children which can't
+      // be watched are simply polled unconditionally)
+      if (pMonitor)
+      {
+         pMonitor->add(childId(pChild),
+                       pChild->getPid(),
+                       pChild->activityDescriptors());
+      }
    }
    END_LOCK_MUTEX
 
@@ -134,7 +164,11 @@ Error ProcessSupervisor::runProgram(const std::string& executable,
                                                        options));
 
    // run the child
-   return runChild(pChild, &(pImpl_->children), &mutex_, callbacks);
+   return runChild(pChild,
+                   &(pImpl_->children),
+                   pImpl_->pMonitor.get(),
+                   &mutex_,
+                   callbacks);
 }
 
 Error ProcessSupervisor::runCommand(const std::string& command,
@@ -146,7 +180,11 @@ Error ProcessSupervisor::runCommand(const std::string& command,
                                  new AsyncChildProcess(command, options));
 
    // run the child
-   return runChild(pChild, &(pImpl_->children), &mutex_, callbacks);
+   return runChild(pChild,
+                   &(pImpl_->children),
+                   pImpl_->pMonitor.get(),
+                   &mutex_,
+                   callbacks);
 }
 
 Error ProcessSupervisor::runTerminal(const ProcessOptions& options,
@@ -157,7 +195,11 @@ Error ProcessSupervisor::runTerminal(const ProcessOptions& options,
                                  new AsyncChildProcess(options));
 
    // run the child
-   return runChild(pChild, &(pImpl_->children), &mutex_, callbacks);
+   return runChild(pChild,
+                   &(pImpl_->children),
+                   pImpl_->pMonitor.get(),
+                   &mutex_,
+                   callbacks);
 }
 
 namespace {
@@ -305,6 +347,22 @@ bool ProcessSupervisor::hasRunningChildren()
    return !pImpl_->children.empty();
 }
 
+std::vector<PidType> ProcessSupervisor::childPids()
+{
+   std::vector<PidType> pids;
+   RECURSIVE_LOCK_MUTEX(mutex_)
+   {
+      for (const boost::shared_ptr<AsyncChildProcess>& pChild : pImpl_->children)
+      {
+         PidType pid = pChild->getPid();
+         if (pid > 0)
+            pids.push_back(pid);
+      }
+   }
+   END_LOCK_MUTEX
+   return pids;
+}
+
 namespace {
 
 bool hasActivity(const boost::shared_ptr<AsyncChildProcess>& childProc)
@@ -348,14 +406,50 @@ bool ProcessSupervisor::poll()
       // the children vector and if this requried a realloc would invalidate
       // all of the iterators currently pointing into the container
       std::vector<boost::shared_ptr<AsyncChildProcess> > children = pImpl_->children;
-      std::for_each(children.begin(),
-                    children.end(),
-                    boost::bind(&AsyncChildProcess::poll, _1));
+      ChildProcessActivityMonitor* pMonitor = pImpl_->pMonitor.get();
+      if (pMonitor)
+      {
+         // when monitoring for activity, only read from and reap the children
+         // which have reported activity (or all of them, periodically)
+         std::set<std::uintptr_t> ready = pMonitor->takeReady();
+
+         bool sweep = false;
+         boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+         if (pImpl_->nextSweepTime.is_not_a_date_time() || now >= pImpl_->nextSweepTime)
+         {
+            sweep = true;
+            pImpl_->nextSweepTime = now + kActivitySweepInterval;
+         }
+
+         for (const boost::shared_ptr<AsyncChildProcess>& pChild : children)
+         {
+            std::uintptr_t id = childId(pChild);
+            bool pollIO = sweep || ready.count(id) || !pMonitor->watching(id);
+            pChild->poll(pollIO);
+
+            if (pollIO && !pChild->exited())
+               pMonitor->rearm(id);
+         }
+      }
+      else
+      {
+         for (const boost::shared_ptr<AsyncChildProcess>& pChild : children)
+            pChild->poll();
+      }
 
       // remove any children who have exited from our list. note that it's safe
       // in this case to use pImpl_->children directly because the call to
       // AsyncChildProcess::exited just checks a member variable rather than
       // executing code that could cause re-entry
+      if (pMonitor)
+      {
+         for (const boost::shared_ptr<AsyncChildProcess>& pChild : pImpl_->children)
+         {
+            if (pChild->exited())
+               pMonitor->remove(childId(pChild));
+         }
+      }
+
       pImpl_->children.erase(std::remove_if(
                                 pImpl_->children.begin(),
                                 pImpl_->children.end(),
@@ -369,6 +463,22 @@ bool ProcessSupervisor::poll()
    return false;
 }
 
+void ProcessSupervisor::setActivityHandler(
+      const boost::function<void()>& onActivity)
+{
+   RECURSIVE_LOCK_MUTEX(mutex_)
+   {
+      if (pImpl_->pMonitor)
+         return;
+
+      boost::scoped_ptr<ChildProcessActivityMonitor> pMonitor(
+               new ChildProcessActivityMonitor(onActivity));
+      if (pMonitor->supported())
+         pImpl_->pMonitor.swap(pMonitor);
+   }
+   END_LOCK_MUTEX
+}
+
 void ProcessSupervisor::terminateAll()
 {
    // call terminate on all of our children
@@ -252,6 +252,24 @@ test_context("ProcessTests")
       CHECK(output == expectedOutput);
    }
 
+   test_that("Sync processes honor working directory and missing executables")
+   {
+      ProcessOptions options;
+      options.workingDir = FilePath("/");
+
+      ProcessResult result;
+      Error error = runProgram("/bin/pwd", std::vector<std::string>(), options, &result);
+      REQUIRE_FALSE(error);
+      CHECK(result.exitStatus == 0);
+      CHECK(result.stdOut == "/\n");
+
+      // a missing executable fails in the child (as with fork) rather
+      // than producing an error in the parent
+      error = runProgram("/no/such/program", std::vector<std::string>(), options, &result);
+      CHECK_FALSE(error);
+      CHECK(result.exitStatus != 0);
+   }
+
    test_that("Can spawn multiple sync processes and they all return correct results")
    {
       // create new supervisor
@@ -290,6 +308,47 @@ test_context("ProcessTests")
       }
    }
 
+   test_that("Supervisor with activity monitoring delivers output from many processes")
+   {
+      ProcessSupervisor supervisor;
+
+      std::atomic<int> activityCount(0);
+      supervisor.setActivityHandler([&]() { ++activityCount; });
+
+      const int kNumProcesses = 50;
+      int exitCodes[kNumProcesses];
+      std::string outputs[kNumProcesses];
+      for (int i = 0; i < kNumProcesses; ++i)
+      {
+         exitCodes[i] = -1;
+
+         // produce output after a delay so that children are idle
+         // (and so not read from) for a number of polls first
+         std::string command = "sleep 0.2; echo " + safe_convert::numberToString(i);
+
+         ProcessOptions options;
+         options.threadSafe = true;
+
+         ProcessCallbacks callbacks;
+         callbacks.onExit = boost::bind(&checkExitCode, _1, exitCodes + i);
+         callbacks.onStdout = boost::bind(&appendOutput, _2, outputs + i);
+
+         Error error = supervisor.runCommand(command, options, callbacks);
+         REQUIRE_FALSE(error);
+      }
+
+      bool success = supervisor.wait(boost::posix_time::milliseconds(10),
+                                     boost::posix_time::seconds(10));
+      CHECK(success);
+      CHECK(activityCount > 0);
+
+      for (int i = 0; i < kNumProcesses; ++i)
+      {
+         CHECK(exitCodes[i] == 0);
+         CHECK(outputs[i] == safe_convert::numberToString(i) + "\n");
+      }
+   }
+
    test_that("Can spawn multiple async processes and they all return correct results")
    {
       IoServiceFixture fixture;
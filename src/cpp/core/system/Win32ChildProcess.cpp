@@ -680,7 +680,12 @@ bool AsyncChildProcess::hasRecentOutput() const
       return true;
 }
 
-void AsyncChildProcess::poll()
+std::vector<int> AsyncChildProcess::activityDescriptors() const
+{
+   return std::vector<int>();
+}
+
+void AsyncChildProcess::poll(bool /*pollIO*/)
 {
    // skip polling if we're not on the main thread,
    // and the process options request we run on the main thread only
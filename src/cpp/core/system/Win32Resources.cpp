@@ -64,6 +64,12 @@ Error getTotalMemory(long *pTotalKb, MemoryProvider *pProvider)
    return Success();
 }
 
+Error getProcessTreeResourceUsage(const std::vector<PidType>&,
+                                  std::vector<ProcessTreeResourceUsage>*)
+{
+   return systemError(boost::system::errc::not_supported, ERROR_LOCATION);
+}
+
 } // namespace sytem
 } // namespace core
 } // namespace rstudio
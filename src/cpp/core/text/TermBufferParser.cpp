@@ -15,6 +15,8 @@
 
 #include <core/text/TermBufferParser.hpp>
 
+#include <core/StringUtils.hpp>
+
 namespace rstudio {
 namespace core {
 namespace text {
@@ -267,6 +269,19 @@ std::string stripSecondaryBuffer(const std::string& strInput, bool* pAltBufferAc
    return parse.output;
 }
 
+bool trimScrolledOutput(int maxLines, bool altModeActive, std::string* pOutput)
+{
+   if (altModeActive || maxLines < 1)
+      return false;
+
+   // any alt-buffer sequence results in text being stripped
+   bool altActive = false;
+   if (stripSecondaryBuffer(*pOutput, &altActive).length() != pOutput->length() || altActive)
+      return false;
+
+   return string_utils::trimLeadingLines(maxLines, pOutput);
+}
+
 } // namespace text
 } // namespace core
 } // namespace rstudio
@@ -298,6 +298,42 @@ TEST_CASE("Terminal Buffer Mode Parsing")
    }
 }
 
+TEST_CASE("Terminal Scrolled Output Trimming")
+{
+   std::string lines;
+   for (int i = 0; i < 100; i++)
+      lines.append("line\n");
+
+   SECTION("Short output is untouched")
+   {
+      std::string output("one\ntwo\nthree\n");
+      CHECK_FALSE(core::text::trimScrolledOutput(10, false, &output));
+      CHECK(output == "one\ntwo\nthree\n");
+   }
+
+   SECTION("Long output keeps the final lines")
+   {
+      std::string output = lines + "last";
+      CHECK(core::text::trimScrolledOutput(10, false, &output));
+      CHECK(output == "\n" + lines.substr(0, 50) + "last");
+   }
+
+   SECTION("Output in alt-buffer is untouched")
+   {
+      std::string output = lines;
+      CHECK_FALSE(core::text::trimScrolledOutput(10, true, &output));
+      CHECK(output == lines);
+   }
+
+   SECTION("Output switching buffers is untouched")
+   {
+      std::string output = lines + pStart1 + lines + pEnd1 + lines;
+      std::string expect = output;
+      CHECK_FALSE(core::text::trimScrolledOutput(10, false, &output));
+      CHECK(output == expect);
+   }
+}
+
 } // end namespace tests
 } // end namespace core
 } // end namespace rstudio
@@ -192,6 +192,9 @@ struct RCallbacks
    boost::function<void(const core::FilePath&)> browseFile;
    boost::function<void(const std::string&)> showHelp;
    boost::function<void(const std::string&, core::FilePath&, bool)> showFile;
+   // called for each write R makes to the console, as it's made
+   boost::function<void(const std::string&, int)> consoleOutput;
+   // called with console output in batches (see flushConsoleOutput)
    boost::function<void(const std::string&, int)> consoleWrite;
    boost::function<void()> consoleHistoryReset;
    boost::function<void()> consoleReset;
@@ -260,6 +263,11 @@ void setSaveAction(int saveAction);
 void setImageDirty(bool imageDirty);
 bool imageIsDirty();
 
+// deliver console output which R has written but which has not yet been
+// passed on to the console write callback (must be called on the main thread);
+// the console output callback has already seen it
+void flushConsoleOutput();
+
 // check whether there is a browser context active
 bool browserContextActive();
 
@@ -21,6 +21,7 @@
 
 #include <boost/function.hpp>
 #include <boost/regex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/bind/bind.hpp>
 
 #include <r/RExec.hpp>
@@ -81,6 +82,20 @@ InternalCallbacks s_internalCallbacks;
 // temporarily suppress output
 bool s_suppressOutput = false;
 
+// R frequently writes output in small pieces (e.g. one element of a vector
+// at a time), so console output is accumulated here and written to the
+// console (actions and client) in batches; the console output callback still
+// sees each write as it's made. Pending output is flushed when R calls back
+// for anything other than output, when the output type changes, when the
+// batch grows large or old, and from the session's polled event handler (so
+// output written before a long running computation still shows up promptly).
+std::string s_pendingConsoleOutput;
+int s_pendingConsoleOutputType = 0;
+boost::posix_time::ptime s_pendingConsoleOutputTime;
+const std::size_t kConsoleOutputFlushSize = 64 * 1024;
+const boost::posix_time::time_duration kConsoleOutputFlushInterval =
+      boost::posix_time::milliseconds(20);
+
 class JumpToTopException
 {
 };
@@ -242,6 +257,25 @@ Error saveDefaultGlobalEnvironment()
 
 } // anonymous namespace
 
+void flushConsoleOutput()
+{
+   if (s_pendingConsoleOutput.empty())
+      return;
+
+   // take the pending output first; handlers may write more
+   std::string output;
+   output.swap(s_pendingConsoleOutput);
+   int otype = s_pendingConsoleOutputType;
+
+   // add to console actions
+   int type = otype == 1 ? kConsoleActionOutputError :
+                           kConsoleActionOutput;
+   consoleActions().add(type, output);
+
+   // write
+   s_callbacks.consoleWrite(output, otype);
+}
+
 bool imageIsDirty()
 {
    return R_DirtyImage != 0;
@@ -274,6 +308,9 @@ int RReadConsole(const char *pmt,
 {
    try
    {
+      // write output preceding the prompt
+      flushConsoleOutput();
+
       // capture the prompt for later manipulation
       std::string prompt(pmt);
 
@@ -430,6 +467,7 @@ void RShowMessage(const char* msg)
 {
    try 
    {
+      flushConsoleOutput();
       s_callbacks.showMessage(msg);
    }
    CATCH_UNEXPECTED_EXCEPTION
@@ -453,17 +491,29 @@ void RWriteConsoleEx (const char *buf, int buflen, int otype)
             return;
          }
          
-         // get output
-         std::string output = std::string(buf, buflen);
-         output = util::rconsole2utf8(output);
-         
-         // add to console actions
-         int type = otype == 1 ? kConsoleActionOutputError :
-                                 kConsoleActionOutput;
-         consoleActions().add(type, output);
-         
-         // write
-         s_callbacks.consoleWrite(output, otype);
+         // output of a different type goes in its own batch
+         if (otype != s_pendingConsoleOutputType)
+         {
+            flushConsoleOutput();
+            s_pendingConsoleOutputType = otype;
+         }
+
+         // accumulate output
+         std::string output = util::rconsole2utf8(std::string(buf, buflen));
+         if (s_pendingConsoleOutput.empty())
+            s_pendingConsoleOutputTime = boost::posix_time::microsec_clock::universal_time();
+         s_pendingConsoleOutput.append(output);
+
+         // notify of the write itself
+         s_callbacks.consoleOutput(output, otype);
+
+         // write if the batch is large or old
+         if (s_pendingConsoleOutput.length() >= kConsoleOutputFlushSize ||
+             boost::posix_time::microsec_clock::universal_time() - s_pendingConsoleOutputTime >=
+                kConsoleOutputFlushInterval)
+         {
+            flushConsoleOutput();
+         }
       }
    }
    CATCH_UNEXPECTED_EXCEPTION
@@ -471,6 +521,7 @@ void RWriteConsoleEx (const char *buf, int buflen, int otype)
 
 void RResetConsole()
 {
+   flushConsoleOutput();
    s_callbacks.consoleReset();
 }
 
@@ -479,6 +530,7 @@ int REditFile(const char* file)
 {
    try 
    {
+      flushConsoleOutput();
       return s_callbacks.editFile(r::util::fixPath(file));
    }
    CATCH_UNEXPECTED_EXCEPTION
@@ -491,6 +543,9 @@ void RBusy(int which)
 {
    try
    {
+      // write output preceding the change in busy state
+      flushConsoleOutput();
+
       // synchronize locale whenever R busy state changes
       // (done relatively eagerly to ensure synchronization
       // happens on each REPL iteration after user code is run)
@@ -507,6 +562,7 @@ int RChooseFile (int newFile, char *buf, int len)
 {
    try 
    {
+      flushConsoleOutput();
       FilePath filePath = s_callbacks.chooseFile(newFile == TRUE);
       if (!filePath.isEmpty())
       {
@@ -546,6 +602,7 @@ int RShowFiles (int nfile,
 {
    try 
    {
+      flushConsoleOutput();
       for (int i=0; i<nfile; i++)
       {
          // determine file path and title
@@ -636,6 +693,7 @@ void RSuicide(const char* s)
    // We need to write this to stderr so the parent process (rstudio) can pick up the error message and display it 
    // to the user in case the session log file is not accessbile.
    std::cerr << s << std::endl;
+   flushConsoleOutput();
    s_callbacks.suicide(s);
    s_internalCallbacks.suicide(s);
 }
@@ -679,6 +737,9 @@ void RCleanUp(SA_TYPE saveact, int status, int runLast)
    // of processing
    try
    {
+      // write any remaining output
+      flushConsoleOutput();
+
       // set to default if requested
       if (saveact == SA_DEFAULT)
          saveact = SaveAction;
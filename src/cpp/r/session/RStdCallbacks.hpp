@@ -51,6 +51,8 @@ void RCleanUp(SA_TYPE saveact, int status, int runLast);
 // exported utilities
 void rSuicide(const std::string& msg);
 
+void flushConsoleOutput();
+
 bool imageIsDirty();
 void setImageDirty(bool imageDirty);
 
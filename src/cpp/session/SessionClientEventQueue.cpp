@@ -23,6 +23,7 @@
 #include <core/StringUtils.hpp>
 
 #include <r/session/RConsoleActions.hpp>
+#include <r/session/RSession.hpp>
 
 #include "SessionHttpMethods.hpp"
 
@@ -86,6 +87,11 @@ void ClientEventQueue::add(const ClientEvent& event)
       else
          LOG_DEBUG_MESSAGE("Queued event: " + event.typeName());
    }
+   // R batches up its own console output; deliver it before this event so
+   // that events stay in order (R output is only written on the main thread)
+   if (core::thread::isMainThread())
+      r::session::flushConsoleOutput();
+
    LOCK_MUTEX(*pMutex_)
    {
       // console output is batched up for compactness/efficiency.
@@ -205,7 +211,16 @@ void ClientEventQueue::flushPendingConsoleOutput()
       // truncate it to the amount that the client can show. Too much output
       // can overwhelm the client, causing it to become unresponsive.
       int limit = r::session::consoleActions().capacity() + 1;
-      string_utils::trimLeadingLines(limit, &pendingConsoleOutput_);
+      std::size_t lines = string_utils::countNewlines(pendingConsoleOutput_);
+      if (string_utils::trimLeadingLines(limit, &pendingConsoleOutput_))
+      {
+         // let the user know that output was dropped
+         std::size_t omitted = lines - string_utils::countNewlines(pendingConsoleOutput_);
+         pendingConsoleOutput_.insert(
+                  0,
+                  "[ output truncated: " + safe_convert::numberToString(omitted) +
+                  " lines not shown ]");
+      }
 
       enqueueClientOutputEvent(client_events::kConsoleWriteOutput, 
             pendingConsoleOutput_);
@@ -24,6 +24,8 @@
 #include <session/prefs/UserPrefs.hpp>
 #include <session/SessionConsoleProcessSocket.hpp>
 
+#include <core/text/TermBufferParser.hpp>
+
 #include "modules/SessionWorkbench.hpp"
 #include "SessionConsoleProcessTable.hpp"
 
@@ -42,6 +44,12 @@ ConsoleProcessSocket s_terminalSocket;
 // Posix-only, use is gated via getTrackEnv() always being false on Win32.
 const std::string kEnvCommand = "/usr/bin/env";
 
+// Output is sent to the client at most once per interval; output arriving
+// within the interval is coalesced and sent on the next poll, or as soon as
+// this much of it has accumulated.
+const int kOutputFlushIntervalMs = 16;
+const std::size_t kOutputFlushSize = 64 * 1024;
+
 } // anonymous namespace
 
 void ConsoleProcess::setenv(const std::string& name,
@@ -402,6 +410,9 @@ ConsoleProcess::Input ConsoleProcess::dequeInput()
 
 void ConsoleProcess::enquePromptEvent(const std::string& prompt)
 {
+   // send output preceding the prompt first
+   flushOutput();
+
    // enque a prompt event
    json::Object data;
    data["handle"] = handle();
@@ -433,6 +444,9 @@ void ConsoleProcess::resize(int cols, int rows)
 
 bool ConsoleProcess::onContinue(core::system::ProcessOperations& ops)
 {
+   // send output held back since the last poll
+   maybeFlushOutput();
+
    // full stop interrupt if requested
    if (interrupt_)
       return false;
@@ -565,23 +579,60 @@ void ConsoleProcess::enqueOutputEvent(const std::string &output)
    if (procInfo_->getAltBufferActive() != currentAltBufferStatus)
       saveConsoleProcesses();
 
-   // If there's more output than the client can even show, then
-   // truncate it to the amount that the client can show. Too much
-   // output can overwhelm the client, making it unresponsive.
-   std::string trimmedOutput = output;
-   if (!prefs::userPrefs().limitVisibleConsole())
-      string_utils::trimLeadingLines(procInfo_->getMaxOutputLines(), &trimmedOutput);
+   // hold the output back if we've sent some recently; this coalesces
+   // chatty output into fewer (larger) messages to the client
+   pendingOutput_.append(output);
+   maybeFlushOutput();
+}
+
+void ConsoleProcess::maybeFlushOutput()
+{
+   if (pendingOutput_.empty())
+      return;
+
+   if (pendingOutput_.length() >= kOutputFlushSize ||
+       lastOutputFlushTime_.is_not_a_date_time() ||
+       boost::posix_time::microsec_clock::universal_time() - lastOutputFlushTime_ >=
+          boost::posix_time::milliseconds(kOutputFlushIntervalMs))
+   {
+      flushOutput();
+   }
+}
+
+void ConsoleProcess::flushOutput()
+{
+   if (pendingOutput_.empty())
+      return;
+
+   std::string output;
+   output.swap(pendingOutput_);
+   lastOutputFlushTime_ = boost::posix_time::microsec_clock::universal_time();
 
    if (procInfo_->getChannelMode() == Websocket)
    {
+      // If the output is outrunning the client, only send what would remain
+      // in the terminal's scrollback; the rest would be scrolled away as soon
+      // as it was rendered (and is still available from the saved buffer).
+      if (output.length() >= kOutputFlushSize)
+      {
+         core::text::trimScrolledOutput(procInfo_->getMaxOutputLines(),
+                                        procInfo_->getAltBufferActive(),
+                                        &output);
+      }
       s_terminalSocket.sendText(procInfo_->getHandle(), output);
       return;
    }
 
+   // If there's more output than the client can even show, then
+   // truncate it to the amount that the client can show. Too much
+   // output can overwhelm the client, making it unresponsive.
+   if (!prefs::userPrefs().limitVisibleConsole())
+      string_utils::trimLeadingLines(procInfo_->getMaxOutputLines(), &output);
+
    // Rpc
    json::Object data;
    data["handle"] = handle();
-   data["output"] = trimmedOutput;
+   data["output"] = output;
    module_context::enqueClientEvent(
          ClientEvent(client_events::kConsoleProcessOutput, data));
 }
@@ -674,6 +725,8 @@ void ConsoleProcess::handleConsolePrompt(core::system::ProcessOperations& ops,
 
 void ConsoleProcess::onExit(int exitCode)
 {
+   flushOutput();
+
    procInfo_->setExitCode(exitCode);
    procInfo_->setHasChildProcs(false);
 
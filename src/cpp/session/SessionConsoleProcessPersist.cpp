@@ -17,6 +17,11 @@
 
 #include <gsl/gsl>
 
+#include <boost/bind/bind.hpp>
+#include <boost/function.hpp>
+
+#include <shared_core/SafeConvert.hpp>
+
 #include <core/FileSerializer.hpp>
 
 #include <session/SessionModuleContext.hpp>
@@ -24,6 +29,7 @@
 #include <session/projects/SessionProjects.hpp>
 
 using namespace rstudio::core;
+using namespace boost::placeholders;
 
 namespace rstudio {
 namespace session {
@@ -62,6 +68,15 @@ FilePath s_consoleProcPath;
 FilePath s_consoleProcIndexPath;
 bool s_inited = false;
 const std::string s_envFileExt = ".env";
+const std::string s_startFileExt = ".start";
+const std::string s_tempFileExt = ".tmp";
+
+// size of blocks used when scanning the saved buffer
+const std::size_t kScanBlockSize = 64 * 1024;
+
+// the dead region at the front of a saved buffer is only reclaimed once it
+// is at least this large (and larger than the live region)
+const uintmax_t kMinCompactSize = 1024 * 1024;
 
 void initialize()
 {
@@ -130,6 +145,201 @@ Error getEnvFilePath(const std::string& handle, FilePath* pFile)
    return Success();
 }
 
+// The saved buffer is an append-only log; trimming it to the maximum number
+// of lines only advances a start offset (persisted alongside the log in a
+// small sidecar file) rather than rewriting the log. The space in front of
+// the start offset is reclaimed occasionally, once it outgrows the buffer.
+FilePath getStartFilePath(const FilePath& log)
+{
+   return log.getParent().completePath(log.getFilename() + s_startFileExt);
+}
+
+uintmax_t readStartOffset(const FilePath& log, uintmax_t logSize)
+{
+   FilePath startFile = getStartFilePath(log);
+   if (!startFile.exists())
+      return 0;
+
+   std::string contents;
+   Error error = core::readStringFromFile(startFile, &contents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return 0;
+   }
+
+   // an offset past the end of the log means the log was replaced
+   // without the offset being updated; treat the whole log as live
+   uintmax_t offset = safe_convert::stringTo<uintmax_t>(
+            string_utils::trimWhitespace(contents), 0);
+   return offset <= logSize ? offset : 0;
+}
+
+void writeStartOffset(const FilePath& log, uintmax_t offset)
+{
+   FilePath startFile = getStartFilePath(log);
+
+   Error error = (offset == 0) ?
+            startFile.removeIfExists() :
+            core::writeStringToFile(startFile, safe_convert::numberToString(offset));
+   if (error)
+      LOG_ERROR(error);
+}
+
+Error readRange(const FilePath& log,
+                uintmax_t offset,
+                uintmax_t length,
+                std::string* pContent)
+{
+   pContent->clear();
+   if (length == 0)
+      return Success();
+
+   std::shared_ptr<std::istream> pStream;
+   Error error = log.openForRead(pStream);
+   if (error)
+      return error;
+
+   try
+   {
+      pContent->resize(static_cast<std::size_t>(length));
+      pStream->seekg(static_cast<std::streamoff>(offset));
+      pStream->read(&(*pContent)[0], static_cast<std::streamsize>(length));
+      pContent->resize(static_cast<std::size_t>(pStream->gcount()));
+   }
+   catch (const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error,
+                                e.what(),
+                                ERROR_LOCATION);
+      error.addProperty("path", log);
+      return error;
+   }
+
+   return Success();
+}
+
+// Scan the live region [start, end) of the log backwards, calling the
+// callback with the absolute offset of each newline found until it returns
+// false. This mirrors string_utils::trimLeadingLines without requiring the
+// log to be read into memory.
+Error scanNewlinesBackward(const FilePath& log,
+                           uintmax_t start,
+                           uintmax_t end,
+                           const boost::function<bool(uintmax_t)>& callback)
+{
+   std::string block;
+   uintmax_t blockEnd = end;
+   while (blockEnd > start)
+   {
+      uintmax_t blockStart = blockEnd - std::min<uintmax_t>(blockEnd - start, kScanBlockSize);
+      Error error = readRange(log, blockStart, blockEnd - blockStart, &block);
+      if (error)
+         return error;
+
+      for (std::size_t i = block.size(); i > 0; --i)
+      {
+         if (block[i - 1] == '\n' && !callback(blockStart + i - 1))
+            return Success();
+      }
+
+      blockEnd = blockStart;
+   }
+
+   return Success();
+}
+
+bool recordTrimOffset(int maxLines, int* pLineCount, uintmax_t* pOffset, uintmax_t offset)
+{
+   if (++*pLineCount > maxLines)
+   {
+      *pOffset = offset;
+      return false;
+   }
+   return true;
+}
+
+void compactLog(const FilePath& log, uintmax_t start, uintmax_t end)
+{
+   std::string live;
+   Error error = readRange(log, start, end - start, &live);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   FilePath tempFile = log.getParent().completePath(log.getFilename() + s_tempFileExt);
+   error = core::writeStringToFile(tempFile, live);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   // drop the offset before replacing the log: if we're interrupted in
+   // between, the old log is simply treated as untrimmed
+   writeStartOffset(log, 0);
+
+   error = tempFile.move(log, FilePath::MoveDirect, true);
+   if (error)
+   {
+      LOG_ERROR(error);
+      error = tempFile.removeIfExists();
+      if (error)
+         LOG_ERROR(error);
+
+      // the old log is still in place; keep the trimmed offset
+      writeStartOffset(log, start);
+   }
+}
+
+// Trim the saved buffer to the given number of lines (if maxLines > 0) and
+// return the extent of the live region of the log.
+Error trimSavedBuffer(const FilePath& log,
+                      int maxLines,
+                      uintmax_t* pStart,
+                      uintmax_t* pEnd)
+{
+   *pStart = 0;
+   *pEnd = 0;
+   if (!log.exists())
+      return Success();
+
+   uintmax_t end = log.getSize();
+   uintmax_t start = readStartOffset(log, end);
+   *pStart = start;
+   *pEnd = end;
+
+   if (maxLines < 1 || end - start <= static_cast<uintmax_t>(maxLines) * 2)
+      return Success();
+
+   int lineCount = 0;
+   uintmax_t newStart = start;
+   Error error = scanNewlinesBackward(
+            log, start, end,
+            boost::bind(recordTrimOffset, maxLines, &lineCount, &newStart, _1));
+   if (error)
+      return error;
+
+   if (newStart == start)
+      return Success();
+
+   if (newStart > kMinCompactSize && newStart > end - newStart)
+   {
+      compactLog(log, newStart, end);
+      *pStart = readStartOffset(log, log.getSize());
+      *pEnd = log.getSize();
+   }
+   else
+   {
+      writeStartOffset(log, newStart);
+      *pStart = newStart;
+   }
+
+   return Success();
+}
+
 } // anonymous namespace
 
 std::string loadConsoleProcessMetadata()
@@ -178,35 +388,100 @@ std::string getSavedBuffer(const std::string& handle, int maxLines)
       return "";
    }
 
-   error = core::readStringFromFile(log, &content);
+   // Trim the buffer based on maxLines. Otherwise it can grow without
+   // bound until the terminal is closed or cleared.
+   uintmax_t start, end;
+   error = trimSavedBuffer(log, maxLines, &start, &end);
    if (error)
    {
       LOG_ERROR(error);
       return content;
    }
 
-   if (maxLines < 1)
-      return content;
+   error = readRange(log, start, end - start, &content);
+   if (error)
+      LOG_ERROR(error);
+   return content;
+}
 
-   // Trim the buffer based on maxLines. Otherwise it can grow without
-   // bound until the terminal is closed or cleared.
-   std::string trimmedOutput = content;
-   if (string_utils::trimLeadingLines(maxLines, &trimmedOutput))
+std::string getSavedBufferChunk(const std::string& handle,
+                                int maxLines,
+                                int chunk,
+                                std::size_t chunkSize,
+                                bool* pMoreAvailable)
+{
+   *pMoreAvailable = false;
+
+   FilePath log;
+   Error error = getLogFilePath(handle, &log);
+   if (error)
    {
-      error = core::writeStringToFile(log, trimmedOutput);
-      if (error)
-      {
-          LOG_ERROR(error);
-          return content;
-      }
+      LOG_ERROR(error);
+      return std::string();
+   }
+
+   if (!log.exists() || chunk < 0)
+      return std::string();
+
+   uintmax_t start, end;
+   error = trimSavedBuffer(log, maxLines, &start, &end);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return std::string();
    }
-   return trimmedOutput;
+
+   // Chunk requested past end of buffer?
+   uintmax_t length = end - start;
+   uintmax_t chunkStart = static_cast<uintmax_t>(chunk) * chunkSize;
+   if (chunkStart >= length)
+      return std::string();
+
+   uintmax_t chunkLength = std::min<uintmax_t>(chunkSize, length - chunkStart);
+   std::string content;
+   error = readRange(log, start + chunkStart, chunkLength, &content);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return std::string();
+   }
+
+   *pMoreAvailable = chunkStart + content.length() < length;
+   return content;
 }
 
 int getSavedBufferLineCount(const std::string& handle, int maxLines)
 {
-   std::string buffer = getSavedBuffer(handle, maxLines);
-   return gsl::narrow_cast<int>(string_utils::countNewlines(buffer) + 1);
+   FilePath log;
+   Error error = getLogFilePath(handle, &log);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return 1;
+   }
+
+   uintmax_t start, end;
+   error = trimSavedBuffer(log, maxLines, &start, &end);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return 1;
+   }
+
+   std::size_t newlines = 0;
+   std::string block;
+   for (uintmax_t offset = start; offset < end; offset += kScanBlockSize)
+   {
+      error = readRange(log, offset, std::min<uintmax_t>(kScanBlockSize, end - offset), &block);
+      if (error)
+      {
+         LOG_ERROR(error);
+         break;
+      }
+      newlines += string_utils::countNewlines(block);
+   }
+
+   return gsl::narrow_cast<int>(newlines + 1);
 }
 
 void appendToOutputBuffer(const std::string& handle, const std::string& buffer)
@@ -248,34 +523,38 @@ void deleteLogFile(const std::string &handle, bool lastLineOnly)
          LOG_ERROR(error);
          return;
       }
+
+      writeStartOffset(log, 0);
    }
    else
    {
-      // read the file, remove last line and rewrite buffer
-      std::string content;
-      error = core::readStringFromFile(log, &content);
+      // find the final newline in the live region of the buffer
+      uintmax_t end = log.getSize();
+      uintmax_t start = readStartOffset(log, end);
+      uintmax_t lastNewline = end;
+      error = scanNewlinesBackward(
+               log, start, end,
+               [&](uintmax_t offset) { lastNewline = offset; return false; });
       if (error)
       {
          LOG_ERROR(error);
          return;
       }
 
-      size_t lastNewline = content.find_last_of('\n');
-
       // no complete line in buffer, just blow it away
-      if (lastNewline == std::string::npos)
+      if (lastNewline == end)
       {
          deleteLogFile(handle, false);
          return;
       }
 
-      // erase everything after the final newline
-      content.erase(++lastNewline);
-      error = core::writeStringToFile(log, content);
-      if (error)
-      {
-          LOG_ERROR(error);
-      }
+      // buffer already ends with a complete line
+      if (start == 0 && lastNewline + 1 == end)
+         return;
+
+      // erase everything after the final newline; rewriting only the
+      // live region also reclaims any trimmed space
+      compactLog(log, start, lastNewline + 1);
    }
 }
 
@@ -20,6 +20,7 @@
 
 #include <sstream>
 
+#include <core/StringUtils.hpp>
 #include <core/system/Environment.hpp>
 
 namespace rstudio {
@@ -168,6 +169,44 @@ TEST_CASE("ConsoleProcess Persistence")
       CHECK((loaded.compare(expect) == 0));
    }
 
+   SECTION("Append after trimming then read chunks")
+   {
+      std::stringstream ss;
+      for (size_t i = 0; i < maxLines * 2; i++)
+         ss << i << '\n';
+      std::string orig = ss.str();
+      console_persist::appendToOutputBuffer(handle2, orig);
+      std::string expect = orig;
+      core::string_utils::trimLeadingLines(maxLines, &expect);
+      std::string loaded = console_persist::getSavedBuffer(handle2, maxLines);
+      CHECK((loaded.compare(expect) == 0));
+
+      std::string tail("more output\nno newline");
+      console_persist::appendToOutputBuffer(handle2, tail);
+      expect.append(tail);
+      loaded = console_persist::getSavedBuffer(handle2, 0);
+      CHECK((loaded.compare(expect) == 0));
+
+      bool moreAvailable;
+      const size_t chunkSize = 100;
+      loaded = console_persist::getSavedBufferChunk(handle2, 0, 0, chunkSize, &moreAvailable);
+      CHECK((loaded.compare(expect.substr(0, chunkSize)) == 0));
+      CHECK(moreAvailable);
+
+      int lastChunk = static_cast<int>((expect.length() - 1) / chunkSize);
+      loaded = console_persist::getSavedBufferChunk(handle2, 0, lastChunk, chunkSize, &moreAvailable);
+      CHECK((loaded.compare(expect.substr(lastChunk * chunkSize)) == 0));
+      CHECK_FALSE(moreAvailable);
+
+      loaded = console_persist::getSavedBufferChunk(handle2, 0, lastChunk + 1, chunkSize, &moreAvailable);
+      CHECK(loaded.empty());
+      CHECK_FALSE(moreAvailable);
+
+      console_persist::deleteLogFile(handle2, true);
+      loaded = console_persist::getSavedBuffer(handle2, 0);
+      CHECK((loaded.compare(expect.substr(0, expect.length() - 10)) == 0));
+   }
+
    SECTION("Delete unknown log files")
    {
       std::string orig1("hello how are you?\nthat is good\nhave a nice day");
@@ -40,6 +40,7 @@
 #include <core/json/JsonRpc.hpp>
 
 #include <core/system/Crypto.hpp>
+#include <core/system/Process.hpp>
 
 #include <core/text/TemplateFilter.hpp>
 
@@ -194,6 +195,12 @@ Error startHttpConnectionListener()
    if (error)
       return error;
 
+   // wake up waitForMethod as soon as a child process has output or exits
+   // (rather than waiting for the connection queue timeout to elapse)
+   module_context::processSupervisor().setActivityHandler(
+            boost::bind(&HttpConnectionQueue::wakeWaiters,
+                        &httpConnectionListener().mainConnectionQueue()));
+
    if (options().standalone())
    {
       // log the endpoint to which we have bound to so other services can discover us
@@ -262,6 +269,10 @@ void polledEventHandler()
    if (microsec_clock::universal_time() <= (s_lastPerformed + s_intervalMs))
       return;
 
+   // deliver console output R has written since the last time it called
+   // back (e.g. output written before a long running computation)
+   rstudio::r::session::flushConsoleOutput();
+
    // notify modules
    module_context::onBackgroundProcessing(false);
 
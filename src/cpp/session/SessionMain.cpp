@@ -156,6 +156,7 @@
 #include "modules/SessionRPubs.hpp"
 #include "modules/SessionRHooks.hpp"
 #include "modules/SessionRSConnect.hpp"
+#include "modules/SessionRTokenCache.hpp"
 #include "modules/SessionShinyViewer.hpp"
 #include "modules/SessionSpelling.hpp"
 #include "modules/SessionSource.hpp"
@@ -600,6 +601,7 @@ Error rInit(const rstudio::r::session::RInitInfo& rInitInfo)
       (modules::packrat::initialize)
       (modules::renv::initialize)
       (modules::rhooks::initialize)
+      (modules::token_cache::initialize)
       (modules::r_packages::initialize)
       (modules::diagnostics::initialize)
       (modules::markers::initialize)
@@ -936,13 +938,18 @@ void rConsoleWrite(const std::string& output, int otype)
    int event = otype == 1 ? kConsoleWriteError : kConsoleWriteOutput;
    ClientEvent writeEvent(event, output);
    rsession::clientEventQueue().add(writeEvent);
+}
+
+void rConsoleOutput(const std::string& output, int otype)
+{
+   if (main_process::wasForked())
+      return;
 
    // fire event
    module_context::events().onConsoleOutput(
                   otype == 1 ? module_context::ConsoleOutputError :
                                module_context::ConsoleOutputNormal,
                   output);
-
 }
 
 void rConsoleHistoryReset()
@@ -1130,6 +1137,9 @@ void rSuspended(const rstudio::r::session::RSuspendOptions& options)
 
    // fire event
    module_context::onSuspended(options, &(persistentState().settings()));
+
+   // write out any state changes that haven't been written yet
+   persistentState().flush();
 }
 
 void rResumed()
@@ -1253,6 +1263,9 @@ void rCleanup(bool terminatedNormally)
       // fire shutdown event to modules
       module_context::events().onShutdown(terminatedNormally);
 
+      // write out any state changes that haven't been written yet
+      rsession::persistentState().flush();
+
       // destroy session if requested
       if (s_destroySession)
       {
@@ -2308,6 +2321,7 @@ int main(int argc, char * const argv[])
       rCallbacks.showFile = rShowFile;
       rCallbacks.chooseFile = rChooseFile;
       rCallbacks.busy = rBusy;
+      rCallbacks.consoleOutput = rConsoleOutput;
       rCallbacks.consoleWrite = rConsoleWrite;
       rCallbacks.consoleHistoryReset = rConsoleHistoryReset;
       rCallbacks.consoleReset = rConsoleReset;
@@ -15,6 +15,8 @@
 
 #include <session/SessionPersistentState.hpp>
 
+#include <boost/bind/bind.hpp>
+
 #include <core/Log.hpp>
 #include <shared_core/Error.hpp>
 #include <shared_core/FilePath.hpp>
@@ -38,6 +40,10 @@ namespace session {
 namespace {
 const char * const kActiveClientId = "active-client-id";
 const char * const kAbend = "abend";
+
+// delay before writing changed state; coalesces the many small changes
+// made (particularly during startup) into a single write
+const int kFlushDelayMs = 1000;
 }
    
 PersistentState& persistentState()
@@ -51,6 +57,9 @@ Error PersistentState::initialize()
    serverMode_ = (session::options().programMode() ==
                   kSessionProgramModeServer);
 
+   settings_.setWriteBehind(boost::bind(&PersistentState::scheduleFlush, this));
+   sessionSettings_.setWriteBehind(boost::bind(&PersistentState::scheduleFlush, this));
+
    // always the same so that we can supporrt a restart of
    // the session without reloading the client page
    desktopClientId_ = "33e600bb-c1b1-46bf-b562-ab5cba070b0e";
@@ -68,6 +77,25 @@ Error PersistentState::initialize()
    return sessionSettings_.initialize(statePath);
 }
 
+void PersistentState::scheduleFlush()
+{
+   module_context::scheduleDelayedWork(
+            boost::posix_time::milliseconds(kFlushDelayMs),
+            boost::bind(&PersistentState::flush, this),
+            false);
+}
+
+void PersistentState::flush()
+{
+   Error error = settings_.flush();
+   if (error)
+      LOG_ERROR(error);
+
+   error = sessionSettings_.flush();
+   if (error)
+      LOG_ERROR(error);
+}
+
 std::string PersistentState::activeClientId()
 {
    if (serverMode_)
@@ -126,7 +154,12 @@ void PersistentState::setAbend(bool abend)
 { 
    if (serverMode_)
    {
+      // written immediately, since the point of the flag is to survive
+      // the session going away unexpectedly
       sessionSettings_.set(kAbend, abend);
+      Error error = sessionSettings_.flush();
+      if (error)
+         LOG_ERROR(error);
    }
 }
 
@@ -35,8 +35,6 @@
 
 #include <core/system/System.hpp>
 
-#include <core/http/Util.hpp>
-
 #include <r/RUtil.hpp>
 #include <r/RSexp.hpp>
 #include <r/RRoutines.hpp>
@@ -49,19 +47,15 @@
 #include <session/prefs/UserPrefs.hpp>
 #include <session/prefs/Preferences.hpp>
 
+#include "SessionSourceDatabaseStore.hpp"
 #include "SessionSourceDatabaseSupervisor.hpp"
 
 #define kContentsSuffix "-contents"
 
 // NOTE: if a file is deleted then its properties database entry is not
-// deleted. this has two implications:
-//
-//   - storage is not reclaimed
-//   - the properties can be "resurrected" and re-attached to another
-//     file with the same path
-//
-// One way to overcome this might be to use filesystem metadata to store
-// properties rather than a side-database
+// deleted, so the properties can be "resurrected" and re-attached to
+// another file with the same path. storage is bounded by pruning the
+// least recently written entries (see kMaxDurableProperties)
 
 using namespace rstudio::core;
 using namespace boost::placeholders;
@@ -79,12 +73,14 @@ std::map<std::string, std::string> s_idToPath;
 // cached mapping of document last write times
 std::map<std::string, std::time_t> s_lastWriteTimes;
 
-struct PropertiesDatabase
-{
-   FilePath path;
-   FilePath indexFile;
-   std::map<std::string,std::string> index;
-};
+// maximum number of paths for which durable properties are kept
+const int kMaxDurableProperties = 5000;
+
+// a document's journal of edits is compacted into its contents once it
+// holds this many edits, or once its text outweighs half of the contents
+// (with a floor, so small documents aren't rewritten on every other edit)
+const std::size_t kMaxJournalEdits = 500;
+const std::size_t kMinJournalCompactionBytes = 64 * 1024;
 
 void cacheLastWriteTime(const std::string& path, std::time_t lastWriteTime)
 {
@@ -100,84 +96,62 @@ std::time_t getCachedLastWriteTime(const std::string& path)
       return 0;
 }
 
-Error getPropertiesDatabase(PropertiesDatabase* pDatabase)
+store::PropertiesStore& propertiesStore()
 {
-   pDatabase->path = module_context::scopedScratchPath().completePath(kSessionSourceDatabasePrefix "/prop");
-   Error error = pDatabase->path.ensureDirectory();
-   if (error)
-      return error;
-
-   pDatabase->indexFile = pDatabase->path.completePath("INDEX");
-
-   if (pDatabase->indexFile.exists())
-      return readStringMapFromFile(pDatabase->indexFile, &(pDatabase->index));
-   else
-      return Success();
+   static store::PropertiesStore instance;
+   return instance;
 }
 
-Error putProperties(const std::string& path, const json::Object& properties)
+Error openPropertiesStore()
 {
-   // url escape path (so we can use key=value persistence)
-   std::string escapedPath = http::util::urlEncode(path);
+   if (propertiesStore().isOpen())
+      return Success();
 
-   // get properties database
-   PropertiesDatabase propertiesDB;
-   Error error = getPropertiesDatabase(&propertiesDB);
+   FilePath propertiesDir = module_context::scopedScratchPath().completePath(
+            kSessionSourceDatabasePrefix "/prop");
+   Error error = propertiesStore().open(
+            propertiesDir.completePath(kDurablePropertiesDatabase));
    if (error)
       return error;
 
-   // use existing properties file if it exists, otherwise create new
-   bool updateIndex = false;
-   std::string propertiesFile = propertiesDB.index[escapedPath];
-   if (propertiesFile.empty())
-   {
-      FilePath propFile = file_utils::uniqueFilePath(propertiesDB.path);
-      propertiesFile = propFile.getFilename();
-      propertiesDB.index[escapedPath] = propertiesFile;
-      updateIndex = true;
-   }
+   error = propertiesStore().migrate(propertiesDir);
+   if (error)
+      LOG_ERROR(error);
 
-   // write the file
-   FilePath propertiesFilePath = propertiesDB.path.completePath(propertiesFile);
-   error = writeStringToFile(propertiesFilePath, properties.writeFormatted());
+   error = propertiesStore().prune(kMaxDurableProperties);
+   if (error)
+      LOG_ERROR(error);
+
+   return Success();
+}
+
+Error putProperties(const std::string& path, const json::Object& properties)
+{
+   Error error = openPropertiesStore();
    if (error)
       return error;
 
-   // update the index if necessary
-   if (updateIndex)
-      return writeStringMapToFile(propertiesDB.indexFile, propertiesDB.index);
-   else
-      return Success();
+   return propertiesStore().put(path, properties.write());
 }
 
 Error getProperties(const std::string& path, json::Object* pProperties)
 {
-   // url escape path (so we can use key=value persistence)
-   std::string escapedPath = http::util::urlEncode(path);
+   Error error = openPropertiesStore();
+   if (error)
+      return error;
 
-   // get properties database
-   PropertiesDatabase propertiesDB;
-   Error error = getPropertiesDatabase(&propertiesDB);
+   std::string contents;
+   error = propertiesStore().get(path, &contents);
    if (error)
       return error;
 
-   // check for properties file
-   std::string propertiesFile = propertiesDB.index[escapedPath];
-   if (propertiesFile.empty())
+   // return empty object if there are none
+   if (contents.empty())
    {
-      // return empty object if there is none
       *pProperties = json::Object();
       return Success();
    }
 
-   // read the properties file
-   std::string contents;
-   FilePath propertiesFilePath = propertiesDB.path.completePath(propertiesFile);
-   error = readStringFromFile(propertiesFilePath, &contents,
-                              options().sourceLineEnding());
-   if (error)
-      return error;
-
    // parse the json
    json::Value value;
    if ( value.parse(contents) )
@@ -229,32 +203,6 @@ std::string pathFromProjectPath(json::Value projPathJson)
       return std::string();
 }
 
-Error attemptContentsMigration(json::Object& propertiesJson,
-                               const FilePath& propertiesPath)
-{
-   // extract contents from properties (if it exists)
-   if (propertiesJson.find("contents") == propertiesJson.end())
-      return Success();
-   
-   json::Value contentsJson = propertiesJson["contents"];
-   if (!json::isType<std::string>(contentsJson))
-      return Success();
-   
-   // if the contents string is empty, bail (no need to migrate empty document;
-   // also signals that an earlier migration occurred)
-   std::string contents = contentsJson.getString();
-   if (contents.empty())
-      return Success();
-   
-   // if we already have a contents file, bail (migration already occurred)
-   FilePath contentsPath(propertiesPath.getAbsolutePath() + kContentsSuffix);
-   if (contentsPath.exists())
-      return Success();
-   
-   // write contents sidecar file
-   return writeStringToFile(contentsPath, contents);
-}
-
 bool isIntendedAsReadOnly(const std::string& contents,
                           std::vector<std::string>* pAlternatives)
 {
@@ -319,6 +267,36 @@ SourceDocument::SourceDocument(const std::string& type)
 }
    
 
+const std::string& SourceDocument::contents() const
+{
+   // contents can't be loaded once the store has closed (e.g. while the
+   // session suspends); they're only marked as loaded once they have been,
+   // so that a later put can't replace the stored contents with nothing
+   if (!contentsLoaded_ && store::documentStore().isOpen())
+   {
+      store::StoredDocument stored;
+      Error error = store::documentStore().get(id_, true, &stored);
+      if (error)
+      {
+         LOG_ERROR(error);
+      }
+      else
+      {
+         contents_ = stored.contents;
+         contentsLoaded_ = true;
+      }
+   }
+
+   return contents_;
+}
+
+void SourceDocument::setContentsNotLoaded(const std::string& hash)
+{
+   contents_.clear();
+   contentsLoaded_ = false;
+   hash_ = hash;
+}
+
 std::string SourceDocument::getProperty(const std::string& name) const
 {
    json::Object::Iterator it = properties_.find(name);
@@ -345,10 +323,19 @@ bool SourceDocument::isUntitled() const
 void SourceDocument::setContents(const std::string& contents)
 {
    contents_ = contents;
+   contentsLoaded_ = true;
    hash_ = hash::crc32Hash(contents_);
    lastContentUpdate_ = static_cast<std::time_t>(date_time::millisecondsSinceEpoch());
 }
 
+void SourceDocument::setContents(const std::string& contents, const std::string& hash)
+{
+   contents_ = contents;
+   contentsLoaded_ = true;
+   hash_ = hash;
+   lastContentUpdate_ = static_cast<std::time_t>(date_time::millisecondsSinceEpoch());
+}
+
 // set contents from file
 Error SourceDocument::setPathAndContents(const std::string& path,
                                          bool allowSubstChars)
@@ -395,7 +382,7 @@ Error SourceDocument::contentsMatchDisk(bool *pMatches)
       if (error)
          return error;
 
-      *pMatches = contents_.length() == contents.length() && 
+      *pMatches = this->contents().length() == contents.length() && 
                   hash_ == hash::crc32Hash(contents);
    }
 
@@ -406,7 +393,7 @@ Error SourceDocument::updateDirty()
 {
    if (path().empty())
    {
-      dirty_ = !contents_.empty();
+      dirty_ = !contents().empty();
    }
    else if (dirty_)
    {
@@ -604,7 +591,7 @@ Error SourceDocument::writeToFile(const FilePath& filePath, bool writeContents,
    {
       FilePath contentsPath(filePath.getAbsolutePath() + kContentsSuffix);
       Error error = writeStringToFile(contentsPath,
-                                      contents_,
+                                      contents(),
                                       string_utils::LineEndingPassthrough,
                                       true,
                                       saveTimeout);
@@ -669,42 +656,16 @@ Error get(const std::string& id, boost::shared_ptr<SourceDocument> pDoc)
    return get(id, true, pDoc);
 }
    
-Error get(const std::string& id, bool includeContents, boost::shared_ptr<SourceDocument> pDoc)
+Error readFromStoredDocument(const store::StoredDocument& stored,
+                             bool includeContents,
+                             boost::shared_ptr<SourceDocument> pDoc)
 {
-   FilePath propertiesPath = source_database::path().completePath(id);
-   
-   // attempt to read file contents from sidecar file if available
-   std::string contents;
-   if (includeContents)
-   {
-      FilePath contentsPath(propertiesPath.getAbsolutePath() + kContentsSuffix);
-      if (contentsPath.exists())
-      {
-         Error error = readStringFromFile(contentsPath,
-                                          &contents,
-                                          options().sourceLineEnding());
-         if (error)
-            LOG_ERROR(error);
-      }
-   }
-   
-   if (!propertiesPath.exists())
-      return core::fileNotFoundError(propertiesPath, ERROR_LOCATION);
-   
-   // read the contents of the file
-   std::string properties;
-   Error error = readStringFromFile(propertiesPath,
-                                    &properties,
-                                    options().sourceLineEnding());
-   if (error)
-      return error;
-   
    // parse the json
    json::Value value;
-   if (value.parse(properties))
+   if (value.parse(stored.properties))
    {
       Error error = systemError(boost::system::errc::invalid_argument, ERROR_LOCATION);
-      error.addProperty("path", propertiesPath);
+      error.addProperty("id", stored.id);
       return error;
    }
    
@@ -712,26 +673,49 @@ Error get(const std::string& id, bool includeContents, boost::shared_ptr<SourceD
    if (!value.isObject())
    {
       Error error = systemError(boost::system::errc::protocol_error, ERROR_LOCATION);
-      error.addProperty("path", propertiesPath);
+      error.addProperty("id", stored.id);
       return error;
    }
    
    // initialize doc from json
    json::Object jsonDoc = value.getObject();
-   
-   // migration: if we have a 'contents' field, but no '-contents' side-car
-   // file, perform a one-time generation of that sidecar file from contents
-   error = attemptContentsMigration(jsonDoc, propertiesPath);
+   jsonDoc["contents"] = includeContents ? stored.contents : std::string();
+   Error error = pDoc->readFromJson(&jsonDoc);
    if (error)
-      LOG_ERROR(error);
-   
-   if (includeContents && !contents.empty())
-      jsonDoc["contents"] = contents;
-   
-   if (jsonDoc.find("contents") == jsonDoc.end())
-      jsonDoc["contents"] = std::string();
-   
-   return pDoc->readFromJson(&jsonDoc);
+      return error;
+
+   // without the contents, take the hash of the stored contents
+   // (they are read if and when they are needed)
+   if (!includeContents)
+   {
+      json::Value hash = jsonDoc["hash"];
+      if (!json::isType<std::string>(hash))
+      {
+         // no recorded hash (written by an older version) so read it all
+         store::StoredDocument withContents;
+         Error error = store::documentStore().get(stored.id, true, &withContents);
+         if (error)
+            return error;
+         return readFromStoredDocument(withContents, true, pDoc);
+      }
+
+      pDoc->setContentsNotLoaded(hash.getString());
+   }
+
+   return Success();
+}
+
+Error get(const std::string& id, bool includeContents, boost::shared_ptr<SourceDocument> pDoc)
+{
+   store::StoredDocument stored;
+   Error error = store::documentStore().get(id, includeContents, &stored);
+   if (error)
+   {
+      error.addProperty("id", id);
+      return error;
+   }
+
+   return readFromStoredDocument(stored, includeContents, pDoc);
 }
 
 Error getDurableProperties(const std::string& path, json::Object* pProperties)
@@ -750,6 +734,7 @@ bool isSourceDocument(const FilePath& filePath)
        filename == "suspend_file" ||
        filename == "restart_file" ||
        boost::algorithm::starts_with(filename, ".rstudio-lock") ||
+       boost::algorithm::starts_with(filename, kSourceDocumentsDatabase) ||
        boost::algorithm::ends_with(filename, kContentsSuffix))
    {
       return false;
@@ -768,15 +753,7 @@ void logUnsafeSourceDocument(const FilePath& filePath,
    LOG_WARNING_MESSAGE(msg);
 }
 
-bool hasNullByteSequence(const std::string& contents)
-{
-   std::string nullBytes;
-   nullBytes.push_back('\0');
-   nullBytes.push_back('\0');
-   return boost::algorithm::contains(contents, nullBytes);
-}
-
-bool isSafeSourceDocument(const FilePath& docDbPath,
+bool isSafeSourceDocument(const store::StoredDocument& stored,
                           boost::shared_ptr<SourceDocument> pDoc)
 {
    // get a filepath and use it for filtering if we can
@@ -791,8 +768,10 @@ bool isSafeSourceDocument(const FilePath& docDbPath,
       }
    }
 
-   // get the size of the file in KB
-   uintmax_t docSizeKb = docDbPath.getSize() / 1024;
+   // get the size of the stored document in KB (its properties and contents,
+   // as for the individual files documents were previously stored in; the
+   // contents are what the limits below are concerned with)
+   uintmax_t docSizeKb = (stored.properties.size() + stored.contentsSize) / 1024;
    std::string kbStr = safe_convert::numberToString(docSizeKb);
 
    // if it's larger than 5MB then always drop it (that's the limit
@@ -812,7 +791,7 @@ bool isSafeSourceDocument(const FilePath& docDbPath,
    }
 
    // if it has a sequence of 2 null bytes then drop it
-   else if (hasNullByteSequence(pDoc->contents()))
+   else if (stored.contentsBinary)
    {
       logUnsafeSourceDocument(filePath,
                               "File is binary (has null byte sequence)");
@@ -826,57 +805,57 @@ bool isSafeSourceDocument(const FilePath& docDbPath,
 }
 
 
-Error list(std::vector<boost::shared_ptr<SourceDocument>>* pDocs)
+Error list(std::vector<boost::shared_ptr<SourceDocument>>* pDocs,
+           bool includeContents)
 {
-   std::vector<FilePath> files;
-   Error error = source_database::path().getChildren(files);
+   std::vector<store::StoredDocument> storedDocs;
+   Error error = store::documentStore().list(includeContents, &storedDocs);
    if (error)
       return error;
    
-   for (FilePath& filePath : files)
+   for (const store::StoredDocument& stored : storedDocs)
    {
-      if (isSourceDocument(filePath))
+      // get the source doc
+      boost::shared_ptr<SourceDocument> pDoc(new SourceDocument());
+      Error error = readFromStoredDocument(stored, includeContents, pDoc);
+      if (!error)
       {
-         // get the source doc
-         boost::shared_ptr<SourceDocument> pDoc(new SourceDocument());
-         Error error = source_database::get(filePath.getFilename(), pDoc);
-         if (!error)
-         {
-            // safety filter
-            if (isSafeSourceDocument(filePath, pDoc))
-               pDocs->push_back(pDoc);
-         }
-         else
-            LOG_ERROR(error);
+         // safety filter
+         if (isSafeSourceDocument(stored, pDoc))
+            pDocs->push_back(pDoc);
       }
+      else
+         LOG_ERROR(error);
    }
    
    return Success();
 }
 
-Error list(std::vector<FilePath>* pPaths)
+Error list(std::vector<std::string>* pIds)
 {
-   // list children
-   std::vector<FilePath> children;
-   Error error = source_database::path().getChildren(children);
+   std::vector<store::StoredDocument> storedDocs;
+   Error error = store::documentStore().list(false, &storedDocs);
    if (error)
       return error;
    
-   // filter to actual source documents
-   core::algorithm::copy_if(
-            children.begin(),
-            children.end(),
-            std::back_inserter(*pPaths),
-            isSourceDocument);
+   for (const store::StoredDocument& stored : storedDocs)
+      pIds->push_back(stored.id);
    
    return Success();
 }
    
 Error put(boost::shared_ptr<SourceDocument> pDoc, bool writeContents, bool retryRewrite)
 {   
-   // write to file
-   FilePath filePath = source_database::path().completePath(pDoc->id());
-   Error error = pDoc->writeToFile(filePath, writeContents, retryRewrite);
+   // NOTE: retryRewrite applied to rewriting individual files on network
+   // filesystems; the store's transactions make retrying unnecessary
+   json::Object jsonProperties;
+   pDoc->writeToJson(&jsonProperties, false);
+
+   // contents which were never loaded are unchanged, so need not be written
+   writeContents = writeContents && pDoc->contentsLoaded();
+   Error error = store::documentStore().put(pDoc->id(),
+                                            jsonProperties.write(),
+                                            writeContents ? &pDoc->contents() : nullptr);
    if (error)
       return error;
 
@@ -891,28 +870,50 @@ Error put(boost::shared_ptr<SourceDocument> pDoc, bool writeContents, bool retry
    return Success();
 }
    
-Error remove(const std::string& id)
+Error putEdits(boost::shared_ptr<SourceDocument> pDoc,
+               const std::vector<ContentEdit>& edits)
 {
-   return source_database::path().completePath(id).removeIfExists();
-}
-   
-Error removeAll()
-{
-   std::vector<FilePath> files;
-   Error error = source_database::path().getChildren(files);
+   json::Object jsonProperties;
+   pDoc->writeToJson(&jsonProperties, false);
+
+   store::JournalSize journalSize;
+   Error error = store::documentStore().appendEdits(pDoc->id(),
+                                                    jsonProperties.write(),
+                                                    edits,
+                                                    pDoc->contents().length(),
+                                                    &journalSize);
    if (error)
       return error;
-   
-   for (FilePath& filePath : files)
+
+   std::size_t maxJournalBytes =
+         std::max(kMinJournalCompactionBytes, pDoc->contents().length() / 2);
+   if (journalSize.edits > kMaxJournalEdits || journalSize.bytes > maxJournalBytes)
    {
-      Error error = filePath.remove();
+      // compact (the put writes the contents and clears the journal)
+      return put(pDoc);
+   }
+
+   // write properties to durable storage (if there is a path)
+   if (!pDoc->path().empty())
+   {
+      error = putProperties(pDoc->path(), pDoc->properties());
       if (error)
-         return error;
+         LOG_ERROR(error);
    }
-   
+
    return Success();
 }
 
+Error remove(const std::string& id)
+{
+   return store::documentStore().remove(id);
+}
+   
+Error removeAll()
+{
+   return store::documentStore().removeAll();
+}
+
 Error getPath(const std::string& id, std::string* pPath)
 {
    std::map<std::string, std::string>::iterator it = s_idToPath.find(id);
@@ -1009,6 +1010,103 @@ core::Error detectExtendedType(const core::FilePath& filePath, std::string* pExt
 
 namespace {
 
+// read a document stored as files: a json properties file named by the
+// document id and a '-contents' sidecar file (older versions stored the
+// contents within the properties instead)
+Error readDocumentFiles(const FilePath& propertiesPath,
+                        store::StoredDocument* pStored)
+{
+   std::string properties;
+   Error error = readStringFromFile(propertiesPath,
+                                    &properties,
+                                    options().sourceLineEnding());
+   if (error)
+      return error;
+
+   json::Value value;
+   if (value.parse(properties) || !value.isObject())
+   {
+      Error error = systemError(boost::system::errc::protocol_error, ERROR_LOCATION);
+      error.addProperty("path", propertiesPath);
+      return error;
+   }
+
+   json::Object jsonDoc = value.getObject();
+   std::string contents;
+   FilePath contentsPath(propertiesPath.getAbsolutePath() + kContentsSuffix);
+   if (contentsPath.exists())
+   {
+      Error error = readStringFromFile(contentsPath,
+                                       &contents,
+                                       options().sourceLineEnding());
+      if (error)
+         LOG_ERROR(error);
+   }
+   else if (jsonDoc.find("contents") != jsonDoc.end() &&
+            json::isType<std::string>(jsonDoc["contents"]))
+   {
+      contents = jsonDoc["contents"].getString();
+   }
+
+   jsonDoc["contents"] = std::string();
+
+   pStored->id = propertiesPath.getFilename();
+   pStored->properties = jsonDoc.write();
+   pStored->contents = contents;
+   pStored->contentsSize = contents.size();
+   return Success();
+}
+
+// move documents stored as files in the session directory (which is how
+// they arrive from the persistent and most recent document directories,
+// and how earlier versions stored them) into the document store
+Error importDocumentFiles(const FilePath& sessionDir)
+{
+   std::vector<FilePath> children;
+   Error error = sessionDir.getChildren(children);
+   if (error)
+      return error;
+
+   std::vector<store::StoredDocument> documents;
+   std::vector<FilePath> importedFiles;
+   for (const FilePath& filePath : children)
+   {
+      if (!isSourceDocument(filePath))
+         continue;
+
+      store::StoredDocument document;
+      Error error = readDocumentFiles(filePath, &document);
+      if (error)
+      {
+         LOG_ERROR(error);
+         continue;
+      }
+
+      documents.push_back(document);
+      importedFiles.push_back(filePath);
+   }
+
+   if (documents.empty())
+      return Success();
+
+   error = store::documentStore().putAll(documents);
+   if (error)
+      return error;
+
+   for (const FilePath& filePath : importedFiles)
+   {
+      Error error = filePath.remove();
+      if (error)
+         LOG_ERROR(error);
+
+      error = FilePath(filePath.getAbsolutePath() + kContentsSuffix).removeIfExists();
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   return Success();
+}
+
 void onQuit()
 {
    Error error = supervisor::saveMostRecentDocuments();
@@ -1113,6 +1211,17 @@ Error initialize()
    if (error)
       return error;
 
+   // open the session's document store and bring in any documents
+   // provided as files
+   error = store::documentStore().open(
+            source_database::path().completePath(kSourceDocumentsDatabase));
+   if (error)
+      return error;
+
+   error = importDocumentFiles(source_database::path());
+   if (error)
+      LOG_ERROR(error);
+
    RS_REGISTER_CALL_METHOD(rs_getDocumentProperties, 2);
    RS_REGISTER_CALL_METHOD(rs_detectExtendedType, 1);
 
@@ -0,0 +1,701 @@
+/*
+ * SessionSourceDatabaseStore.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionSourceDatabaseStore.hpp"
+
+#include <ctime>
+#include <typeinfo>
+
+#include <shared_core/Error.hpp>
+#include <shared_core/SafeConvert.hpp>
+#include <core/Database.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Log.hpp>
+#include <core/StringUtils.hpp>
+
+#include <core/http/Util.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace source_database {
+namespace store {
+
+namespace {
+
+const char * const kDocumentsSchema =
+      "CREATE TABLE IF NOT EXISTS documents (\n"
+      "   id TEXT PRIMARY KEY NOT NULL,\n"
+      "   properties TEXT NOT NULL,\n"
+      "   contents TEXT NOT NULL DEFAULT '',\n"
+      "   contents_size INTEGER NOT NULL DEFAULT 0,\n"
+      "   contents_binary INTEGER NOT NULL DEFAULT 0\n"
+      ");\n"
+      "CREATE TABLE IF NOT EXISTS edits (\n"
+      "   seq INTEGER PRIMARY KEY AUTOINCREMENT,\n"
+      "   id TEXT NOT NULL,\n"
+      "   edit_offset INTEGER NOT NULL,\n"
+      "   edit_length INTEGER NOT NULL,\n"
+      "   edit_text TEXT NOT NULL\n"
+      ");\n"
+      "CREATE INDEX IF NOT EXISTS edits_by_id ON edits (id);\n";
+
+const char * const kPropertiesSchema =
+      "CREATE TABLE IF NOT EXISTS properties (\n"
+      "   path TEXT PRIMARY KEY NOT NULL,\n"
+      "   properties TEXT NOT NULL,\n"
+      "   last_written INTEGER NOT NULL\n"
+      ");\n";
+
+// how long to wait for another session's write to complete (the properties
+// database is shared by all sessions of a project) before giving up
+const int kBusyTimeoutMs = 5000;
+
+Error storeError(const soci::soci_error& e, const ErrorLocation& location)
+{
+   return systemError(boost::system::errc::io_error, e.what(), location);
+}
+
+Error connect(const FilePath& databaseFile,
+              const std::string& schema,
+              boost::shared_ptr<database::IConnection>* pConnection)
+{
+   Error error = databaseFile.getParent().ensureDirectory();
+   if (error)
+      return error;
+
+   database::SqliteConnectionOptions options;
+   options.file = string_utils::systemToUtf8(databaseFile.getAbsolutePath());
+
+   boost::shared_ptr<database::IConnection> pNewConnection;
+   error = database::connect(options, &pNewConnection);
+   if (error)
+   {
+      error.addProperty("database", databaseFile);
+      return error;
+   }
+
+   error = pNewConnection->executeStr(
+            "PRAGMA busy_timeout = " + safe_convert::numberToString(kBusyTimeoutMs) + ";\n" +
+            schema);
+   if (error)
+   {
+      error.addProperty("database", databaseFile);
+      return error;
+   }
+
+   *pConnection = pNewConnection;
+   return Success();
+}
+
+Error notOpenError(const ErrorLocation& location)
+{
+   return systemError(boost::system::errc::not_connected, location);
+}
+
+// sqlite reports integer columns as either int or long long depending on
+// the declared type and the magnitude of the value
+std::size_t readInteger(const database::Row& row, std::size_t index)
+{
+   if (row.get_indicator(index) != soci::i_ok)
+      return 0;
+
+   switch (row.get_properties(index).get_data_type())
+   {
+   case soci::dt_integer:
+      return static_cast<std::size_t>(row.get<int>(index));
+   case soci::dt_long_long:
+      return static_cast<std::size_t>(row.get<long long>(index));
+   case soci::dt_unsigned_long_long:
+      return static_cast<std::size_t>(row.get<unsigned long long>(index));
+   default:
+      return 0;
+   }
+}
+
+bool containsNullByteSequence(const std::string& text)
+{
+   return text.find(std::string(2, '\0')) != std::string::npos;
+}
+
+Error putDocument(database::IConnection& connection,
+                  const std::string& id,
+                  const std::string& properties,
+                  const std::string* pContents)
+{
+   if (pContents)
+   {
+      long long contentsSize = static_cast<long long>(pContents->size());
+      int contentsBinary = containsNullByteSequence(*pContents);
+      database::Query query = connection.query(
+               "INSERT OR REPLACE INTO documents "
+               "(id, properties, contents, contents_size, contents_binary) "
+               "VALUES (:id, :properties, :contents, :size, :binary)")
+            .withInput(id)
+            .withInput(properties)
+            .withInput(*pContents)
+            .withInput(contentsSize)
+            .withInput(contentsBinary);
+      Error error = connection.execute(query);
+      if (error)
+         return error;
+
+      // the new contents supersede the journal
+      database::Query clearEdits = connection.query(
+               "DELETE FROM edits WHERE id = :id")
+            .withInput(id);
+      return connection.execute(clearEdits);
+   }
+
+   // keep the stored contents (without relying on upsert support, which
+   // older versions of sqlite lack)
+   database::Query insert = connection.query(
+            "INSERT OR IGNORE INTO documents (id, properties) VALUES (:id, :properties)")
+         .withInput(id)
+         .withInput(properties);
+   Error error = connection.execute(insert);
+   if (error)
+      return error;
+
+   database::Query update = connection.query(
+            "UPDATE documents SET properties = :properties WHERE id = :id")
+         .withInput(properties)
+         .withInput(id);
+   return connection.execute(update);
+}
+
+// reads journaled edits (of all documents if pId is null), in order
+Error readEdits(database::IConnection& connection,
+                const std::string* pId,
+                std::map<std::string, std::vector<ContentEdit>>* pEdits)
+{
+   database::Rowset rows;
+   std::string id = pId ? *pId : std::string();
+   database::Query query = pId ?
+         connection.query(
+            "SELECT id, edit_offset, edit_length, edit_text FROM edits "
+            "WHERE id = :id ORDER BY seq").withInput(id) :
+         connection.query(
+            "SELECT id, edit_offset, edit_length, edit_text FROM edits "
+            "ORDER BY seq");
+   Error error = connection.execute(query, rows);
+   if (error)
+      return error;
+
+   try
+   {
+      for (database::RowsetIterator it = rows.begin(); it != rows.end(); ++it)
+      {
+         const database::Row& row = *it;
+         (*pEdits)[row.get<std::string>(0)].push_back(
+                  ContentEdit(readInteger(row, 1),
+                              readInteger(row, 2),
+                              row.get<std::string>(3)));
+      }
+   }
+   catch (soci::soci_error& e)
+   {
+      return storeError(e, ERROR_LOCATION);
+   }
+   catch (std::bad_cast& e)
+   {
+      return systemError(boost::system::errc::protocol_error, e.what(), ERROR_LOCATION);
+   }
+
+   return Success();
+}
+
+Error replayEdits(const std::string& id,
+                  const std::vector<ContentEdit>& edits,
+                  std::string* pContents)
+{
+   for (const ContentEdit& edit : edits)
+   {
+      if (edit.offset > pContents->length())
+      {
+         Error error = systemError(boost::system::errc::protocol_error,
+                                   "Journaled edit is out of range",
+                                   ERROR_LOCATION);
+         error.addProperty("id", id);
+         return error;
+      }
+      pContents->replace(edit.offset, edit.length, edit.text);
+   }
+   return Success();
+}
+
+} // anonymous namespace
+
+Error DocumentStore::open(const FilePath& databaseFile)
+{
+   close();
+   return connect(databaseFile, kDocumentsSchema, &pConnection_);
+}
+
+void DocumentStore::close()
+{
+   pConnection_.reset();
+   clearCachedContents();
+}
+
+void DocumentStore::cacheContents(const std::string& id, const std::string& contents)
+{
+   cachedId_ = id;
+   cachedContents_ = contents;
+}
+
+void DocumentStore::clearCachedContents()
+{
+   cachedId_.clear();
+   cachedContents_.clear();
+}
+
+Error DocumentStore::put(const std::string& id,
+                         const std::string& properties,
+                         const std::string* pContents)
+{
+   if (!pConnection_)
+      return notOpenError(ERROR_LOCATION);
+
+   try
+   {
+      database::Transaction transaction(pConnection_);
+      Error error = putDocument(*pConnection_, id, properties, pContents);
+      if (error)
+         return error;
+      transaction.commit();
+
+      if (pContents)
+         cacheContents(id, *pContents);
+      return Success();
+   }
+   catch (soci::soci_error& e)
+   {
+      return storeError(e, ERROR_LOCATION);
+   }
+}
+
+Error DocumentStore::appendEdits(const std::string& id,
+                                 const std::string& properties,
+                                 const std::vector<ContentEdit>& edits,
+                                 std::size_t contentsSize,
+                                 JournalSize* pJournalSize)
+{
+   if (!pConnection_)
+      return notOpenError(ERROR_LOCATION);
+
+   try
+   {
+      database::Transaction transaction(pConnection_);
+
+      // the binary flag is only ever set here (it's computed afresh when the
+      // journal is compacted)
+      int binary = 0;
+      for (const ContentEdit& edit : edits)
+         binary = binary || containsNullByteSequence(edit.text);
+
+      long long size = static_cast<long long>(contentsSize);
+      database::Query update = pConnection_->query(
+               "UPDATE documents SET properties = :properties, "
+               "contents_size = :size, contents_binary = MAX(contents_binary, :binary) "
+               "WHERE id = :id")
+            .withInput(properties)
+            .withInput(size)
+            .withInput(binary)
+            .withInput(id);
+      Error error = pConnection_->execute(update);
+      if (error)
+         return error;
+
+      for (const ContentEdit& edit : edits)
+      {
+         long long offset = static_cast<long long>(edit.offset);
+         long long length = static_cast<long long>(edit.length);
+         database::Query insert = pConnection_->query(
+                  "INSERT INTO edits (id, edit_offset, edit_length, edit_text) "
+                  "VALUES (:id, :offset, :length, :text)")
+               .withInput(id)
+               .withInput(offset)
+               .withInput(length)
+               .withInput(edit.text);
+         error = pConnection_->execute(insert);
+         if (error)
+            return error;
+      }
+
+      database::Rowset rows;
+      database::Query journal = pConnection_->query(
+               "SELECT COUNT(*), SUM(LENGTH(CAST(edit_text AS BLOB))) "
+               "FROM edits WHERE id = :id")
+            .withInput(id);
+      error = pConnection_->execute(journal, rows);
+      if (error)
+         return error;
+      for (database::RowsetIterator it = rows.begin(); it != rows.end(); ++it)
+      {
+         pJournalSize->edits = readInteger(*it, 0);
+         pJournalSize->bytes = readInteger(*it, 1);
+      }
+
+      transaction.commit();
+
+      // keep the cached contents in step with the journal
+      if (id == cachedId_)
+      {
+         error = replayEdits(id, edits, &cachedContents_);
+         if (error)
+            clearCachedContents();
+      }
+      return Success();
+   }
+   catch (soci::soci_error& e)
+   {
+      return storeError(e, ERROR_LOCATION);
+   }
+}
+
+Error DocumentStore::putAll(const std::vector<StoredDocument>& documents)
+{
+   if (!pConnection_)
+      return notOpenError(ERROR_LOCATION);
+
+   try
+   {
+      database::Transaction transaction(pConnection_);
+      for (const StoredDocument& document : documents)
+      {
+         Error error = putDocument(*pConnection_,
+                                   document.id,
+                                   document.properties,
+                                   &document.contents);
+         if (error)
+            return error;
+      }
+      transaction.commit();
+
+      for (const StoredDocument& document : documents)
+      {
+         if (document.id == cachedId_)
+            cacheContents(document.id, document.contents);
+      }
+      return Success();
+   }
+   catch (soci::soci_error& e)
+   {
+      return storeError(e, ERROR_LOCATION);
+   }
+}
+
+Error DocumentStore::get(const std::string& id,
+                         bool includeContents,
+                         StoredDocument* pDocument)
+{
+   if (!pConnection_)
+      return notOpenError(ERROR_LOCATION);
+
+   // the cached contents need no reading (or replaying)
+   bool readContents = includeContents && id != cachedId_;
+
+   database::Rowset rows;
+   database::Query query = pConnection_->query(readContents ?
+            "SELECT properties, contents_size, contents_binary, contents "
+            "FROM documents WHERE id = :id" :
+            "SELECT properties, contents_size, contents_binary "
+            "FROM documents WHERE id = :id")
+         .withInput(id);
+   Error error = pConnection_->execute(query, rows);
+   if (error)
+      return error;
+
+   try
+   {
+      for (database::RowsetIterator it = rows.begin(); it != rows.end(); ++it)
+      {
+         const database::Row& row = *it;
+         pDocument->id = id;
+         pDocument->properties = row.get<std::string>(0);
+         pDocument->contentsSize = readInteger(row, 1);
+         pDocument->contentsBinary = readInteger(row, 2) != 0;
+         if (!includeContents)
+         {
+            pDocument->contents.clear();
+            return Success();
+         }
+
+         if (!readContents)
+         {
+            pDocument->contents = cachedContents_;
+            return Success();
+         }
+
+         pDocument->contents = row.get<std::string>(3);
+         std::map<std::string, std::vector<ContentEdit>> edits;
+         Error error = readEdits(*pConnection_, &id, &edits);
+         if (error)
+            return error;
+         error = replayEdits(id, edits[id], &pDocument->contents);
+         if (error)
+            return error;
+
+         cacheContents(id, pDocument->contents);
+         return Success();
+      }
+   }
+   catch (soci::soci_error& e)
+   {
+      return storeError(e, ERROR_LOCATION);
+   }
+   catch (std::bad_cast& e)
+   {
+      return systemError(boost::system::errc::protocol_error, e.what(), ERROR_LOCATION);
+   }
+
+   return systemError(boost::system::errc::no_such_file_or_directory, ERROR_LOCATION);
+}
+
+Error DocumentStore::list(bool includeContents,
+                          std::vector<StoredDocument>* pDocuments)
+{
+   if (!pConnection_)
+      return notOpenError(ERROR_LOCATION);
+
+   database::Rowset rows;
+   database::Query query = pConnection_->query(includeContents ?
+            "SELECT id, properties, contents_size, contents_binary, contents "
+            "FROM documents" :
+            "SELECT id, properties, contents_size, contents_binary "
+            "FROM documents");
+   Error error = pConnection_->execute(query, rows);
+   if (error)
+      return error;
+
+   try
+   {
+      for (database::RowsetIterator it = rows.begin(); it != rows.end(); ++it)
+      {
+         const database::Row& row = *it;
+         StoredDocument document;
+         document.id = row.get<std::string>(0);
+         document.properties = row.get<std::string>(1);
+         document.contentsSize = readInteger(row, 2);
+         document.contentsBinary = readInteger(row, 3) != 0;
+         if (includeContents)
+            document.contents = row.get<std::string>(4);
+         pDocuments->push_back(document);
+      }
+   }
+   catch (soci::soci_error& e)
+   {
+      return storeError(e, ERROR_LOCATION);
+   }
+   catch (std::bad_cast& e)
+   {
+      return systemError(boost::system::errc::protocol_error, e.what(), ERROR_LOCATION);
+   }
+
+   if (!includeContents)
+      return Success();
+
+   std::map<std::string, std::vector<ContentEdit>> edits;
+   error = readEdits(*pConnection_, nullptr, &edits);
+   if (error)
+      return error;
+
+   for (StoredDocument& document : *pDocuments)
+   {
+      error = replayEdits(document.id, edits[document.id], &document.contents);
+      if (error)
+         return error;
+   }
+
+   return Success();
+}
+
+Error DocumentStore::remove(const std::string& id)
+{
+   if (!pConnection_)
+      return notOpenError(ERROR_LOCATION);
+
+   try
+   {
+      database::Transaction transaction(pConnection_);
+      database::Query query = pConnection_->query("DELETE FROM documents WHERE id = :id")
+            .withInput(id);
+      Error error = pConnection_->execute(query);
+      if (error)
+         return error;
+
+      database::Query clearEdits = pConnection_->query("DELETE FROM edits WHERE id = :id")
+            .withInput(id);
+      error = pConnection_->execute(clearEdits);
+      if (error)
+         return error;
+
+      transaction.commit();
+
+      if (id == cachedId_)
+         clearCachedContents();
+      return Success();
+   }
+   catch (soci::soci_error& e)
+   {
+      return storeError(e, ERROR_LOCATION);
+   }
+}
+
+Error DocumentStore::removeAll()
+{
+   if (!pConnection_)
+      return notOpenError(ERROR_LOCATION);
+
+   clearCachedContents();
+   return pConnection_->executeStr("DELETE FROM documents;\n"
+                                   "DELETE FROM edits;\n");
+}
+
+Error PropertiesStore::open(const FilePath& databaseFile)
+{
+   return connect(databaseFile, kPropertiesSchema, &pConnection_);
+}
+
+Error PropertiesStore::put(const std::string& path, const std::string& properties)
+{
+   std::map<std::string, std::string> entry;
+   entry[path] = properties;
+   return putAll(entry);
+}
+
+Error PropertiesStore::putAll(const std::map<std::string, std::string>& properties)
+{
+   if (!pConnection_)
+      return notOpenError(ERROR_LOCATION);
+
+   long long lastWritten = static_cast<long long>(std::time(nullptr));
+
+   try
+   {
+      database::Transaction transaction(pConnection_);
+      for (const auto& entry : properties)
+      {
+         database::Query query = pConnection_->query(
+                  "INSERT OR REPLACE INTO properties (path, properties, last_written) "
+                  "VALUES (:path, :properties, :written)")
+               .withInput(entry.first)
+               .withInput(entry.second)
+               .withInput(lastWritten);
+         Error error = pConnection_->execute(query);
+         if (error)
+            return error;
+      }
+      transaction.commit();
+      return Success();
+   }
+   catch (soci::soci_error& e)
+   {
+      return storeError(e, ERROR_LOCATION);
+   }
+}
+
+Error PropertiesStore::migrate(const FilePath& propertiesDir)
+{
+   FilePath indexFile = propertiesDir.completePath("INDEX");
+   if (!indexFile.exists())
+      return Success();
+
+   std::map<std::string, std::string> index;
+   Error error = readStringMapFromFile(indexFile, &index);
+   if (error)
+      return error;
+
+   std::map<std::string, std::string> properties;
+   std::vector<FilePath> migratedFiles;
+   for (const auto& entry : index)
+   {
+      FilePath propertiesFile = propertiesDir.completePath(entry.second);
+      if (entry.second.empty() || !propertiesFile.exists())
+         continue;
+
+      std::string contents;
+      Error error = readStringFromFile(propertiesFile, &contents);
+      if (error)
+      {
+         LOG_ERROR(error);
+         continue;
+      }
+
+      properties[http::util::urlDecode(entry.first)] = contents;
+      migratedFiles.push_back(propertiesFile);
+   }
+
+   error = putAll(properties);
+   if (error)
+      return error;
+
+   // the properties now live in the store so the old files can go
+   for (const FilePath& filePath : migratedFiles)
+   {
+      Error error = filePath.removeIfExists();
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   return indexFile.removeIfExists();
+}
+
+Error PropertiesStore::get(const std::string& path, std::string* pProperties)
+{
+   if (!pConnection_)
+      return notOpenError(ERROR_LOCATION);
+
+   std::string properties;
+   bool dataReturned = false;
+   database::Query query = pConnection_->query(
+            "SELECT properties FROM properties WHERE path = :path")
+         .withInput(path)
+         .withOutput(properties);
+   Error error = pConnection_->execute(query, &dataReturned);
+   if (error)
+      return error;
+
+   *pProperties = dataReturned ? properties : std::string();
+   return Success();
+}
+
+Error PropertiesStore::prune(int maxEntries)
+{
+   if (!pConnection_)
+      return notOpenError(ERROR_LOCATION);
+
+   // entries written within the same second are ordered by when they were
+   // written (replacing an entry gives it a new rowid)
+   database::Query query = pConnection_->query(
+            "DELETE FROM properties WHERE path NOT IN "
+            "(SELECT path FROM properties "
+            "ORDER BY last_written DESC, rowid DESC LIMIT :max)")
+         .withInput(maxEntries);
+   return pConnection_->execute(query);
+}
+
+DocumentStore& documentStore()
+{
+   static DocumentStore instance;
+   return instance;
+}
+
+} // namespace store
+} // namespace source_database
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,160 @@
+/*
+ * SessionSourceDatabaseStore.hpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_SOURCE_DATABASE_STORE_HPP
+#define SESSION_SOURCE_DATABASE_STORE_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include <shared_core/FilePath.hpp>
+
+#include <session/SessionSourceDatabase.hpp>
+
+// name of the database file holding the documents of a session (lives
+// within the session's source database directory)
+#define kSourceDocumentsDatabase "documents.db"
+
+// name of the database file holding durable (per-path) properties
+#define kDurablePropertiesDatabase "properties.db"
+
+namespace rstudio {
+namespace core {
+   class Error;
+namespace database {
+   class IConnection;
+}
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace source_database {
+namespace store {
+
+// a stored source document: its properties (json) and its contents, which
+// are kept in a separate column so they can be skipped when not needed
+// (along with their size, and whether they look binary, i.e. contain a
+// pair of null bytes)
+struct StoredDocument
+{
+   StoredDocument() : contentsSize(0), contentsBinary(false) {}
+
+   std::string id;
+   std::string properties;
+   std::string contents;
+   std::size_t contentsSize;
+   bool contentsBinary;
+};
+
+// the size of a document's journal of edits
+struct JournalSize
+{
+   JournalSize() : edits(0), bytes(0) {}
+
+   std::size_t edits;
+   std::size_t bytes;
+};
+
+// the source documents of the current session, stored in a single
+// database file (each update is written in its own transaction); contents
+// may be followed by a journal of edits, which is replayed when they're read.
+// the contents of the document most recently read or written are also kept
+// in memory, so that a document being edited (and so read back on every
+// save) needn't have its whole journal replayed each time
+class DocumentStore : boost::noncopyable
+{
+public:
+   core::Error open(const core::FilePath& databaseFile);
+   void close();
+   bool isOpen() const { return !!pConnection_; }
+
+   // write a document; when pContents is null the stored contents are kept,
+   // otherwise they replace the stored contents along with their journal
+   core::Error put(const std::string& id,
+                   const std::string& properties,
+                   const std::string* pContents);
+
+   // write a document's properties and append edits to its journal (contentsSize
+   // is the size of the contents after the edits)
+   core::Error appendEdits(const std::string& id,
+                           const std::string& properties,
+                           const std::vector<ContentEdit>& edits,
+                           std::size_t contentsSize,
+                           JournalSize* pJournalSize);
+
+   // write several documents in a single transaction
+   core::Error putAll(const std::vector<StoredDocument>& documents);
+
+   core::Error get(const std::string& id,
+                   bool includeContents,
+                   StoredDocument* pDocument);
+
+   core::Error list(bool includeContents,
+                    std::vector<StoredDocument>* pDocuments);
+
+   core::Error remove(const std::string& id);
+   core::Error removeAll();
+
+private:
+   void cacheContents(const std::string& id, const std::string& contents);
+   void clearCachedContents();
+
+   boost::shared_ptr<core::database::IConnection> pConnection_;
+
+   std::string cachedId_;
+   std::string cachedContents_;
+};
+
+// properties which persist for a path across sessions (e.g. cursor position
+// or folds); least recently written entries are pruned beyond a fixed limit
+class PropertiesStore : boost::noncopyable
+{
+public:
+   core::Error open(const core::FilePath& databaseFile);
+   bool isOpen() const { return !!pConnection_; }
+
+   core::Error put(const std::string& path, const std::string& properties);
+
+   // write several entries in a single transaction (used for migration)
+   core::Error putAll(const std::map<std::string, std::string>& properties);
+
+   // migrate properties from the previous layout (an INDEX file mapping
+   // url-escaped paths to individual json files within propertiesDir),
+   // removing the old files once they're stored
+   core::Error migrate(const core::FilePath& propertiesDir);
+
+   // pProperties is empty if there are no properties for the path
+   core::Error get(const std::string& path, std::string* pProperties);
+
+   core::Error prune(int maxEntries);
+
+private:
+   boost::shared_ptr<core::database::IConnection> pConnection_;
+};
+
+// the document store of the current session
+DocumentStore& documentStore();
+
+} // namespace store
+} // namespace source_database
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_SOURCE_DATABASE_STORE_HPP
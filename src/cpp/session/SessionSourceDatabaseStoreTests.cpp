@@ -0,0 +1,295 @@
+/*
+ * SessionSourceDatabaseStoreTests.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <shared_core/Error.hpp>
+#include <shared_core/FilePath.hpp>
+#include <shared_core/SafeConvert.hpp>
+
+#include <core/FileSerializer.hpp>
+#include <core/http/Util.hpp>
+
+#include "SessionSourceDatabaseStore.hpp"
+
+namespace rstudio {
+namespace session {
+namespace source_database {
+namespace store {
+
+using namespace core;
+
+namespace {
+
+FilePath tempDirectory()
+{
+   FilePath directory;
+   expect_false(FilePath::tempFilePath(directory));
+   expect_false(directory.ensureDirectory());
+   return directory;
+}
+
+} // anonymous namespace
+
+test_context("Source database document store")
+{
+   FilePath directory = tempDirectory();
+
+   test_that("Documents are read back as they were written")
+   {
+      DocumentStore store;
+      expect_false(store.open(directory.completeChildPath("put.db")));
+
+      std::string contents = "x <- 1\n";
+      expect_false(store.put("a", "{\"path\":\"a.R\"}", &contents));
+
+      StoredDocument document;
+      expect_false(store.get("a", true, &document));
+      expect_true(document.id == "a");
+      expect_true(document.properties == "{\"path\":\"a.R\"}");
+      expect_true(document.contents == contents);
+      expect_true(document.contentsSize == contents.size());
+      expect_false(document.contentsBinary);
+
+      // writing without contents keeps the stored contents
+      expect_false(store.put("a", "{\"path\":\"b.R\"}", nullptr));
+      expect_false(store.get("a", true, &document));
+      expect_true(document.properties == "{\"path\":\"b.R\"}");
+      expect_true(document.contents == contents);
+
+      // a missing document is an error
+      StoredDocument missing;
+      expect_true(store.get("missing", true, &missing));
+   }
+
+   test_that("Documents are listed with or without their contents")
+   {
+      DocumentStore store;
+      expect_false(store.open(directory.completeChildPath("list.db")));
+
+      std::vector<StoredDocument> documents(2);
+      documents[0].id = "a";
+      documents[0].properties = "{}";
+      documents[0].contents = "a";
+      documents[1].id = "b";
+      documents[1].properties = "{}";
+      documents[1].contents = std::string("b\0\0b", 4);
+      expect_false(store.putAll(documents));
+
+      std::vector<StoredDocument> listed;
+      expect_false(store.list(true, &listed));
+      expect_true(listed.size() == 2);
+      for (const StoredDocument& document : listed)
+      {
+         expect_true(document.contents == (document.id == "a" ? "a" : std::string("b\0\0b", 4)));
+         expect_true(document.contentsBinary == (document.id == "b"));
+      }
+
+      listed.clear();
+      expect_false(store.list(false, &listed));
+      expect_true(listed.size() == 2);
+      for (const StoredDocument& document : listed)
+      {
+         expect_true(document.contents.empty());
+         expect_true(document.contentsSize == (document.id == "a" ? 1u : 4u));
+      }
+
+      expect_false(store.remove("a"));
+      listed.clear();
+      expect_false(store.list(false, &listed));
+      expect_true(listed.size() == 1);
+
+      expect_false(store.removeAll());
+      listed.clear();
+      expect_false(store.list(false, &listed));
+      expect_true(listed.empty());
+   }
+
+   test_that("Journaled edits are replayed in order")
+   {
+      FilePath databaseFile = directory.completeChildPath("edits.db");
+      DocumentStore store;
+      expect_false(store.open(databaseFile));
+
+      std::string contents = "x <- 1\n";
+      expect_false(store.put("a", "{}", &contents));
+
+      // each edit applies to the contents as left by the one before
+      std::vector<ContentEdit> edits;
+      edits.push_back(ContentEdit(5, 1, "10"));          // x <- 10
+      edits.push_back(ContentEdit(8, 0, "y <- 2\n"));    // x <- 10\ny <- 2
+      JournalSize journalSize;
+      expect_false(store.appendEdits("a", "{\"n\":1}", edits, 15, &journalSize));
+      expect_true(journalSize.edits == 2);
+      expect_true(journalSize.bytes == 9);
+
+      edits.assign(1, ContentEdit(0, 1, "z"));           // z <- 10\ny <- 2
+      expect_false(store.appendEdits("a", "{\"n\":2}", edits, 15, &journalSize));
+      expect_true(journalSize.edits == 3);
+
+      StoredDocument document;
+      expect_false(store.get("a", true, &document));
+      expect_true(document.contents == "z <- 10\ny <- 2\n");
+      expect_true(document.properties == "{\"n\":2}");
+      expect_true(document.contentsSize == 15);
+
+      // the contents read from the database (rather than those held for the
+      // document being edited) are the same
+      store.close();
+      expect_false(store.open(databaseFile));
+      StoredDocument reread;
+      expect_false(store.get("a", true, &reread));
+      expect_true(reread.contents == document.contents);
+
+      std::vector<StoredDocument> listed;
+      expect_false(store.list(true, &listed));
+      expect_true(listed.size() == 1);
+      expect_true(listed[0].contents == document.contents);
+   }
+
+   test_that("Writing contents compacts the journal")
+   {
+      FilePath databaseFile = directory.completeChildPath("compact.db");
+      DocumentStore store;
+      expect_false(store.open(databaseFile));
+
+      std::string contents = "a";
+      expect_false(store.put("a", "{}", &contents));
+      JournalSize journalSize;
+      for (int i = 0; i < 10; i++)
+      {
+         std::vector<ContentEdit> edits(1, ContentEdit(contents.size(), 0, "b"));
+         contents += "b";
+         expect_false(store.appendEdits("a", "{}", edits, contents.size(), &journalSize));
+      }
+      expect_true(journalSize.edits == 10);
+
+      // the compacted contents supersede the journal
+      expect_false(store.put("a", "{}", &contents));
+      std::vector<ContentEdit> edits(1, ContentEdit(0, 0, "c"));
+      expect_false(store.appendEdits("a", "{}", edits, contents.size() + 1, &journalSize));
+      expect_true(journalSize.edits == 1);
+      expect_true(journalSize.bytes == 1);
+
+      store.close();
+      expect_false(store.open(databaseFile));
+      StoredDocument document;
+      expect_false(store.get("a", true, &document));
+      expect_true(document.contents == "c" + contents);
+
+      // a journaled edit which doesn't fit the contents is an error
+      edits.assign(1, ContentEdit(100, 0, "d"));
+      expect_false(store.appendEdits("a", "{}", edits, 0, &journalSize));
+      store.close();
+      expect_false(store.open(databaseFile));
+      expect_true(store.get("a", true, &document));
+   }
+
+   test_that("A closed store reports errors")
+   {
+      DocumentStore store;
+      std::string contents;
+      expect_true(store.put("a", "{}", &contents));
+      expect_false(store.isOpen());
+   }
+
+   expect_false(directory.removeIfExists());
+}
+
+test_context("Source database properties store")
+{
+   FilePath directory = tempDirectory();
+
+   test_that("Properties are read back as they were written")
+   {
+      PropertiesStore store;
+      expect_false(store.open(directory.completeChildPath("put.db")));
+
+      expect_false(store.put("~/a.R", "{\"folds\":\"\"}"));
+      std::string properties;
+      expect_false(store.get("~/a.R", &properties));
+      expect_true(properties == "{\"folds\":\"\"}");
+
+      // paths without properties have none
+      expect_false(store.get("~/b.R", &properties));
+      expect_true(properties.empty());
+   }
+
+   test_that("Properties are migrated from the INDEX layout")
+   {
+      FilePath propertiesDir = directory.completeChildPath("prop");
+      expect_false(propertiesDir.ensureDirectory());
+
+      std::map<std::string, std::string> index;
+      index[http::util::urlEncode("~/dir/a b.R")] = "1A2B3C4D";
+      index[http::util::urlEncode("~/missing.R")] = "5E6F7A8B";
+      expect_false(writeStringMapToFile(propertiesDir.completeChildPath("INDEX"), index));
+      expect_false(writeStringToFile(propertiesDir.completeChildPath("1A2B3C4D"),
+                                     "{\"cursor\":1}"));
+
+      PropertiesStore store;
+      expect_false(store.open(propertiesDir.completeChildPath(kDurablePropertiesDatabase)));
+      expect_false(store.migrate(propertiesDir));
+
+      std::string properties;
+      expect_false(store.get("~/dir/a b.R", &properties));
+      expect_true(properties == "{\"cursor\":1}");
+      expect_false(store.get("~/missing.R", &properties));
+      expect_true(properties.empty());
+
+      // the old files are removed once migrated
+      expect_false(propertiesDir.completeChildPath("INDEX").exists());
+      expect_false(propertiesDir.completeChildPath("1A2B3C4D").exists());
+
+      // and there is nothing more to migrate
+      expect_false(store.migrate(propertiesDir));
+   }
+
+   test_that("Pruning keeps the most recently written properties")
+   {
+      PropertiesStore store;
+      expect_false(store.open(directory.completeChildPath("prune.db")));
+
+      std::map<std::string, std::string> properties;
+      for (int i = 0; i < 5000; i++)
+         properties["~/" + safe_convert::numberToString(10000 + i) + ".R"] = "{}";
+      expect_false(store.putAll(properties));
+      expect_false(store.put("~/recent.R", "{}"));
+
+      expect_false(store.prune(5000));
+
+      // the first of the older entries goes
+      std::string value;
+      expect_false(store.get("~/10000.R", &value));
+      expect_true(value.empty());
+      expect_false(store.get("~/10001.R", &value));
+      expect_true(value == "{}");
+      expect_false(store.get("~/14999.R", &value));
+      expect_true(value == "{}");
+      expect_false(store.get("~/recent.R", &value));
+      expect_true(value == "{}");
+   }
+
+   expect_false(directory.removeIfExists());
+}
+
+} // namespace store
+} // namespace source_database
+} // namespace session
+} // namespace rstudio
@@ -15,6 +15,7 @@
  */
 
 #include "SessionSourceDatabaseSupervisor.hpp"
+#include "SessionSourceDatabaseStore.hpp"
 
 #ifdef _WIN32
 # include <winsock2.h>
@@ -550,6 +551,9 @@ Error detachFromSourceDatabase()
       }
    }
 
+   // the documents have been written out, so we are done with the store
+   store::documentStore().close();
+
    // record session dir (parent of lock file)
    FilePath sessionDir = sessionDirLock().lockFilePath().getParent();
 
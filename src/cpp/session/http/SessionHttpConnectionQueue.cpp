@@ -92,6 +92,11 @@ boost::shared_ptr<HttpConnection> HttpConnectionQueue::dequeConnection(
       return boost::shared_ptr<HttpConnection>();
 }
 
+void HttpConnectionQueue::wakeWaiters()
+{
+   pWaitCondition_->notify_all();
+}
+
 std::string HttpConnectionQueue::peekNextConnectionUri()
 {
    LOCK_MUTEX(*pMutex_)
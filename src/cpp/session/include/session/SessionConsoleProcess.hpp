@@ -219,6 +219,8 @@ private:
 
    std::string bufferedOutput() const;
    void enqueOutputEvent(const std::string& output);
+   void maybeFlushOutput();
+   void flushOutput();
    void enquePromptEvent(const std::string& prompt);
    void handleConsolePrompt(core::system::ProcessOperations& ops,
                             const std::string& prompt);
@@ -280,6 +282,10 @@ private:
 
    // private command handler, used to capture environment variables during terminal idle time
    core::terminal::PrivateCommand envCaptureCmd_;
+
+   // output not yet sent to the client, and when output was last sent
+   std::string pendingOutput_;
+   boost::posix_time::ptime lastOutputFlushTime_;
 };
 
 core::json::Array processesAsJson(SerializationMode serialMode);
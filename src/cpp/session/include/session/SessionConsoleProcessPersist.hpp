@@ -43,8 +43,17 @@ void saveConsoleProcesses(const std::string& metadata);
 // then returns the trimmed buffer.
 std::string getSavedBuffer(const std::string& handle, int maxLines);
 
+// Get one chunk (of chunkSize bytes) of the saved buffer for the given
+// ConsoleProcess, reading only that portion of the buffer. If maxLines > 0,
+// the saved buffer is first trimmed to the given number of lines.
+std::string getSavedBufferChunk(const std::string& handle,
+                                int maxLines,
+                                int chunk,
+                                std::size_t chunkSize,
+                                bool* pMoreAvailable);
+
 // Return number of lines in the saved buffer for given ConsoleProcess;
-// buffer will be trimmed to max number of lines and rewritten.
+// buffer will be trimmed to max number of lines.
 int getSavedBufferLineCount(const std::string& handle, int maxLines);
 
 // Add to the saved buffer for the given ConsoleProcess
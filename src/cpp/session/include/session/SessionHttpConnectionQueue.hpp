@@ -61,6 +61,10 @@ public:
 
    std::string peekNextConnectionUri();
 
+   // wake up any threads waiting for a connection (they will
+   // return without a connection if none is available)
+   void wakeWaiters();
+
    boost::posix_time::ptime lastConnectionTime();
 
    boost::shared_ptr<HttpConnection> dequeMatchingConnection(
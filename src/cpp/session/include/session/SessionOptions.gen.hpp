@@ -285,6 +285,9 @@ protected:
       ("r-libs-user",
       value<std::string>(&rLibsUser_)->default_value(""),
       "Specifies the R user library path.")
+      ("r-package-index-cache-path",
+      value<std::string>(&rPackageIndexCachePath_)->default_value(""),
+      "Specifies a directory, shared between sessions and users, in which package index results for installed library paths are cached. When empty, results are cached per user.")
       ("r-cran-repos",
       value<std::string>(&rCRANUrl_)->default_value(""),
       "Specifies the default CRAN repository.")
@@ -472,6 +475,7 @@ public:
    core::FilePath sessionLibraryPath() const { return core::FilePath(sessionLibraryPath_); }
    core::FilePath sessionPackageArchivesPath() const { return core::FilePath(sessionPackageArchivesPath_); }
    std::string rLibsUser() const { return rLibsUser_; }
+   std::string rPackageIndexCachePath() const { return rPackageIndexCachePath_; }
    std::string rCRANUrl() const { return rCRANUrl_; }
    std::string rCRANReposFile() const { return rCRANReposFile_; }
    std::string rCRANReposUrl() const { return rCRANReposUrl_; }
@@ -574,6 +578,7 @@ protected:
    std::string sessionLibraryPath_;
    std::string sessionPackageArchivesPath_;
    std::string rLibsUser_;
+   std::string rPackageIndexCachePath_;
    std::string rCRANUrl_;
    std::string rCRANReposFile_;
    std::string rCRANReposUrl_;
@@ -16,6 +16,8 @@
 #ifndef SESSION_MODULES_PACKAGE_PROVIDED_EXTENSION_HPP
 #define SESSION_MODULES_PACKAGE_PROVIDED_EXTENSION_HPP
 
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -43,6 +45,13 @@ core::Error parseDcfResourceFile(
       const core::FilePath& resourcePath,
       boost::function<core::Error(const std::map<std::string, std::string>&)> callback);
 
+// Returns whether the given resource (a path relative to the package root)
+// exists within an installed package. While indexing, resources within the
+// package 'rstudio' folder and R Markdown templates are answered from the
+// package index cache rather than by touching the filesystem.
+bool packageResourceExists(const core::FilePath& pkgPath,
+                           const std::string& resourcePath);
+
 class Worker : boost::noncopyable
 {
 public:
@@ -83,16 +92,32 @@ public:
    bool running() { return running_; }
    core::json::Object getPayload() { return payload_; }
    
+   // returns false when the resources of the package are not known
+   bool resourceExists(const core::FilePath& pkgPath,
+                       const std::string& resourcePath,
+                       bool* pExists);
+   
 private:
    void beginIndexing();
    bool work();
    void endIndexing();
    
+   void readLibraryIndex(const core::FilePath& libPath);
+   void writeLibraryIndex(const core::FilePath& libPath);
+   void indexPackageResources(const core::FilePath& pkgPath);
+   
 private:
    std::vector<boost::shared_ptr<Worker> > workers_;
    std::vector<core::FilePath> pkgDirs_;
    core::json::Object payload_;
    
+   // package path -> resources found within the package
+   std::map<std::string, std::set<std::string> > pkgResources_;
+   
+   // library paths with no cached index; these are indexed
+   // while packages are visited and written at completion
+   std::set<std::string> unindexedLibPaths_;
+   
    std::size_t index_;
    std::size_t n_;
    bool running_;
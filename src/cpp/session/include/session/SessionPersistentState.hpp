@@ -39,6 +39,10 @@ public:
    // COPYING: boost::noncopyable
    
    core::Error initialize();
+
+   // write pending changes (changes are written behind on a timer, so this
+   // must be called before the session suspends or exits)
+   void flush();
    
    // active-client-id
    std::string activeClientId();
@@ -84,6 +88,9 @@ public:
    // get underlying settings
    core::Settings& settings() { return settings_; }
 
+private:
+   void scheduleFlush();
+
 private:
    bool serverMode_;
    std::string desktopClientId_;
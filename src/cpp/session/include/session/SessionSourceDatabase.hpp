@@ -51,6 +51,20 @@ namespace core {
 namespace rstudio {
 namespace session {
 namespace source_database {
+
+// an edit of document contents: replaces [offset, offset + length) with text
+struct ContentEdit
+{
+   ContentEdit() : offset(0), length(0) {}
+   ContentEdit(std::size_t offset, std::size_t length, const std::string& text)
+      : offset(offset), length(length), text(text)
+   {
+   }
+
+   std::size_t offset;
+   std::size_t length;
+   std::string text;
+};
    
 class SourceDocument : boost::noncopyable
 {
@@ -63,7 +77,7 @@ public:
    const std::string& id() const { return id_; }
    const std::string& path() const { return path_; }
    const std::string& type() const { return type_; }
-   const std::string& contents() const { return contents_; }
+   const std::string& contents() const;
    const std::string& hash() const { return hash_; }
    const std::string& encoding() const { return encoding_; }
    bool dirty() const { return dirty_; }
@@ -83,6 +97,14 @@ public:
    // set contents from string
    void setContents(const std::string& contents);
 
+   // set contents whose hash has already been computed (e.g. incrementally)
+   void setContents(const std::string& contents, const std::string& hash);
+
+   // documents read without their contents (see source_database::get and
+   // source_database::list) read them from the database on first access
+   bool contentsLoaded() const { return contentsLoaded_; }
+   void setContentsNotLoaded(const std::string& hash);
+
    // set contents from file
    core::Error setPathAndContents(const std::string& path,
                                   bool allowSubstChars = true);
@@ -176,7 +198,8 @@ private:
    std::string id_;
    std::string path_;
    std::string type_;
-   std::string contents_;
+   mutable std::string contents_;
+   mutable bool contentsLoaded_;
    std::string hash_;
    std::string encoding_;
    std::string folds_;
@@ -203,9 +226,16 @@ core::Error get(const std::string& id, boost::shared_ptr<SourceDocument> pDoc);
 core::Error get(const std::string& id, bool includeContents, boost::shared_ptr<SourceDocument> pDoc);
 core::Error getDurableProperties(const std::string& path,
                                  core::json::Object* pProperties);
-core::Error list(std::vector<boost::shared_ptr<SourceDocument> >* pDocs);
-core::Error list(std::vector<core::FilePath>* pPaths);
+core::Error list(std::vector<boost::shared_ptr<SourceDocument> >* pDocs,
+                 bool includeContents = true);
+core::Error list(std::vector<std::string>* pIds);
 core::Error put(boost::shared_ptr<SourceDocument> pDoc, bool writeContents = true, bool retryRewrite = false);
+
+// write a document whose contents (already set) were changed by edits; the
+// edits are journaled rather than the contents rewritten, and the journal is
+// compacted into the contents once it has grown large
+core::Error putEdits(boost::shared_ptr<SourceDocument> pDoc,
+                     const std::vector<ContentEdit>& edits);
 core::Error remove(const std::string& id);
 core::Error removeAll();
 core::Error getPath(const std::string& id, std::string* pPath);
@@ -16,7 +16,9 @@
 #ifndef SESSION_JOBS_JOB_HPP
 #define SESSION_JOBS_JOB_HPP
 
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <shared_core/json/Json.hpp>
 #include <r/RSexp.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -126,6 +128,10 @@ public:
    void addOutput(const std::string& output, bool error);
    core::json::Array output(int position);
 
+   // retrieve up to 'count' lines of output preceding line 'before'; used to
+   // page in output omitted when replaying a job's output
+   core::json::Array outputBefore(int before, int count);
+
    // whether the job pane should should be shown at start
    bool show() const;
    
@@ -160,6 +166,9 @@ public:
 private:
    core::FilePath jobCacheFolder();
    core::FilePath outputCacheFile();
+   void indexOutput();
+   void clearOutputIndex();
+   void readOutput(int begin, int end, core::json::Array* pOutput);
 
    std::string id_;
    std::string name_;
@@ -187,6 +196,14 @@ private:
    JobActions cppActions_;
 
    std::vector<std::string> tags_;
+
+   // index into the output cache file: the byte offset of every
+   // kOutputIndexInterval'th line, along with the number of lines and bytes
+   // in the file (built on first use, then maintained as output is added)
+   std::vector<uintmax_t> outputIndex_;
+   int outputLines_;
+   uintmax_t outputSize_;
+   bool outputIndexed_;
 };
 
 
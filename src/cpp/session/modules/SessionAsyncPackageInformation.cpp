@@ -18,13 +18,19 @@
 
 #include "SessionAsyncPackageInformation.hpp"
 
+#include <algorithm>
+#include <ctime>
 #include <string>
 #include <vector>
 #include <sstream>
 
 #include <shared_core/FilePath.hpp>
+#include <shared_core/Hash.hpp>
+#include <shared_core/SafeConvert.hpp>
 #include <shared_core/json/Json.hpp>
 #include <core/json/JsonRpc.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/system/System.hpp>
 #include <shared_core/Error.hpp>
 
 #include <boost/format.hpp>
@@ -34,6 +40,8 @@
 
 #include <core/Macros.hpp>
 
+#include "SessionLibPathsIndexer.hpp"
+
 namespace rstudio {
 namespace session {
 namespace modules {
@@ -140,6 +148,226 @@ bool fillFunctionInfo(const json::Object& functionObjectJson,
    
 }
 
+// Each line of output from '.rs.getPackageInformation' should be a JSON
+// object with the format:
+//
+// {
+//    "package": <single package name>
+//    "exports": <array of object names in the namespace>,
+//    "types": <array of types (see .rs.acCompletionTypes)>,
+//    "function_info": {big ugly object with function info},
+//    "data" <array of dataset names>
+// }
+//
+// The same representation is used for the on-disk package information
+// database, so that entries can be written out as they are received.
+bool readPackageInformation(const std::string& line,
+                            PackageInformation* pInfo)
+{
+   json::Array exportsJson;
+   json::Array typesJson;
+   json::Object functionInfoJson;
+   json::Array datasetsJson;
+   
+   json::Value value;
+   Error error = value.parse(line);
+   if (error)
+   {
+      std::string subset;
+      if (line.length() > 60)
+         subset = line.substr(0, 60) + "...";
+      else
+         subset = line;
+      
+      LOG_ERROR_MESSAGE("Failed to parse JSON: '" + subset + "'");
+      return false;
+   }
+   
+   // Ensure that this parsed as an Object -- this might have parsed as
+   // something else if e.g. we got malformed output on load of a package
+   if (!json::isType<json::Object>(value))
+      return false;
+   
+   error = json::readObject(value.getObject(),
+                            "package", pInfo->package,
+                            "exports", exportsJson,
+                            "types", typesJson,
+                            "function_info", functionInfoJson,
+                            "datasets", datasetsJson);
+   
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+   
+   if (!exportsJson.toVectorString(pInfo->exports))
+      LOG_ERROR_MESSAGE("Failed to read JSON 'objects' array to vector");
+   
+   if (!typesJson.toVectorInt(pInfo->types))
+      LOG_ERROR_MESSAGE("Failed to read JSON 'types' array to vector");
+   
+   if (!fillFunctionInfo(functionInfoJson, pInfo->package, &(pInfo->functionInfo)))
+      LOG_ERROR_MESSAGE("Failed to read JSON 'functions' object to map");
+   
+   if (!datasetsJson.toVectorString(pInfo->datasets))
+      LOG_ERROR_MESSAGE("Failed to read JSON 'data' array to vector");
+   
+   return true;
+}
+
+// Package information database ----
+//
+// Package information computed by the async R process is persisted within
+// the user scratch path, so that it can be re-used by later sessions (and
+// concurrently running sessions) of the same user without having to load
+// the package namespace again. Entries live at:
+//
+//    <user-scratch>/package-information/<package>/<key>.json
+//
+// where 'key' identifies the installed copy of the package (its install
+// path and the modification time of its DESCRIPTION file) and so changes
+// whenever the package is re-installed or upgraded. Sessions may use other
+// copies of a package (e.g. from a project library), so entries for other
+// keys are kept alongside; only the least recently written beyond a few
+// are pruned.
+
+// the entries kept per package
+const std::size_t kMaxPackageInformationEntries = 8;
+
+// how long a temporary file may be left before it's presumed abandoned
+// (rather than being written by another session)
+const std::time_t kAbandonedTempFileSeconds = 60 * 60;
+
+FilePath packageInformationDatabasePath()
+{
+   return module_context::userScratchPath().completeChildPath("package-information");
+}
+
+FilePath packageInformationEntryPath(const std::string& pkgName)
+{
+   FilePath pkgPath = libpaths::findInstalledPackage(pkgName);
+   if (pkgPath.isEmpty())
+      return FilePath();
+   
+   FilePath descPath = pkgPath.completeChildPath("DESCRIPTION");
+   if (!descPath.exists())
+      return FilePath();
+   
+   std::string key = core::hash::crc32HexHash(
+            pkgPath.getAbsolutePath() + ":" +
+            safe_convert::numberToString(descPath.getLastWriteTime()));
+   
+   return packageInformationDatabasePath()
+         .completeChildPath(pkgName)
+         .completeChildPath(key + ".json");
+}
+
+bool readPackageInformationEntry(const std::string& pkgName,
+                                 PackageInformation* pInfo)
+{
+   FilePath entryPath = packageInformationEntryPath(pkgName);
+   if (entryPath.isEmpty() || !entryPath.exists())
+      return false;
+   
+   std::string contents;
+   Error error = core::readStringFromFile(entryPath, &contents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+   
+   if (!readPackageInformation(contents, pInfo) || pInfo->package != pkgName)
+   {
+      // discard corrupt entries; they'll be re-generated
+      entryPath.removeIfExists();
+      return false;
+   }
+   
+   return true;
+}
+
+void prunePackageInformationEntries(const FilePath& entryPath)
+{
+   std::vector<FilePath> children;
+   Error error = entryPath.getParent().getChildren(children);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+   
+   std::time_t now = std::time(nullptr);
+   std::vector<FilePath> entries;
+   for (const FilePath& child : children)
+   {
+      if (child.getExtensionLowerCase() == ".json")
+      {
+         if (child != entryPath)
+            entries.push_back(child);
+      }
+      else if (now - child.getLastWriteTime() > kAbandonedTempFileSeconds)
+      {
+         child.removeIfExists();
+      }
+   }
+   
+   if (entries.size() < kMaxPackageInformationEntries)
+      return;
+   
+   // keep the most recently written entries (along with the one just written)
+   std::sort(entries.begin(), entries.end(), [](const FilePath& lhs, const FilePath& rhs)
+   {
+      return lhs.getLastWriteTime() > rhs.getLastWriteTime();
+   });
+   
+   for (std::size_t i = kMaxPackageInformationEntries - 1; i < entries.size(); i++)
+   {
+      error = entries[i].removeIfExists();
+      if (error)
+         LOG_ERROR(error);
+   }
+}
+
+void writePackageInformationEntry(const std::string& pkgName,
+                                  const std::string& line)
+{
+   FilePath entryPath = packageInformationEntryPath(pkgName);
+   if (entryPath.isEmpty())
+      return;
+   
+   FilePath entryDir = entryPath.getParent();
+   Error error = entryDir.ensureDirectory();
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+   
+   // write to a temporary file and then move into place, so that
+   // concurrently starting sessions never observe a partial entry
+   FilePath tempPath = entryDir.completeChildPath(
+            entryPath.getStem() + "-" + core::system::generateShortenedUuid());
+   
+   error = core::writeStringToFile(tempPath, line);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+   
+   error = tempPath.move(entryPath, FilePath::MoveDirect, true);
+   if (error)
+   {
+      LOG_ERROR(error);
+      tempPath.removeIfExists();
+      return;
+   }
+   
+   prunePackageInformationEntries(entryPath);
+}
+
 } // anonymous namespace
 
 void AsyncPackageInformationProcess::onCompleted(int exitStatus)
@@ -165,22 +393,8 @@ void AsyncPackageInformationProcess::onCompleted(int exitStatus)
    std::size_t n = splat.size();
    DEBUG("- Received " << n << " lines of response");
 
-   // Each line should be a JSON object with the format:
-   //
-   // {
-   //    "package": <single package name>
-   //    "exports": <array of object names in the namespace>,
-   //    "types": <array of types (see .rs.acCompletionTypes)>,
-   //    "function_info": {big ugly object with function info},
-   //    "data" <array of dataset names>
-   // }
    for (std::size_t i = 0; i < n; ++i)
    {
-      json::Array exportsJson;
-      json::Array typesJson;
-      json::Object functionInfoJson;
-      json::Array datasetsJson;
-      
       core::r_util::PackageInformation pkgInfo;
 
       if (splat[i].empty())
@@ -192,51 +406,13 @@ void AsyncPackageInformationProcess::onCompleted(int exitStatus)
          continue;
       
       std::string line = splat[i].substr(::strlen("#!json: "));
-      
-      json::Value value;
-      if (!value.parse(line))
-      {
-         std::string subset;
-         if (splat[i].length() > 60)
-            subset = splat[i].substr(0, 60) + "...";
-         else
-            subset = splat[i];
-
-         LOG_ERROR_MESSAGE("Failed to parse JSON: '" + subset + "'");
-         continue;
-      }
-      
-      // Ensure that this parsed as an Object -- this might have parsed as
-      // something else if e.g. we got malformed output on load of a package
-      if (!json::isType<json::Object>(value))
-         continue;
-      
-      Error error = json::readObject(value.getObject(),
-                                     "package", pkgInfo.package,
-                                     "exports", exportsJson,
-                                     "types", typesJson,
-                                     "function_info", functionInfoJson,
-                                     "datasets", datasetsJson);
-
-      if (error)
-      {
-         LOG_ERROR(error);
+      if (!readPackageInformation(line, &pkgInfo))
          continue;
-      }
 
       DEBUG("Adding entry for package: '" << pkgInfo.package << "'");
-
-      if (!exportsJson.toVectorString(pkgInfo.exports))
-         LOG_ERROR_MESSAGE("Failed to read JSON 'objects' array to vector");
-
-      if (!typesJson.toVectorInt(pkgInfo.types))
-         LOG_ERROR_MESSAGE("Failed to read JSON 'types' array to vector");
-
-      if (!fillFunctionInfo(functionInfoJson, pkgInfo.package, &(pkgInfo.functionInfo)))
-         LOG_ERROR_MESSAGE("Failed to read JSON 'functions' object to map");
       
-      if (!datasetsJson.toVectorString(pkgInfo.datasets))
-         LOG_ERROR_MESSAGE("Failed to read JSON 'data' array to vector");
+      // Persist for use by other sessions
+      writePackageInformationEntry(pkgInfo.package, line);
       
       // Update the index
       core::r_util::RSourceIndex::addPackageInformation(pkgInfo.package, pkgInfo);
@@ -255,8 +431,23 @@ void AsyncPackageInformationProcess::update()
    s_isUpdating_ = true;
    s_updateRequested_ = false;
    
-   s_pkgsToUpdate_ =
-      RSourceIndex::getAllUnindexedPackages();
+   s_pkgsToUpdate_.clear();
+   
+   // Use entries from the package information database when available,
+   // and only ask R for the packages we haven't seen before
+   for (const std::string& pkgName : RSourceIndex::getAllUnindexedPackages())
+   {
+      PackageInformation pkgInfo;
+      if (readPackageInformationEntry(pkgName, &pkgInfo))
+      {
+         DEBUG("Using cached entry for package: '" << pkgName << "'");
+         RSourceIndex::addPackageInformation(pkgName, pkgInfo);
+      }
+      else
+      {
+         s_pkgsToUpdate_.push_back(pkgName);
+      }
+   }
    
    // alias for readability
    const std::vector<std::string>& pkgs = s_pkgsToUpdate_;
@@ -57,6 +57,7 @@
 #include <session/projects/SessionProjects.hpp>
 
 #include "SessionAsyncPackageInformation.hpp"
+#include "SessionRTokenCache.hpp"
 
 #include "SessionSource.hpp"
 #include "clang/DefinitionIndex.hpp"
@@ -1004,8 +1005,13 @@ void RSourceIndexes::update(const boost::shared_ptr<SourceDocument>& pDoc)
       return;
    }
    
+   boost::shared_ptr<r_util::RTokens> pTokens = token_cache::tokens(
+            pDoc->id(),
+            string_utils::utf8ToWide(code),
+            r_util::RTokens::StripWhitespace | r_util::RTokens::StripComments);
+   
    boost::shared_ptr<r_util::RSourceIndex> pIndex(
-       new r_util::RSourceIndex(pDoc->path(), code));
+       new r_util::RSourceIndex(pDoc->path(), *pTokens));
    
    // add implicitly available packages
    FilePath filePath = module_context::resolveAliasedPath(pDoc->path());
@@ -24,13 +24,17 @@
 #include "SessionCodeSearch.hpp"
 #include "SessionMarkers.hpp"
 #include "SessionRParser.hpp"
+#include "SessionRTokenCache.hpp"
 
 #include <set>
 
 #include <core/Debug.hpp>
 #include <core/Exec.hpp>
+#include <core/collection/LruCache.hpp>
 #include <shared_core/Error.hpp>
+#include <shared_core/Hash.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Thread.hpp>
 #include <core/YamlUtil.hpp>
 
 #include <session/SessionRUtil.hpp>
@@ -41,6 +45,8 @@
 
 #include "shiny/SessionShiny.hpp"
 
+#include <boost/atomic.hpp>
+#include <boost/enable_shared_from_this.hpp>
 #include <boost/scope_exit.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/bind/bind.hpp>
@@ -639,13 +645,10 @@ void setFileLocalParseOptions(const std::wstring& rCode,
 
 } // end anonymous namespace
 
-ParseResults parse(const std::wstring& rCode,
-                   const FilePath& origin,
-                   const std::string& documentId = std::string(),
-                   bool isExplicit = false,
-                   bool isFragment = false)
+namespace {
+
+ParseOptions defaultParseOptions(bool isExplicit, bool isFragment)
 {
-   ParseResults results;
    ParseOptions options;
    
    options.setLintRFunctions(
@@ -671,12 +674,33 @@ ParseResults parse(const std::wstring& rCode,
                prefs::userPrefs().warnIfNoSuchVariableInScope());
    }
    
+   return options;
+}
+
+ParseResults parseWithOptions(const std::wstring& rCode,
+                              const FilePath& origin,
+                              const std::string& documentId,
+                              ParseOptions options)
+{
+   ParseResults results;
+   
    bool noLint = false;
    setFileLocalParseOptions(rCode, &options, &noLint);
    if (noLint)
       return ParseResults();
    
-   results = rparser::parse(origin, rCode, options);
+   // documents open in the editor share their tokens with other
+   // consumers (e.g. code search) through the token cache
+   if (documentId.empty())
+   {
+      results = rparser::parse(origin, rCode, options);
+   }
+   else
+   {
+      boost::shared_ptr<RTokens> pTokens = token_cache::tokens(
+               documentId, rCode, RTokens::StripComments);
+      results = rparser::parse(origin, *pTokens, options);
+   }
    
    ParseNode* pRoot = results.parseTree();
    if (!pRoot)
@@ -704,6 +728,21 @@ ParseResults parse(const std::wstring& rCode,
    return results;
 }
 
+} // end anonymous namespace
+
+ParseResults parse(const std::wstring& rCode,
+                   const FilePath& origin,
+                   const std::string& documentId = std::string(),
+                   bool isExplicit = false,
+                   bool isFragment = false)
+{
+   return parseWithOptions(
+            rCode,
+            origin,
+            documentId,
+            defaultParseOptions(isExplicit, isFragment));
+}
+
 ParseResults parse(const std::string& rCode,
                    const FilePath& origin,
                    const std::string& documentId)
@@ -975,6 +1014,24 @@ SEXP rs_lintRFile(SEXP filePathSEXP)
    return r::sexp::create(builder, &protect);
 }
 
+// Lint results from previous runs of 'rs_lintDirectory', keyed by the
+// absolute path of the linted file. Entries are only reused when both the
+// file contents and the active lint options are unchanged; the least
+// recently linted files are dropped once the cache is full.
+struct LintCacheEntry
+{
+   std::string hash;
+   LintItems lint;
+};
+
+const unsigned int kMaxLintCacheEntries = 2000;
+
+collection::LruCache<std::string, LintCacheEntry>& lintCache()
+{
+   static collection::LruCache<std::string, LintCacheEntry> instance(kMaxLintCacheEntries);
+   return instance;
+}
+
 void onNAMESPACEchanged()
 {
    using namespace r::exec;
@@ -1018,6 +1075,10 @@ void onNAMESPACEchanged()
    RSourceIndex::setImportedPackages(importPkgNames);
    RSourceIndex::setImportFromDirectives(importFromSymbols);
    
+   // symbols available to package code have changed; previously
+   // cached lint may no longer be accurate
+   lintCache().clear();
+   
    // Kick off an update of the cached async completions
    r_packages::AsyncPackageInformationProcess::update();
 }
@@ -1051,32 +1112,214 @@ void afterSessionInitHook(bool newSession)
    }
 }
 
-bool collectLint(int depth,
-                 const FilePath& path,
-                 std::map<FilePath, LintItems>* pLint)
+// A file read (and hashed) by one of the lint worker threads, ready
+// to be parsed on the main thread.
+struct LintWorkItem
 {
-   if (path.getExtensionLowerCase() != ".r")
-      return true;
+   FilePath path;
+   std::string hash;
+   std::wstring contents;
+   bool valid;
+};
+
+// maximum number of threads used to read files for a directory lint
+const std::size_t kMaxLintWorkerThreads = 4;
+
+// how often lint markers are refreshed while a directory lint is running
+const boost::posix_time::milliseconds kLintUpdateInterval(250);
+
+std::string parseOptionsHash(const ParseOptions& options)
+{
+   std::string hash;
+   hash.push_back(options.lintRFunctions() ? '1' : '0');
+   hash.push_back(options.checkArgumentsToRFunctionCalls() ? '1' : '0');
+   hash.push_back(options.checkUnexpectedAssignmentInFunctionCall() ? '1' : '0');
+   hash.push_back(options.warnIfNoSuchVariableInScope() ? '1' : '0');
+   hash.push_back(options.warnIfVariableIsDefinedButNotUsed() ? '1' : '0');
+   hash.push_back(options.recordStyleLint() ? '1' : '0');
+   return hash;
+}
+
+// Lints all R files within a directory. Files are read and hashed on a pool
+// of worker threads; parsing happens on the main thread (the parser may
+// need to consult R) as incremental work, so the console stays responsive.
+// Markers are sent to the client as files complete.
+class DirectoryLintJob : boost::noncopyable,
+                         public boost::enable_shared_from_this<DirectoryLintJob>
+{
+public:
    
-   std::string contents;
-   Error error = core::readStringFromFile(
-            path,
-            &contents,
-            string_utils::LineEndingPosix);
+   static boost::shared_ptr<DirectoryLintJob> create(
+         const std::vector<FilePath>& files)
+   {
+      boost::shared_ptr<DirectoryLintJob> pJob(new DirectoryLintJob(files));
+      return pJob;
+   }
    
-   if (error)
+   void start()
    {
-      LOG_ERROR(error);
-      return true;
+      for (const FilePath& file : files_)
+         pendingFiles_.enque(file);
+      
+      std::size_t threadCount = std::min(
+               static_cast<std::size_t>(std::max(boost::thread::hardware_concurrency(), 1u)),
+               std::min(files_.size(), kMaxLintWorkerThreads));
+      
+      for (std::size_t i = 0; i < threadCount; ++i)
+      {
+         boost::thread thread;
+         core::thread::safeLaunchThread(
+                  boost::bind(&DirectoryLintJob::readFiles, shared_from_this()),
+                  &thread);
+         
+         // (a thread which failed to launch has already been logged)
+         if (thread.joinable())
+         {
+            thread.detach();
+            ++workerCount_;
+         }
+      }
+      
+      module_context::scheduleIncrementalWork(
+               boost::posix_time::milliseconds(100),
+               boost::posix_time::milliseconds(20),
+               boost::bind(&DirectoryLintJob::parseFiles, shared_from_this()));
    }
    
-   ParseResults results = diagnostics::parse(
-            string_utils::utf8ToWide(contents),
-            path,
-            std::string(),
-            true);
+   void cancel()
+   {
+      cancelled_ = true;
+   }
+   
+private:
+   
+   explicit DirectoryLintJob(const std::vector<FilePath>& files)
+      : files_(files),
+        pendingFiles_(true),
+        readFiles_(true),
+        options_(defaultParseOptions(true, false)),
+        optionsHash_(parseOptionsHash(options_)),
+        parsedCount_(0),
+        workerCount_(0),
+        cancelled_(false)
+   {
+   }
+   
+   // worker thread
+   void readFiles()
+   {
+      FilePath path;
+      while (!cancelled_ && pendingFiles_.deque(&path))
+         readFiles_.enque(readFile(path));
+   }
+   
+   LintWorkItem readFile(const FilePath& path)
+   {
+      LintWorkItem item;
+      item.path = path;
+      item.valid = false;
+      
+      std::string contents;
+      Error error = core::readStringFromFile(
+               path,
+               &contents,
+               string_utils::LineEndingPosix);
+      
+      if (error)
+      {
+         LOG_ERROR(error);
+      }
+      else
+      {
+         item.hash = hash::crc32HexHash(contents) + optionsHash_;
+         item.contents = string_utils::utf8ToWide(contents);
+         item.valid = true;
+      }
+      
+      return item;
+   }
+   
+   // main thread
+   bool parseFiles()
+   {
+      if (cancelled_)
+         return false;
+      
+      LintWorkItem item;
+      if (workerCount_ == 0)
+      {
+         // no worker threads could be launched; read files here instead
+         FilePath path;
+         if (!pendingFiles_.deque(&path))
+            return false;
+         item = readFile(path);
+      }
+      else if (!readFiles_.deque(&item, boost::posix_time::milliseconds(5)))
+      {
+         return true;
+      }
+      
+      ++parsedCount_;
+      if (item.valid)
+         lint_[item.path] = lintFile(item);
+      
+      bool done = parsedCount_ == files_.size();
+      if (done || lastUpdate_.is_not_a_date_time() ||
+          boost::posix_time::microsec_clock::universal_time() - lastUpdate_ > kLintUpdateInterval)
+      {
+         module_context::SourceMarkerSet markers = asSourceMarkerSet(lint_);
+         module_context::showSourceMarkers(markers, module_context::MarkerAutoSelectNone);
+         lastUpdate_ = boost::posix_time::microsec_clock::universal_time();
+      }
+      
+      return !done;
+   }
+   
+   LintItems lintFile(const LintWorkItem& item)
+   {
+      std::string key = item.path.getAbsolutePath();
+      LintCacheEntry entry;
+      if (lintCache().get(key, &entry) && entry.hash == item.hash)
+         return entry.lint;
+      
+      ParseResults results = parseWithOptions(
+               item.contents,
+               item.path,
+               std::string(),
+               options_);
+      
+      entry.hash = item.hash;
+      entry.lint = results.lint();
+      lintCache().insert(key, entry);
+      return entry.lint;
+   }
+   
+private:
+   
+   std::vector<FilePath> files_;
+   core::thread::ThreadsafeQueue<FilePath> pendingFiles_;
+   core::thread::ThreadsafeQueue<LintWorkItem> readFiles_;
+   
+   // main thread only
+   ParseOptions options_;
+   std::string optionsHash_;
+   std::map<FilePath, LintItems> lint_;
+   std::size_t parsedCount_;
+   std::size_t workerCount_;
+   boost::posix_time::ptime lastUpdate_;
+   
+   boost::atomic<bool> cancelled_;
+};
+
+boost::shared_ptr<DirectoryLintJob> s_pDirectoryLintJob;
+
+bool collectRFiles(int depth,
+                   const FilePath& path,
+                   std::vector<FilePath>* pFiles)
+{
+   if (path.getExtensionLowerCase() == ".r")
+      pFiles->push_back(path);
    
-   (*pLint)[path] = results.lint();
    return true;
 }
 
@@ -1087,18 +1330,30 @@ SEXP rs_lintDirectory(SEXP directorySEXP)
    if (!dirPath.exists())
       return R_NilValue;
    
-   std::map<FilePath, LintItems> lint;
+   std::vector<FilePath> files;
    Error error = dirPath.getChildrenRecursive(
-            boost::bind(collectLint, _1, _2, &lint));
+            boost::bind(collectRFiles, _1, _2, &files));
    if (error)
    {
       LOG_ERROR(error);
       return R_NilValue;
    }
    
-   using namespace module_context;
-   SourceMarkerSet markers = asSourceMarkerSet(lint);
-   showSourceMarkers(markers, MarkerAutoSelectNone);
+   // only one directory lint runs at a time
+   if (s_pDirectoryLintJob)
+      s_pDirectoryLintJob->cancel();
+   
+   if (files.empty())
+   {
+      std::map<FilePath, LintItems> lint;
+      module_context::showSourceMarkers(
+               asSourceMarkerSet(lint),
+               module_context::MarkerAutoSelectNone);
+      return R_NilValue;
+   }
+   
+   s_pDirectoryLintJob = DirectoryLintJob::create(files);
+   s_pDirectoryLintJob->start();
    return R_NilValue;
 }
 
@@ -398,11 +398,135 @@ bool isUntracked(const source_control::StatusResult& statusResult,
    return statusResult.getStatus(filePath).status() == "??";
 }
 
+// Parses the output of 'git status -z --porcelain' into files with their
+// status. Output can be supplied in arbitrary chunks (e.g. as it streams in
+// from git); records are parsed in place rather than split out into copies.
+class StatusParser : boost::noncopyable
+{
+public:
+   explicit StatusParser(const FilePath& root)
+      : root_(root), expectingRenameSource_(false)
+   {
+   }
+
+   void parse(const std::string& output)
+   {
+      std::size_t pos = 0;
+
+      // complete a record split across chunks
+      if (!partial_.empty())
+      {
+         std::size_t end = output.find('\0');
+         if (end == std::string::npos)
+         {
+            partial_.append(output);
+            return;
+         }
+
+         partial_.append(output, 0, end);
+         parseRecord(partial_.data(), partial_.size());
+         partial_.clear();
+         pos = end + 1;
+      }
+
+      while (pos < output.size())
+      {
+         std::size_t end = output.find('\0', pos);
+         if (end == std::string::npos)
+         {
+            partial_.assign(output, pos, std::string::npos);
+            break;
+         }
+
+         parseRecord(output.data() + pos, end - pos);
+         pos = end + 1;
+      }
+   }
+
+   const std::vector<FileWithStatus>& files() const
+   {
+      return files_;
+   }
+
+private:
+   void parseRecord(const char* record, std::size_t length)
+   {
+      // if this was a git rename or copy, this record is the source of the
+      // rename; note that Git flips the order of filenames when running with '-z'
+      if (expectingRenameSource_)
+      {
+         expectingRenameSource_ = false;
+         addFile(pendingStatus_, std::string(record, length) + " -> " + pendingPath_);
+         return;
+      }
+
+      if (length < 4)
+         return;
+
+      std::string status(record, 2);
+      std::string filePath(record + 3, length - 3);
+
+      if (status == "R " || status == "C ")
+      {
+         expectingRenameSource_ = true;
+         pendingStatus_ = status;
+         pendingPath_ = filePath;
+         return;
+      }
+
+      addFile(status, filePath);
+   }
+
+   void addFile(const std::string& status, std::string filePath)
+   {
+      // remove trailing slashes
+      if (filePath.length() > 1 && filePath[filePath.length() - 1] == '/')
+         filePath.erase(filePath.length() - 1);
+
+      // file paths are returned as UTF-8 encoded paths,
+      // so no need to re-encode here
+      FileWithStatus file;
+      file.status = status;
+      file.path = root_.completeChildPath(filePath);
+      files_.push_back(file);
+   }
+
+   FilePath root_;
+   std::string partial_;
+   bool expectingRenameSource_;
+   std::string pendingStatus_;
+   std::string pendingPath_;
+   std::vector<FileWithStatus> files_;
+};
+
 class Git : public boost::noncopyable
 {
 private:
    FilePath root_;
 
+   // The commit graph for the (unfiltered) history most recently paged
+   // through, so that requests for subsequent pages only need to extend the
+   // graph rather than recompute it from the tip of the history
+   struct CommitGraphCache
+   {
+      CommitGraphCache() : complete(false) {}
+
+      // the repository and resolved revisions the graph was built from;
+      // when the tip changes (e.g. after a commit) the graph is discarded
+      std::string key;
+
+      // the graph line for each commit (in rev-list --date-order order)
+      std::vector<std::string> lines;
+
+      // the state of the graph after the last commit in lines
+      gitgraph::GitGraphState state;
+
+      // have all commits been added?
+      bool complete;
+   };
+
+   CommitGraphCache graphCache_;
+
 protected:
    core::Error runGit(const ShellArgs& args,
                       std::string* pStdOut=nullptr,
@@ -517,57 +641,22 @@ public:
       root_ = path;
    }
 
+   ShellArgs statusArgs(const FilePath& dir)
+   {
+      return gitArgs() << "status" << "-z" << "--porcelain" << "--" << dir;
+   }
+
    core::Error status(const FilePath& dir,
                       StatusResult* pStatusResult)
    {
-      using namespace boost;
-
-      // objects to be populated from git's output
-      std::vector<FileWithStatus> files;
-      
-      // build shell arguments
-      ShellArgs arguments = gitArgs();
-      
-      arguments << "status" << "-z" << "--porcelain" << "--" << dir;
-      
       std::string output;
-      Error error = runGit(arguments, &output);
+      Error error = runGit(statusArgs(dir), &output);
       if (error)
          return error;
-      
-      // split and parse each piece of status output
-      std::vector<std::string> pieces = core::algorithm::split(output, "\0");
 
-      for (std::vector<std::string>::iterator it = pieces.begin();
-           it != pieces.end();
-           it++)
-      {
-         std::string line = *it;
-         if (line.length() < 4)
-            continue;
-         FileWithStatus file;
-
-         std::string status = line.substr(0, 2);
-         std::string filePath = line.substr(3);
-         file.status = status;
-         
-         // if this was a git rename or copy, we need to capture the rename target from the next
-         // field. note that Git flips the order of filenames when running with '-z'
-         if (status == "R " || status == "C ")
-            filePath = *(++it) + " -> " + filePath;
-
-         // remove trailing slashes
-         if (filePath.length() > 1 && filePath[filePath.length() - 1] == '/')
-            filePath = filePath.substr(0, filePath.size() - 1);
-
-         // file paths are returned as UTF-8 encoded paths,
-         // so no need to re-encode here
-         file.path = root_.completeChildPath(filePath);
-
-         files.push_back(file);
-      }
-
-      *pStatusResult = StatusResult(files);
+      StatusParser parser(root_);
+      parser.parse(output);
+      *pStatusResult = StatusResult(parser.files());
 
       return Success();
    }
@@ -1217,6 +1306,93 @@ public:
       }
    }
 
+   // Get the commit graph lines for the given range of the (unfiltered)
+   // history of rev, computing and caching only as much of the graph as
+   // hasn't already been computed for previous requests
+   core::Error commitGraph(const std::string& rev,
+                           int skip,
+                           int count,
+                           std::vector<std::string>* pLines)
+   {
+      // resolve the revisions to commit ids: the graph only depends on
+      // these, so it remains valid for as long as they don't move
+      std::string output;
+      int exitCode = EXIT_FAILURE;
+      Error error = runGit(gitArgs() << "rev-parse" << (rev.empty() ? "HEAD" : rev),
+                           &output, nullptr, &exitCode);
+      if (error)
+         return error;
+
+      std::vector<std::string> revs;
+      if (exitCode == EXIT_SUCCESS)
+      {
+         for (const std::string& line : split(output))
+         {
+            if (!line.empty())
+               revs.push_back(line);
+         }
+      }
+      if (revs.empty())
+         return Success();
+
+      std::string key = root_.getAbsolutePath() + "\n" + core::algorithm::join(revs, "\n");
+      if (key != graphCache_.key)
+      {
+         graphCache_ = CommitGraphCache();
+         graphCache_.key = key;
+      }
+
+      skip = std::max(skip, 0);
+      std::size_t needed = count < 0 ?
+               std::numeric_limits<std::size_t>::max() :
+               static_cast<std::size_t>(skip) + count;
+
+      // extend the graph with the commits we haven't seen yet
+      if (!graphCache_.complete && graphCache_.lines.size() < needed)
+      {
+         ShellArgs revListArgs = gitArgs() << "rev-list" << "--date-order" << "--parents";
+         std::size_t have = graphCache_.lines.size();
+         if (have > 0)
+            revListArgs << "--skip=" + safe_convert::numberToString(have);
+         if (count >= 0)
+            revListArgs << "--max-count=" + safe_convert::numberToString(needed - have);
+         revListArgs << revs;
+
+         std::string revOutput;
+         error = runGit(revListArgs, &revOutput);
+         if (error)
+            return error;
+         std::vector<std::string> revOutLines = split(revOutput);
+         revOutput.clear();
+
+         gitgraph::GitGraph graph(graphCache_.state);
+         for (const std::string& revOutLine : revOutLines)
+         {
+            std::vector<std::string> parents;
+            boost::algorithm::split(parents, revOutLine,
+                                    boost::algorithm::is_any_of(" "));
+            if (parents.empty() || parents.front().empty())
+               continue;
+
+            std::string commit = parents.front();
+            parents.erase(parents.begin());
+
+            graphCache_.lines.push_back(graph.addCommit(commit, parents).string());
+         }
+         graphCache_.state = graph.state();
+
+         // if rev-list came up short then we've reached the end
+         if (graphCache_.lines.size() < needed)
+            graphCache_.complete = true;
+      }
+
+      const std::vector<std::string>& lines = graphCache_.lines;
+      std::size_t begin = std::min(static_cast<std::size_t>(skip), lines.size());
+      std::size_t end = std::min(needed, lines.size());
+      pLines->assign(lines.begin() + begin, lines.begin() + end);
+      return Success();
+   }
+
    core::Error log(const std::string& rev,
                    const FilePath& fileFilter,
                    int skip,
@@ -1228,13 +1404,12 @@ public:
                        << "--pretty=raw" << "--decorate=full"
                        << "--date-order";
 
-      ShellArgs revListArgs = gitArgs() << "rev-list" << "--date-order" << "--parents";
-      int revListSkip = skip;
+      int graphSkip = skip;
+      int graphCount = maxentries;
 
       if (!fileFilter.isEmpty())
       {
          args << "--" << fileFilter;
-         revListArgs << "--" << fileFilter;
       }
 
       if (searchText.empty() && fileFilter.isEmpty())
@@ -1250,21 +1425,11 @@ public:
          {
             args << "--max-count=" + safe_convert::numberToString(maxentries);
             maxentries = -1;
-
-            revListArgs << "--max-count=" + safe_convert::numberToString(
-                  (skip < 0 ? 0 : skip) + maxentries);
          }
       }
 
       if (!rev.empty())
-      {
          args << rev;
-         revListArgs << rev;
-      }
-      else
-      {
-         revListArgs << "HEAD";
-      }
 
       if (maxentries < 0)
          maxentries = std::numeric_limits<int>::max();
@@ -1280,31 +1445,9 @@ public:
       std::vector<std::string> graphLines;
       if (searchText.empty() && fileFilter.isEmpty())
       {
-         std::vector<std::string> revOutLines;
-         std::string revOutput;
-         error = runGit(revListArgs, &revOutput);
+         error = commitGraph(rev, graphSkip, graphCount, &graphLines);
          if (error)
             return error;
-         revOutLines = split(revOutput);
-         revOutput.clear();
-
-         gitgraph::GitGraph graph;
-         for (size_t i = 0; i < revOutLines.size(); i++)
-         {
-            typedef std::vector<std::string> find_vector_type;
-            find_vector_type parents;
-            boost::algorithm::split(parents, revOutLines[i],
-                                    boost::algorithm::is_any_of(" "));
-            if (parents.size() < 1)
-               break;
-
-            std::string commit = parents.front();
-            parents.erase(parents.begin());
-
-            gitgraph::Line line = graph.addCommit(commit, parents);
-            if (revListSkip <= 0 || gsl::narrow_cast<int>(i) >= revListSkip)
-               graphLines.push_back(line.string());
-         }
       }
 
       boost::function<bool(CommitInfo)> filter = createSearchTextPredicate(searchText);
@@ -1484,6 +1627,408 @@ public:
 
 Git s_git_;
 
+// Keeps the status of the whole repository cached between requests. When
+// the project's file monitor covers the repository, file changes mark the
+// cached status as out of date and schedule a refresh; bursts of changes
+// are coalesced into a single refresh, which runs git asynchronously and
+// notifies the client of only those files whose status changed.
+class StatusMonitor : boost::noncopyable
+{
+public:
+   StatusMonitor()
+      : monitoring_(false),
+        valid_(false),
+        changed_(false),
+        refreshScheduled_(false),
+        refreshRunning_(false),
+        generation_(0)
+   {
+   }
+
+   void onMonitoringEnabled(const tree<core::FileInfo>&)
+   {
+      // we only learn about changes within the project directory, so the
+      // cache can only be kept up to date when it contains the repository
+      FilePath projectDir = projects::projectContext().directory();
+      monitoring_ = !s_git_.root().isEmpty() &&
+                    s_git_.root().isWithin(projectDir);
+      invalidate();
+   }
+
+   void onMonitoringDisabled()
+   {
+      monitoring_ = false;
+      invalidate();
+   }
+
+   void onFilesChanged(const std::vector<core::system::FileChangeEvent>& events)
+   {
+      if (!monitoring_)
+         return;
+
+      // ignore changes to git's own files (which running status can itself
+      // cause); changes to the index and HEAD are detected separately
+      FilePath gitDir = this->gitDir();
+      bool changed = false;
+      for (const core::system::FileChangeEvent& event : events)
+      {
+         FilePath path(event.fileInfo().absolutePath());
+         if (!path.isWithin(gitDir))
+         {
+            changed = true;
+            break;
+         }
+      }
+
+      if (changed)
+      {
+         // the cached status is always out of date after a change, but is
+         // only refreshed in the background when auto-refresh is on
+         changed_ = true;
+         generation_++;
+         if (prefs::userPrefs().vcsAutorefresh())
+            scheduleRefresh();
+      }
+   }
+
+   void invalidate()
+   {
+      // a refresh already running may not reflect whatever invalidated the
+      // status, so it is refreshed again once it completes
+      generation_++;
+      valid_ = false;
+      statusByPath_.clear();
+      result_ = StatusResult();
+   }
+
+   // Get the cached status of the repository. If allowOutOfDate is true then
+   // the status may not yet reflect recent changes to files, provided a
+   // refresh is pending (which will notify the client of any resulting
+   // changes); with auto-refresh off, none may be
+   bool cachedStatus(bool allowOutOfDate, StatusResult* pResult)
+   {
+      if (!monitoring_ || !valid_ || repositoryState() != repositoryState_)
+         return false;
+
+      if (!allowOutOfDate || !(refreshScheduled_ || refreshRunning_))
+      {
+         if (changed_)
+            return false;
+
+         using namespace boost::posix_time;
+         if (second_clock::universal_time() - updateTime_ > seconds(kMaxCacheAgeSeconds))
+            return false;
+      }
+
+      *pResult = result_;
+      return true;
+   }
+
+   // Record status computed for the whole repository (the repository state
+   // should have been read before git was run)
+   void update(const std::vector<FileWithStatus>& files,
+               const std::string& repositoryState)
+   {
+      if (!monitoring_)
+         return;
+
+      statusByPath_.clear();
+      for (const FileWithStatus& file : files)
+         statusByPath_[file.path.getAbsolutePath()] = file.status.status();
+
+      result_ = StatusResult(files);
+      repositoryState_ = repositoryState;
+      updateTime_ = boost::posix_time::second_clock::universal_time();
+      valid_ = true;
+      changed_ = false;
+   }
+
+   std::string repositoryState()
+   {
+      // the index and HEAD (or its log, as commits move the branch HEAD
+      // refers to) change with every git operation which could affect the
+      // status of files other than by editing them. modification times
+      // are only precise to the second (and staging a modified file can
+      // leave the index the same size), so the index is identified by the
+      // checksum of its contents which ends it, and HEAD by its contents
+      std::string state;
+      FilePath gitDir = this->gitDir();
+
+      FilePath indexPath = gitDir.completeChildPath("index");
+      if (indexPath.exists())
+         state += fileTrailer(indexPath, kIndexChecksumSize) + ";";
+
+      FilePath headPath = gitDir.completeChildPath("HEAD");
+      std::string head;
+      if (headPath.exists() && !readStringFromFile(headPath, &head))
+         state += head + ";";
+
+      FilePath logPath = gitDir.completeChildPath("logs/HEAD");
+      if (logPath.exists())
+         state += safe_convert::numberToString(logPath.getLastWriteTime()) + ":" +
+                  safe_convert::numberToString(logPath.getSize()) + ";";
+
+      return state;
+   }
+
+private:
+   // the last bytes of a file (or all of it, if it's smaller), along with
+   // its size
+   static std::string fileTrailer(const FilePath& path, std::size_t count)
+   {
+      std::shared_ptr<std::istream> pIfs;
+      Error error = path.openForRead(pIfs);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return std::string();
+      }
+
+      uintmax_t size = path.getSize();
+      std::size_t n = static_cast<std::size_t>(std::min<uintmax_t>(size, count));
+      std::string trailer(n, '\0');
+      pIfs->seekg(static_cast<std::streamoff>(size - n));
+      pIfs->read(&trailer[0], static_cast<std::streamsize>(n));
+      if (!*pIfs)
+         return std::string();
+
+      return safe_convert::numberToString(size) + ":" + trailer;
+   }
+
+   // the repository's git directory; this is not <root>/.git for worktrees
+   // and submodules (where .git is a file pointing elsewhere)
+   FilePath gitDir()
+   {
+      if (s_git_.root() != gitDirRoot_)
+      {
+         gitDirRoot_ = s_git_.root();
+         gitDir_ = gitDirRoot_.completeChildPath(".git");
+
+         core::system::ProcessResult result;
+         Error error = gitExec(gitArgs() << "rev-parse" << "--git-dir",
+                               gitDirRoot_,
+                               &result);
+         if (error)
+            LOG_ERROR(error);
+         else if (result.exitStatus == EXIT_SUCCESS)
+            gitDir_ = gitDirRoot_.completePath(
+                     boost::algorithm::trim_copy(result.stdOut));
+      }
+      return gitDir_;
+   }
+
+   void scheduleRefresh()
+   {
+      if (refreshScheduled_)
+         return;
+
+      refreshScheduled_ = true;
+      module_context::scheduleDelayedWork(
+               boost::posix_time::milliseconds(kRefreshDelayMs),
+               boost::bind(&StatusMonitor::refresh, this),
+               false);
+   }
+
+   void refresh()
+   {
+      refreshScheduled_ = false;
+
+      // if a refresh is already running then we'll refresh again when it
+      // completes (as there were further changes in the meantime)
+      if (refreshRunning_ || !monitoring_ || s_git_.root().isEmpty())
+         return;
+
+      // no need to refresh if the status was updated in the meantime
+      if (!changed_)
+         return;
+
+      core::system::ProcessOptions options = procOptions();
+      options.workingDir = s_git_.root();
+#ifdef _WIN32
+      options.detachProcess = true;
+#endif
+
+      boost::shared_ptr<StatusParser> pParser =
+            boost::make_shared<StatusParser>(s_git_.root());
+      std::string repositoryState = this->repositoryState();
+      int generation = generation_;
+
+      core::system::ProcessCallbacks callbacks;
+      callbacks.onStdout = [=](core::system::ProcessOperations&, const std::string& output)
+      {
+         pParser->parse(output);
+      };
+      callbacks.onExit = [=](int exitStatus)
+      {
+         onRefreshCompleted(exitStatus, *pParser, repositoryState, generation);
+      };
+
+      ShellArgs args = s_git_.statusArgs(s_git_.root());
+#ifdef _WIN32
+      Error error = module_context::processSupervisor().runProgram(
+               gitBin(), args.args(), options, callbacks);
+#else
+      Error error = module_context::processSupervisor().runCommand(
+               git() << args.args(), options, callbacks);
+#endif
+      if (error)
+      {
+         LOG_ERROR(error);
+         invalidate();
+         return;
+      }
+
+      refreshRunning_ = true;
+   }
+
+   void onRefreshCompleted(int exitStatus,
+                           const StatusParser& parser,
+                           const std::string& repositoryState,
+                           int generation)
+   {
+      refreshRunning_ = false;
+
+      if (exitStatus != EXIT_SUCCESS)
+      {
+         invalidate();
+         return;
+      }
+
+      bool wasValid = valid_;
+      std::map<std::string, std::string> previous = statusByPath_;
+      update(parser.files(), repositoryState);
+      if (wasValid)
+         notifyChanges(previous);
+
+      // if files changed while git was running then the result may not
+      // reflect them, so refresh again
+      if (generation != generation_)
+      {
+         changed_ = true;
+         scheduleRefresh();
+      }
+   }
+
+   void notifyChanges(const std::map<std::string, std::string>& previous)
+   {
+      // collect paths whose status changed (including files that no longer
+      // have a status, e.g. because they were committed or reverted)
+      std::vector<std::string> changedPaths;
+      auto prevIt = previous.begin();
+      auto curIt = statusByPath_.begin();
+      while (prevIt != previous.end() || curIt != statusByPath_.end())
+      {
+         if (curIt == statusByPath_.end() ||
+             (prevIt != previous.end() && prevIt->first < curIt->first))
+         {
+            changedPaths.push_back(prevIt->first);
+            ++prevIt;
+         }
+         else if (prevIt == previous.end() || curIt->first < prevIt->first)
+         {
+            changedPaths.push_back(curIt->first);
+            ++curIt;
+         }
+         else
+         {
+            if (prevIt->second != curIt->second)
+               changedPaths.push_back(curIt->first);
+            ++prevIt;
+            ++curIt;
+         }
+      }
+
+      if (changedPaths.empty())
+         return;
+
+      // for large changes (or renames, which the client can't apply one
+      // file at a time) let the client fetch the full status instead
+      bool fullRefresh = changedPaths.size() > kMaxChangeNotifications;
+      for (const std::string& path : changedPaths)
+      {
+         if (fullRefresh)
+            break;
+         fullRefresh = path.find(" -> ") != std::string::npos;
+      }
+
+      if (fullRefresh)
+      {
+         enqueueRefreshEvent();
+         return;
+      }
+
+      // the client updates the status of a file when notified of a change
+      // to it; this is the same notification the file monitor would send
+      for (const std::string& path : changedPaths)
+      {
+         FilePath filePath(path);
+         core::system::FileChangeEvent event(
+                  filePath.exists() ? core::system::FileChangeEvent::FileModified :
+                                      core::system::FileChangeEvent::FileRemoved,
+                  core::FileInfo(filePath));
+         module_context::enqueFileChangedEvent(event);
+      }
+   }
+
+   // how long to wait for further changes before refreshing
+   static const int kRefreshDelayMs = 300;
+
+   // how long the cache can be used for explicit status requests, in case
+   // the file monitor missed changes (e.g. in ignored directories)
+   static const int kMaxCacheAgeSeconds = 60;
+
+   // the most individual file changes to notify the client of
+   static const std::size_t kMaxChangeNotifications = 200;
+
+   // the size of the checksum ending the index (SHA-256 for repositories
+   // using it; for SHA-1 this also takes in the end of the index's entries)
+   static const std::size_t kIndexChecksumSize = 32;
+
+   bool monitoring_;
+   bool valid_;
+   bool changed_;
+   bool refreshScheduled_;
+   bool refreshRunning_;
+   int generation_;
+
+   StatusResult result_;
+   std::map<std::string, std::string> statusByPath_;
+   std::string repositoryState_;
+   boost::posix_time::ptime updateTime_;
+
+   FilePath gitDirRoot_;
+   FilePath gitDir_;
+};
+
+StatusMonitor s_statusMonitor;
+
+// git operations run by RStudio change the status of files without the file
+// monitor noticing (and often within the second the status was cached in),
+// so the cached status is discarded once they complete
+struct RefreshStatusOnExit : public RefreshOnExit
+{
+   ~RefreshStatusOnExit()
+   {
+      s_statusMonitor.invalidate();
+   }
+};
+
+// Get the status of the whole repository, using the cached status if it is
+// up to date
+Error repositoryStatus(StatusResult* pStatusResult)
+{
+   if (s_statusMonitor.cachedStatus(false, pStatusResult))
+      return Success();
+
+   std::string repositoryState = s_statusMonitor.repositoryState();
+   Error error = s_git_.status(s_git_.root(), pStatusResult);
+   if (error)
+      return error;
+
+   s_statusMonitor.update(pStatusResult->files(), repositoryState);
+   return Success();
+}
+
 FilePath resolveAliasedPath(const std::string& path)
 {
    if (boost::algorithm::starts_with(path, "~/"))
@@ -1554,6 +2099,16 @@ FilePath detectGitDir(const FilePath& workingDir)
 GitFileDecorationContext::GitFileDecorationContext(const FilePath& rootDir)
    : fullRefreshRequired_(false)
 {
+   // use the cached status of the repository if we have it: any changes
+   // it doesn't yet reflect will be sent to the client once it's refreshed
+   // (otherwise the status is only used if it's up to date)
+   if (!s_git_.root().isEmpty() &&
+       rootDir.isWithin(s_git_.root()) &&
+       s_statusMonitor.cachedStatus(true, &vcsStatus_))
+   {
+      return;
+   }
+
    // get source control status (merely log errors doing this)
    Error error = git::status(rootDir, &vcsStatus_);
    if (error)
@@ -1624,7 +2179,7 @@ namespace {
 Error vcsAdd(const json::JsonRpcRequest& request,
              json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    json::Array paths;
    Error error = json::readParam(request.params, 0, &paths);
@@ -1637,7 +2192,7 @@ Error vcsAdd(const json::JsonRpcRequest& request,
 Error vcsRemove(const json::JsonRpcRequest& request,
                 json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    json::Array paths;
    Error error = json::readParam(request.params, 0, &paths);
@@ -1650,7 +2205,7 @@ Error vcsRemove(const json::JsonRpcRequest& request,
 Error vcsDiscard(const json::JsonRpcRequest& request,
                  json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    json::Array paths;
    Error error = json::readParam(request.params, 0, &paths);
@@ -1663,7 +2218,7 @@ Error vcsDiscard(const json::JsonRpcRequest& request,
 Error vcsRevert(const json::JsonRpcRequest& request,
                 json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    json::Array paths;
    Error error = json::readParam(request.params, 0, &paths);
@@ -1683,7 +2238,7 @@ Error vcsRevert(const json::JsonRpcRequest& request,
 Error vcsStage(const json::JsonRpcRequest& request,
                json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    json::Array paths;
    Error error = json::readParam(request.params, 0, &paths);
@@ -1696,7 +2251,7 @@ Error vcsStage(const json::JsonRpcRequest& request,
 Error vcsUnstage(const json::JsonRpcRequest& request,
                  json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    json::Array paths;
    Error error = json::readParam(request.params, 0, &paths);
@@ -1793,7 +2348,7 @@ Error vcsFullStatus(const json::JsonRpcRequest&,
                     json::JsonRpcResponse* pResponse)
 {
    StatusResult statusResult;
-   Error error = s_git_.status(s_git_.root(), &statusResult);
+   Error error = repositoryStatus(&statusResult);
    if (error)
       return error;
 
@@ -1996,7 +2551,7 @@ Error vcsDiffFile(const json::JsonRpcRequest& request,
 Error vcsApplyPatch(const json::JsonRpcRequest& request,
                     json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    std::string patch;
    int mode;
@@ -2062,7 +2617,7 @@ Error vcsGetIgnores(const json::JsonRpcRequest& request,
 Error vcsSetIgnores(const json::JsonRpcRequest& request,
                     json::JsonRpcResponse* pResponse)
 {
-   RefreshOnExit refreshOnExit;
+   RefreshStatusOnExit refreshOnExit;
 
    // get the params
    std::string path, ignores;
@@ -3316,6 +3871,16 @@ core::Error initialize()
 
    module_context::events().onShutdown.connect(onShutdown);
 
+   // keep the cached repository status up to date with file changes
+   projects::FileMonitorCallbacks cb;
+   cb.onMonitoringEnabled = boost::bind(&StatusMonitor::onMonitoringEnabled,
+                                        &s_statusMonitor, _1);
+   cb.onFilesChanged = boost::bind(&StatusMonitor::onFilesChanged,
+                                   &s_statusMonitor, _1);
+   cb.onMonitoringDisabled = boost::bind(&StatusMonitor::onMonitoringDisabled,
+                                         &s_statusMonitor);
+   projects::projectContext().subscribeToFileMonitor("Git status", cb);
+
    initGitBin();
 
    bool interceptAskPass;
@@ -16,6 +16,9 @@
 #include "SessionHelp.hpp"
 
 #include <algorithm>
+#include <ctime>
+#include <deque>
+#include <set>
 #include <gsl/gsl>
 
 #include <boost/regex.hpp>
@@ -28,6 +31,8 @@
 
 #include <core/Algorithm.hpp>
 #include <shared_core/Error.hpp>
+#include <shared_core/Hash.hpp>
+#include <shared_core/SafeConvert.hpp>
 #include <core/Exec.hpp>
 #include <core/Log.hpp>
 
@@ -37,6 +42,7 @@
 #include <core/FileSerializer.hpp>
 #include <core/system/Process.hpp>
 #include <core/system/ShellUtils.hpp>
+#include <core/system/System.hpp>
 #include <core/r_util/RPackageInfo.hpp>
 
 #define R_INTERNAL_FUNCTIONS
@@ -47,6 +53,7 @@
 #include <r/ROptions.hpp>
 #include <r/RUtil.hpp>
 #include <r/RRoutines.hpp>
+#include <r/RVersionInfo.hpp>
 #include <r/session/RSessionUtils.hpp>
 
 #include <session/SessionModuleContext.hpp>
@@ -57,6 +64,7 @@
 #include "presentation/SlideRequestHandler.hpp"
 
 #include "SessionHelpHome.hpp"
+#include "SessionLibPathsIndexer.hpp"
 #include "session-config.h"
 
 #ifdef RSTUDIO_SERVER
@@ -672,6 +680,327 @@ SEXP callHandler(const std::string& path,
    return resultSEXP;
 }
 
+// Rendered help topics (/library/<pkg>/html/<topic>.html) are cached on
+// disk so they can be served without a round trip through R. The cache is
+// per user and keyed by R version, the installed copy of the package and the
+// options which affect rendering, so it is shared by concurrent (and future)
+// sessions using the same R. Sessions may use other copies of a package
+// (e.g. from a project library), so the topics of other copies are kept
+// alongside; only those not written for a while are pruned.
+const char * const kHelpTopicPattern = "^/library/([^/]+)/html/([^/]+)\\.html$";
+
+// the copies of a package whose topics are kept regardless of their age
+const std::size_t kMaxHelpTopicCacheKeys = 4;
+
+// how long the topics of other copies of a package are kept otherwise
+const std::time_t kHelpTopicCacheKeySeconds = 7 * 24 * 60 * 60;
+
+bool parseHelpTopicPath(const std::string& path,
+                        std::string* pPkgName,
+                        std::string* pTopic)
+{
+   static const boost::regex reHelpTopic(kHelpTopicPattern);
+   
+   boost::smatch match;
+   if (!regex_utils::match(path, match, reHelpTopic))
+      return false;
+   
+   *pPkgName = match[1];
+   *pTopic = match[2];
+   return true;
+}
+
+FilePath helpTopicCachePath(const std::string& path)
+{
+   std::string pkgName, topic;
+   if (!parseHelpTopicPath(path, &pkgName, &topic))
+      return FilePath();
+   
+   FilePath pkgPath = libpaths::findInstalledPackage(pkgName);
+   if (pkgPath.isEmpty())
+      return FilePath();
+   
+   FilePath descPath = pkgPath.completeChildPath("DESCRIPTION");
+   if (!descPath.exists())
+      return FilePath();
+   
+   // rendered topics also depend on options (e.g. 'help.htmlmath')
+   std::string options;
+   Error error = r::exec::RFunction(".rs.helpTopicCacheOptions").call(&options);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return FilePath();
+   }
+   
+   std::string key = core::hash::crc32HexHash(
+            pkgPath.getAbsolutePath() + ":" +
+            safe_convert::numberToString(descPath.getLastWriteTime()) + ":" +
+            options);
+   
+   std::ostringstream rVersion;
+   rVersion << r::version_info::currentRVersion();
+   
+   return module_context::userScratchPath()
+         .completeChildPath("help-cache")
+         .completeChildPath(rVersion.str())
+         .completeChildPath(pkgName)
+         .completeChildPath(key)
+         .completeChildPath(topic + ".html");
+}
+
+// returns the rendered content of a successful (and cacheable) httpd result;
+// that is, a plain HTML page with no custom headers or file indirection
+bool cacheableHttpdContent(SEXP httpdSEXP, std::string* pContent)
+{
+   if (TYPEOF(httpdSEXP) != VECSXP || LENGTH(httpdSEXP) == 0)
+      return false;
+   
+   if (LENGTH(httpdSEXP) > 1)
+   {
+      SEXP ctSEXP = VECTOR_ELT(httpdSEXP, 1);
+      if (TYPEOF(ctSEXP) == STRSXP && LENGTH(ctSEXP) > 0 &&
+          std::strcmp(CHAR(STRING_ELT(ctSEXP, 0)), "text/html") != 0)
+      {
+         return false;
+      }
+   }
+   
+   if (LENGTH(httpdSEXP) > 2)
+   {
+      SEXP headersSEXP = VECTOR_ELT(httpdSEXP, 2);
+      if (TYPEOF(headersSEXP) == STRSXP && LENGTH(headersSEXP) > 0)
+         return false;
+   }
+   
+   if (LENGTH(httpdSEXP) > 3 &&
+       r::sexp::asInteger(VECTOR_ELT(httpdSEXP, 3)) != http::status::Ok)
+   {
+      return false;
+   }
+   
+   SEXP payloadSEXP = VECTOR_ELT(httpdSEXP, 0);
+   if (TYPEOF(payloadSEXP) != STRSXP || LENGTH(payloadSEXP) != 1)
+      return false;
+   
+   if (isHttpdErrorPayload(payloadSEXP))
+      return false;
+   
+   SEXP namesSEXP = r::sexp::getNames(httpdSEXP);
+   if (TYPEOF(namesSEXP) == STRSXP && LENGTH(namesSEXP) > 0 &&
+       !std::strcmp(CHAR(STRING_ELT(namesSEXP, 0)), "file"))
+   {
+      return false;
+   }
+   
+   *pContent = r::sexp::asString(STRING_ELT(payloadSEXP, 0));
+   return !pContent->empty() && *pContent != "*FILE*";
+}
+
+bool readHelpTopicCache(const FilePath& cachePath, std::string* pContent)
+{
+   if (cachePath.isEmpty() || !cachePath.exists())
+      return false;
+   
+   Error error = readStringFromFile(cachePath, pContent);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+   
+   return true;
+}
+
+// topics with \Sexpr macros evaluated when rendered may differ each time
+bool hasRenderTimeSexprs(const std::string& path)
+{
+   std::string pkgName, topic;
+   if (!parseHelpTopicPath(path, &pkgName, &topic))
+      return true;
+   
+   FilePath pkgPath = libpaths::findInstalledPackage(pkgName);
+   if (pkgPath.isEmpty())
+      return true;
+   
+   bool hasSexprs = true;
+   Error error = r::exec::RFunction(".rs.helpTopicHasRenderSexprs",
+                                    pkgPath.getAbsolutePath(),
+                                    topic).call(&hasSexprs);
+   if (error)
+      LOG_ERROR(error);
+   
+   return hasSexprs;
+}
+
+// removes the topics cached for other copies of the package, other than the
+// most recently written and those written lately
+void pruneHelpTopicCache(const FilePath& keyDir)
+{
+   std::vector<FilePath> children;
+   Error error = keyDir.getParent().getChildren(children);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+   
+   std::vector<FilePath> keyDirs;
+   for (const FilePath& child : children)
+   {
+      if (child.isDirectory() && child != keyDir)
+         keyDirs.push_back(child);
+   }
+   
+   if (keyDirs.size() < kMaxHelpTopicCacheKeys)
+      return;
+   
+   std::sort(keyDirs.begin(), keyDirs.end(), [](const FilePath& lhs, const FilePath& rhs)
+   {
+      return lhs.getLastWriteTime() > rhs.getLastWriteTime();
+   });
+   
+   std::time_t now = std::time(nullptr);
+   for (std::size_t i = kMaxHelpTopicCacheKeys - 1; i < keyDirs.size(); i++)
+   {
+      if (now - keyDirs[i].getLastWriteTime() < kHelpTopicCacheKeySeconds)
+         continue;
+      
+      error = keyDirs[i].removeIfExists();
+      if (error)
+         LOG_ERROR(error);
+   }
+}
+
+void writeHelpTopicCache(const std::string& path,
+                         const FilePath& cachePath,
+                         SEXP httpdSEXP)
+{
+   std::string content;
+   if (cachePath.isEmpty() || !cacheableHttpdContent(httpdSEXP, &content))
+      return;
+   
+   if (hasRenderTimeSexprs(path))
+      return;
+   
+   // the first topic cached for a new copy of a package prunes the topics
+   // cached for other copies
+   FilePath keyDir = cachePath.getParent();
+   bool newKey = !keyDir.exists();
+   
+   Error error = keyDir.ensureDirectory();
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+   
+   if (newKey)
+      pruneHelpTopicCache(keyDir);
+   
+   // write to a temporary file and then move into place, so that
+   // other sessions never read a partially written topic
+   FilePath tempPath = keyDir.completeChildPath(
+            cachePath.getStem() + "-" + core::system::generateShortenedUuid());
+   
+   error = writeStringToFile(tempPath, content);
+   if (!error)
+      error = tempPath.move(cachePath, FilePath::MoveDirect, true);
+   
+   if (error)
+   {
+      LOG_ERROR(error);
+      tempPath.removeIfExists();
+   }
+}
+
+// Topics queued for background rendering. When the 'rstudio.help.prefetch'
+// option is set, the topics of each package loaded in the session are
+// rendered into the cache during idle time.
+std::deque<std::pair<std::string, std::string> > s_prefetchQueue;
+
+SEXP helpHandlerSource(const std::string&)
+{
+   return r::sexp::findFunction("httpd", "tools");
+}
+
+bool prefetchHelpTopics()
+{
+   if (s_prefetchQueue.empty())
+      return false;
+   
+   std::pair<std::string, std::string> entry = s_prefetchQueue.front();
+   s_prefetchQueue.pop_front();
+   
+   std::string path = "/library/" + entry.first + "/html/" + entry.second + ".html";
+   FilePath cachePath = helpTopicCachePath(path);
+   if (cachePath.isEmpty() || cachePath.exists())
+      return !s_prefetchQueue.empty();
+   
+   http::Request request;
+   request.setMethod("GET");
+   request.setUri(std::string(kHelpLocation) + path);
+   
+   r::sexp::Protect rp;
+   SEXP httpdSEXP;
+   Error error = r::exec::executeSafely<SEXP>(
+         boost::bind(callHandler,
+                     path,
+                     boost::cref(request),
+                     HandlerSource(helpHandlerSource),
+                     &rp),
+         &httpdSEXP);
+   
+   // not all topics render successfully; those are simply not cached
+   if (!error)
+      writeHelpTopicCache(path, cachePath, httpdSEXP);
+   
+   return !s_prefetchQueue.empty();
+}
+
+void onPackageLoaded(const std::string& pkgName)
+{
+   if (!r::options::getOption<bool>("rstudio.help.prefetch", false, false))
+      return;
+   
+   FilePath pkgPath = libpaths::findInstalledPackage(pkgName);
+   if (pkgPath.isEmpty())
+      return;
+   
+   // the topic index maps aliases to topic (Rd) names
+   FilePath indexPath = pkgPath.completeChildPath("help/AnIndex");
+   if (!indexPath.exists())
+      return;
+   
+   std::vector<std::string> lines;
+   Error error = readStringVectorFromFile(indexPath, &lines);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+   
+   std::set<std::string> topics;
+   for (const std::string& line : lines)
+   {
+      std::size_t index = line.find('\t');
+      if (index != std::string::npos && index + 1 < line.size())
+         topics.insert(line.substr(index + 1));
+   }
+   
+   bool running = !s_prefetchQueue.empty();
+   for (const std::string& topic : topics)
+      s_prefetchQueue.push_back(std::make_pair(pkgName, topic));
+   
+   if (!running && !s_prefetchQueue.empty())
+   {
+      module_context::scheduleIncrementalWork(
+               boost::posix_time::milliseconds(20),
+               prefetchHelpTopics,
+               true);
+   }
+}
+
 r_util::RPackageInfo packageInfoForRd(const FilePath& rdFilePath)
 {
    FilePath packageDir = rdFilePath.getParent().getParent();
@@ -831,6 +1160,22 @@ void handleHttpdRequest(const std::string& location,
       return;
    }
 
+   // serve rendered help topics from the cache when possible
+   FilePath topicCachePath;
+   if (location == kHelpLocation && request.queryParams().empty())
+   {
+      topicCachePath = helpTopicCachePath(path);
+      
+      std::string content;
+      if (readHelpTopicCache(topicCachePath, &content))
+      {
+         pResponse->setStatusCode(http::status::Ok);
+         pResponse->setContentType("text/html");
+         setDynamicContentResponse(content, request, filter, pResponse);
+         return;
+      }
+   }
+
    // evalute the handler
    r::sexp::Protect rp;
    SEXP httpdSEXP;
@@ -861,6 +1206,7 @@ void handleHttpdRequest(const std::string& location,
    else if (TYPEOF(httpdSEXP) == VECSXP && LENGTH(httpdSEXP) > 0)
    {
       handleHttpdResult(httpdSEXP, request, filter, pResponse);
+      writeHelpTopicCache(path, topicCachePath, httpdSEXP);
    }
    
    // unexpected SEXP type returned from httpd
@@ -1032,6 +1378,8 @@ Error initialize()
    Error error = initBlock.execute();
    if (error)
       return error;
+   
+   module_context::events().onPackageLoaded.connect(onPackageLoaded);
 
    // init help
    bool isDesktop = options().programMode() == kSessionProgramModeDesktop;
@@ -104,23 +104,6 @@ Error setJsonResultFromHistory(int startIndex,
    return Success();
 }
    
-bool matches(const HistoryEntry& entry,
-             const std::vector<std::string>& searchTerms)
-{   
-   // look for each search term in the input
-   for (std::vector<std::string>::const_iterator it = searchTerms.begin();
-        it != searchTerms.end();
-        ++it)
-   {
-      if (!boost::algorithm::contains(entry.command, *it))
-         return false;
-   }
-   
-   // had all of the search terms, return true
-   return true;
-}
-
-
 void historyRangeAsJson(int startIndex,
                         int endIndex,
                         json::Object* pHistoryJson)
@@ -320,25 +303,11 @@ Error searchHistoryArchive(const json::JsonRpcRequest& request,
    boost::tokenizer<boost::char_separator<char> > tok(query, sep);
    std::copy(tok.begin(), tok.end(), std::back_inserter(searchTerms));
    
-   // examine the items in the history for matches
-   const std::vector<HistoryEntry>& allEntries = historyArchive().entries();
+   // find matching items in the history
    std::vector<HistoryEntry> matchingEntries;
-   for (std::vector<HistoryEntry>::const_reverse_iterator 
-            it = allEntries.rbegin();
-            it != allEntries.rend();
-            ++it)
-   {
-      // check limit
-      if (matchingEntries.size() >= static_cast<std::size_t>(maxEntries))
-         break;
-
-      // look for match
-      if (matches(*it, searchTerms))
-      {
-         // add entry
-         matchingEntries.push_back(*it);
-      }
-   }
+   historyArchive().search(searchTerms,
+                           static_cast<std::size_t>(std::max(maxEntries, 0)),
+                           &matchingEntries);
 
    // return json
    json::Object entriesJson;
@@ -362,30 +331,13 @@ Error searchHistoryArchiveByPrefix(const json::JsonRpcRequest& request,
    // trim the prefix
    boost::algorithm::trim(prefix);
    
-   // examine the items in the history for matches
-   const std::vector<HistoryEntry>& allEntries = historyArchive().entries();
-   std::set<std::string> matchedCommands;
+   // find matching items in the history
    std::vector<HistoryEntry> matchingEntries;
-   for (std::vector<HistoryEntry>::const_reverse_iterator 
-        it = allEntries.rbegin();
-        it != allEntries.rend();
-        ++it)
-   {
-      // check limit
-      if (matchingEntries.size() >= static_cast<std::size_t>(maxEntries))
-         break;
-      
-      // look for match 
-      if (boost::algorithm::starts_with(it->command, prefix))
-      {
-         if (!uniqueOnly || (matchedCommands.count(it->command) == 0))
-         {
-            matchingEntries.push_back(*it);
-            matchedCommands.insert(it->command);
-         }
-      }
-   }
-   
+   historyArchive().searchByPrefix(prefix,
+                                   static_cast<std::size_t>(std::max(maxEntries, 0)),
+                                   uniqueOnly,
+                                   &matchingEntries);
+
    // return json
    json::Object entriesJson;
    historyEntriesAsJson(matchingEntries, &entriesJson);
@@ -15,8 +15,14 @@
 
 #include "SessionHistoryArchive.hpp"
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
 #include <string>
 
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
 #include <shared_core/Error.hpp>
 #include <core/Log.hpp>
 #include <shared_core/FilePath.hpp>
@@ -50,7 +56,7 @@ FilePath historyDatabaseRotatedFilePath()
    return module_context::userScratchPath().completePath(kHistoryDatabase ".1");
 }
 
-void rotateHistoryDatabase()
+bool rotateHistoryDatabase()
 {
    FilePath historyDB = historyDatabaseFilePath();
    if (historyDB.exists() && (historyDB.getSize() > kHistoryMaxBytes))
@@ -62,7 +68,10 @@ void rotateHistoryDatabase()
 
       // now rotate the file
       historyDB.move(rotatedHistoryDB);
+      return true;
    }
+
+   return false;
 }
 
 void writeEntry(double timestamp, const std::string& command, std::ostream* pOS)
@@ -119,6 +128,27 @@ ReadCollectionAction readHistoryEntry(const std::string& line,
    }
 }
 
+uint32_t trigramAt(const std::string& text, std::size_t pos)
+{
+   return (static_cast<uint32_t>(static_cast<unsigned char>(text[pos])) << 16) |
+          (static_cast<uint32_t>(static_cast<unsigned char>(text[pos + 1])) << 8) |
+           static_cast<uint32_t>(static_cast<unsigned char>(text[pos + 2]));
+}
+
+bool matches(const HistoryEntry& entry,
+             const std::vector<std::string>& searchTerms)
+{
+   // look for each search term in the input
+   for (const std::string& term : searchTerms)
+   {
+      if (!boost::algorithm::contains(entry.command, term))
+         return false;
+   }
+
+   // had all of the search terms, return true
+   return true;
+}
+
 } // anonymous namespace
 
 HistoryArchive& historyArchive()
@@ -129,23 +159,141 @@ HistoryArchive& historyArchive()
 
 Error HistoryArchive::add(const std::string& command)
 {
-   // reset the cache (since this write will invalidate the current one,
-   // no sense in keeping our cache around in memory)
-   entries_.clear();
-   entryCacheLastWriteTime_ = -1;
-
-   // rotate if necessary
-   rotateHistoryDatabase();
+   // rotate if necessary (rotation drops the oldest entries and so
+   // renumbers the rest, which requires our cache to be rebuilt)
+   if (rotateHistoryDatabase())
+      clear();
 
-   // write the entry to the file
+   // format the entry
    std::ostringstream ostrEntry;
    double currentTime = core::date_time::millisecondsSinceEpoch();
    writeEntry(currentTime, command, &ostrEntry);
    ostrEntry << std::endl;
-   return appendToFile(historyDatabaseFilePath(), ostrEntry.str());
+   std::string line = ostrEntry.str();
+
+   // note whether our cache is up to date with the file before writing,
+   // so we know whether the write can simply be appended to it
+   FilePath historyDBPath = historyDatabaseFilePath();
+   bool cacheCurrent =
+         loaded_ &&
+         (historyDBPath.exists() ? historyDBPath.getSize() : 0) == mainOffset_;
+
+   // write the entry to the file
+   Error error = appendToFile(historyDBPath, line);
+   if (error)
+      return error;
+
+   // append the entry to the cache rather than invalidating it; if another
+   // session wrote to the database in the meantime then the entry will be
+   // picked up along with theirs the next time the cache is updated
+   if (cacheCurrent && historyDBPath.getSize() == mainOffset_ + line.size())
+   {
+      HistoryEntry entry;
+      int nextIndex = static_cast<int>(entries_.size());
+      if (readHistoryEntry(boost::algorithm::trim_copy(line), &entry, &nextIndex) ==
+          ReadCollectionAddLine)
+      {
+         addEntry(entry);
+      }
+      mainOffset_ += line.size();
+   }
+
+   return Success();
 }
 
 const std::vector<HistoryEntry>& HistoryArchive::entries() const
+{
+   update();
+   return entries_;
+}
+
+void HistoryArchive::search(const std::vector<std::string>& searchTerms,
+                            std::size_t maxEntries,
+                            std::vector<HistoryEntry>* pEntries) const
+{
+   update();
+   pEntries->clear();
+   if (maxEntries == 0)
+      return;
+
+   // only entries containing every trigram of every search term can match,
+   // so it suffices to check the entries containing the rarest of them
+   // (terms shorter than a trigram have to be checked against every entry)
+   const std::vector<int>* pCandidates = nullptr;
+   for (const std::string& term : searchTerms)
+   {
+      for (std::size_t i = 0; i + 3 <= term.size(); i++)
+      {
+         auto it = trigramIndex_.find(trigramAt(term, i));
+         if (it == trigramIndex_.end())
+            return;
+
+         if (pCandidates == nullptr || it->second.size() < pCandidates->size())
+            pCandidates = &(it->second);
+      }
+   }
+
+   if (pCandidates != nullptr)
+   {
+      for (auto it = pCandidates->rbegin(); it != pCandidates->rend(); ++it)
+      {
+         const HistoryEntry& entry = entries_[*it];
+         if (matches(entry, searchTerms))
+         {
+            pEntries->push_back(entry);
+            if (pEntries->size() >= maxEntries)
+               break;
+         }
+      }
+   }
+   else
+   {
+      for (auto it = entries_.rbegin(); it != entries_.rend(); ++it)
+      {
+         if (matches(*it, searchTerms))
+         {
+            pEntries->push_back(*it);
+            if (pEntries->size() >= maxEntries)
+               break;
+         }
+      }
+   }
+}
+
+void HistoryArchive::searchByPrefix(const std::string& prefix,
+                                    std::size_t maxEntries,
+                                    bool uniqueOnly,
+                                    std::vector<HistoryEntry>* pEntries) const
+{
+   update();
+   pEntries->clear();
+   if (maxEntries == 0)
+      return;
+
+   // commands sharing the prefix are adjacent in the command index; collect
+   // their entries (or just the most recent entry of each when unique)
+   std::vector<int> matched;
+   for (auto it = commandIndex_.lower_bound(prefix);
+        it != commandIndex_.end() && boost::algorithm::starts_with(it->first, prefix);
+        ++it)
+   {
+      if (uniqueOnly)
+         matched.push_back(it->second.back());
+      else
+         matched.insert(matched.end(), it->second.begin(), it->second.end());
+   }
+
+   // return the most recent of them
+   std::size_t count = std::min(maxEntries, matched.size());
+   std::partial_sort(matched.begin(),
+                     matched.begin() + count,
+                     matched.end(),
+                     std::greater<int>());
+   for (std::size_t i = 0; i < count; i++)
+      pEntries->push_back(entries_[matched[i]]);
+}
+
+void HistoryArchive::update() const
 {
    // calculate path to history db
    FilePath historyDBPath = historyDatabaseFilePath();
@@ -153,54 +301,149 @@ const std::vector<HistoryEntry>& HistoryArchive::entries() const
    // if the file doesn't exist then clear the collection
    if (!historyDBPath.exists())
    {
-      entries_.clear();
+      clear();
+      return;
    }
 
-   // otherwise check for divergent lastWriteTime and read the file
-   // if our internal list isn't up to date
-   else if (historyDBPath.getLastWriteTime() != entryCacheLastWriteTime_)
+   // the database was rotated (by us or another session) if the rotated
+   // file has changed or the main file is smaller than what we've read
+   FilePath rotatedHistoryDBPath = historyDatabaseRotatedFilePath();
+   bool rotatedExists = rotatedHistoryDBPath.exists();
+   time_t rotatedLastWriteTime = rotatedExists ? rotatedHistoryDBPath.getLastWriteTime() : -1;
+   uintmax_t rotatedSize = rotatedExists ? rotatedHistoryDBPath.getSize() : 0;
+   uintmax_t mainSize = historyDBPath.getSize();
+
+   if (!loaded_ ||
+       rotatedLastWriteTime != rotatedLastWriteTime_ ||
+       rotatedSize != rotatedSize_ ||
+       mainSize < mainOffset_)
    {
-      entries_.clear();
-
-      // establish a next index counter
-      int nextIndex = 0;
+      reload();
+      rotatedLastWriteTime_ = rotatedLastWriteTime;
+      rotatedSize_ = rotatedSize;
+   }
 
-      // first read from rotated file if it exists
-      FilePath rotatedHistoryDBPath = historyDatabaseRotatedFilePath();
-      if (rotatedHistoryDBPath.exists())
-      {
-         Error error = readCollectionFromFile<std::vector<HistoryEntry> >(
-                           rotatedHistoryDBPath,
-                           &entries_,
-                           boost::bind(readHistoryEntry, _1, _2, &nextIndex));
-         if (error)
-            LOG_ERROR(error);
-      }
+   // otherwise just read whatever has been appended since we last looked
+   else if (mainSize > mainOffset_)
+   {
+      Error error = readMainDatabaseTail();
+      if (error)
+         LOG_ERROR(error);
+   }
+}
 
+void HistoryArchive::reload() const
+{
+   clear();
 
-      // now read from main history db
+   // first read from rotated file if it exists
+   FilePath rotatedHistoryDBPath = historyDatabaseRotatedFilePath();
+   if (rotatedHistoryDBPath.exists())
+   {
+      int nextIndex = 0;
       std::vector<HistoryEntry> entries;
       Error error = readCollectionFromFile<std::vector<HistoryEntry> >(
-                           historyDBPath,
-                           &entries,
-                           boost::bind(readHistoryEntry, _1, _2, &nextIndex));
+                        rotatedHistoryDBPath,
+                        &entries,
+                        boost::bind(readHistoryEntry, _1, _2, &nextIndex));
       if (error)
-      {
          LOG_ERROR(error);
-      }
-      else
-      {
-         std::copy(entries.begin(),
-                   entries.end(),
-                   std::back_inserter(entries_));
 
-         entryCacheLastWriteTime_ = historyDBPath.getLastWriteTime();
+      for (HistoryEntry& entry : entries)
+      {
+         entry.index = static_cast<int>(entries_.size());
+         addEntry(entry);
       }
+   }
+
+   // now read from main history db
+   Error error = readMainDatabaseTail();
+   if (error)
+      LOG_ERROR(error);
+   else
+      loaded_ = true;
+}
 
+Error HistoryArchive::readMainDatabaseTail() const
+{
+   std::shared_ptr<std::istream> pIfs;
+   Error error = historyDatabaseFilePath().openForRead(pIfs);
+   if (error)
+      return error;
+
+   std::string contents;
+   try
+   {
+      pIfs->seekg(static_cast<std::streamoff>(mainOffset_));
+      contents.assign(std::istreambuf_iterator<char>(*pIfs),
+                      std::istreambuf_iterator<char>());
+      if (pIfs->bad())
+         return systemError(boost::system::errc::io_error, ERROR_LOCATION);
+   }
+   catch (const std::exception& e)
+   {
+      Error readError = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      readError.addProperty("what", e.what());
+      return readError;
    }
 
-   // return entries
-   return entries_;
+   // only consume complete lines (a partial line will be read once the
+   // session writing it has finished) except when reading the whole file,
+   // in which case there may be a final line without a trailing newline
+   std::size_t end = contents.rfind('\n');
+   if (mainOffset_ == 0)
+      end = contents.size();
+   else if (end == std::string::npos)
+      return Success();
+   else
+      end++;
+
+   std::size_t pos = 0;
+   while (pos < end)
+   {
+      std::size_t eol = std::min(contents.find('\n', pos), end);
+      std::string line = contents.substr(pos, eol - pos);
+      pos = eol + 1;
+
+      boost::algorithm::trim(line);
+      if (line.empty())
+         continue;
+
+      HistoryEntry entry;
+      int nextIndex = static_cast<int>(entries_.size());
+      if (readHistoryEntry(line, &entry, &nextIndex) == ReadCollectionAddLine)
+         addEntry(entry);
+   }
+
+   mainOffset_ += end;
+   return Success();
+}
+
+void HistoryArchive::addEntry(const HistoryEntry& entry) const
+{
+   int index = static_cast<int>(entries_.size());
+   entries_.push_back(entry);
+
+   const std::string& command = entry.command;
+   for (std::size_t i = 0; i + 3 <= command.size(); i++)
+   {
+      std::vector<int>& postings = trigramIndex_[trigramAt(command, i)];
+      if (postings.empty() || postings.back() != index)
+         postings.push_back(index);
+   }
+
+   commandIndex_[command].push_back(index);
+}
+
+void HistoryArchive::clear() const
+{
+   entries_.clear();
+   trigramIndex_.clear();
+   commandIndex_.clear();
+   mainOffset_ = 0;
+   rotatedLastWriteTime_ = -1;
+   rotatedSize_ = 0;
+   loaded_ = false;
 }
 
 void HistoryArchive::migrateRhistoryIfNecessary()
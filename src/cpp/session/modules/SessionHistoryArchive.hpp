@@ -16,7 +16,10 @@
 #ifndef SESSION_HISTORY_ARCHIVE_HPP
 #define SESSION_HISTORY_ARCHIVE_HPP
 
+#include <cstdint>
+#include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/utility.hpp>
@@ -51,7 +54,10 @@ HistoryArchive& historyArchive();
 class HistoryArchive : boost::noncopyable
 {
 private:
-   HistoryArchive() : entryCacheLastWriteTime_(-1) {}
+   HistoryArchive()
+      : rotatedLastWriteTime_(-1), rotatedSize_(0), mainOffset_(0), loaded_(false)
+   {
+   }
    friend HistoryArchive& historyArchive();
 
 public:
@@ -61,9 +67,43 @@ public:
    core::Error add(const std::string& command);
    const std::vector<HistoryEntry>& entries() const;
 
+   // Find the most recent entries containing all of the given search terms
+   // (most recent first)
+   void search(const std::vector<std::string>& searchTerms,
+               std::size_t maxEntries,
+               std::vector<HistoryEntry>* pEntries) const;
+
+   // Find the most recent entries starting with the given prefix (most
+   // recent first), optionally only including the most recent entry for
+   // each distinct command
+   void searchByPrefix(const std::string& prefix,
+                       std::size_t maxEntries,
+                       bool uniqueOnly,
+                       std::vector<HistoryEntry>* pEntries) const;
+
 private:
-   mutable time_t entryCacheLastWriteTime_;
+   void update() const;
+   void reload() const;
+   core::Error readMainDatabaseTail() const;
+   void addEntry(const HistoryEntry& entry) const;
+   void clear() const;
+
+   // the entries are read incrementally: we remember how much of the main
+   // database we've consumed and only read what has been appended since
+   // (by this or another session); rotation of the database (detected via
+   // the rotated file changing or the main file shrinking) forces a reload
+   mutable time_t rotatedLastWriteTime_;
+   mutable uintmax_t rotatedSize_;
+   mutable uintmax_t mainOffset_;
+   mutable bool loaded_;
    mutable std::vector<HistoryEntry> entries_;
+
+   // trigram => indexes of the entries containing it (ascending)
+   mutable std::unordered_map<uint32_t, std::vector<int> > trigramIndex_;
+
+   // command => indexes of the entries with that command (ascending); being
+   // sorted, prefix queries are a range scan
+   mutable std::map<std::string, std::vector<int> > commandIndex_;
 };
                        
 } // namespace history
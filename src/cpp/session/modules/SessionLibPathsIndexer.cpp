@@ -21,6 +21,7 @@
 #include <shared_core/Error.hpp>
 #include <shared_core/FilePath.hpp>
 
+#include <session/SessionModuleContext.hpp>
 #include <session/SessionPackageProvidedExtension.hpp>
 
 using namespace rstudio::core;
@@ -69,6 +70,24 @@ const std::vector<FilePath>& getInstalledPackages()
    return s_installedPackages_;
 }
 
+FilePath findInstalledPackage(const std::string& pkgName)
+{
+   // prefer the packages discovered by the indexer
+   for (const FilePath& pkgPath : s_installedPackages_)
+      if (pkgPath.getFilename() == pkgName)
+         return pkgPath;
+   
+   // the indexer may not have run yet; probe the library paths directly
+   for (const FilePath& libPath : module_context::getLibPaths())
+   {
+      FilePath pkgPath = libPath.completeChildPath(pkgName);
+      if (pkgPath.completeChildPath("DESCRIPTION").exists())
+         return pkgPath;
+   }
+   
+   return FilePath();
+}
+
 Error initialize()
 {
    ppe::indexer().addWorker(worker());
@@ -16,6 +16,7 @@
 #ifndef SESSION_MODULES_LIB_PATHS_INDEXER_HPP
 #define SESSION_MODULES_LIB_PATHS_INDEXER_HPP
 
+#include <string>
 #include <vector>
 #include <map>
 
@@ -34,6 +35,10 @@ namespace modules {
 namespace libpaths {
 
 const std::vector<core::FilePath>& getInstalledPackages();
+
+// find the installed copy of a package (the first one found on the library
+// paths); returns an empty path if the package isn't installed
+core::FilePath findInstalledPackage(const std::string& pkgName);
 core::Error initialize();
 
 } // end namespace libpaths
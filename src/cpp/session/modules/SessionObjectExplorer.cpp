@@ -55,8 +55,8 @@ void removeOrphanedCacheItems()
       return;
    
    // list source documents
-   std::vector<FilePath> docPaths;
-   error = source_database::list(&docPaths);
+   std::vector<std::string> docIds;
+   error = source_database::list(&docIds);
    if (error)
    {
       LOG_ERROR(error);
@@ -68,10 +68,10 @@ void removeOrphanedCacheItems()
    typedef boost::shared_ptr<SourceDocument> Document;
    
    std::vector<Document> documents;
-   for (const FilePath& docPath : docPaths)
+   for (const std::string& docId : docIds)
    {
       Document pDoc(new SourceDocument());
-      Error error = source_database::get(docPath.getFilename(), false, pDoc);
+      Error error = source_database::get(docId, false, pDoc);
       if (error)
       {
          LOG_ERROR(error);
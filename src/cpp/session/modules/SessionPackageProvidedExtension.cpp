@@ -16,16 +16,25 @@
 #include <session/SessionPackageProvidedExtension.hpp>
 
 #include <boost/regex.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/bind/bind.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <shared_core/Hash.hpp>
+#include <shared_core/SafeConvert.hpp>
+
 #include <core/Algorithm.hpp>
 #include <core/Exec.hpp>
+#include <core/FileLock.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/system/System.hpp>
 #include <core/text/DcfParser.hpp>
 
 #include <session/SessionModuleContext.hpp>
+#include <session/SessionOptions.hpp>
 
 using namespace rstudio::core;
+using namespace boost::placeholders;
 
 namespace rstudio {
 namespace session {
@@ -71,6 +80,67 @@ Error parseDcfResourceFile(
    return Success();
 }
 
+namespace {
+
+// Package index cache ----
+//
+// Each library path gets an index file recording, for every package in the
+// library, which extension resources (files under 'rstudio/' and R Markdown
+// templates) it provides. The index is keyed by the library path and its
+// modification time -- which changes whenever a package is installed or
+// removed -- so an index file is never modified once written. The cache
+// directory can be shared between sessions (and users, via the
+// 'r-package-index-cache-path' option), so only the first session to see a
+// given state of a library pays for probing each package.
+
+const char * const kRStudioResourcesPath = "rstudio";
+const char * const kRMarkdownTemplatesPath = "rmarkdown/templates";
+
+bool isIndexedResource(const std::string& resourcePath)
+{
+   return resourcePath == kRMarkdownTemplatesPath ||
+          resourcePath == kRStudioResourcesPath ||
+          boost::algorithm::starts_with(resourcePath, std::string(kRStudioResourcesPath) + "/");
+}
+
+FilePath packageIndexCachePath()
+{
+   std::string cachePath = session::options().rPackageIndexCachePath();
+   if (!cachePath.empty())
+      return FilePath(cachePath);
+   
+   return module_context::userScratchPath().completeChildPath("package-index");
+}
+
+FilePath libraryIndexPath(const FilePath& libPath)
+{
+   std::string key = core::hash::crc32HexHash(
+            libPath.getAbsolutePath() + ":" +
+            safe_convert::numberToString(libPath.getLastWriteTime()));
+   
+   return packageIndexCachePath().completeChildPath(key + ".json");
+}
+
+bool addResource(const FilePath& pkgPath,
+                 const FilePath& resourcePath,
+                 std::set<std::string>* pResources)
+{
+   pResources->insert(resourcePath.getRelativePath(pkgPath));
+   return true;
+}
+
+} // end anonymous namespace
+
+bool packageResourceExists(const FilePath& pkgPath,
+                           const std::string& resourcePath)
+{
+   bool exists = false;
+   if (indexer().resourceExists(pkgPath, resourcePath, &exists))
+      return exists;
+   
+   return pkgPath.completeChildPath(resourcePath).exists();
+}
+
 Indexer::Indexer() : index_(0), n_(0), running_(false) {}
 
 void Indexer::addWorker(boost::shared_ptr<Worker> pWorker)
@@ -108,15 +178,20 @@ bool Indexer::work()
 
    std::size_t index = index_++;
 
-   // invoke workers with package name + path
+   // probe packages that aren't in the package index cache
    FilePath pkgPath = pkgDirs_[index];
+   if (unindexedLibPaths_.count(pkgPath.getParent().getAbsolutePath()))
+      indexPackageResources(pkgPath);
+   
+   // invoke workers with package name + path
    std::string pkgName = pkgPath.getFilename();
    for (boost::shared_ptr<Worker> pWorker : workers_)
    {
-      FilePath resourcePath = pkgPath.completeChildPath(pWorker->resourcePath());
-      if (!resourcePath.exists())
+      const std::string& resource = pWorker->resourcePath();
+      if (!resource.empty() && !packageResourceExists(pkgPath, resource))
          continue;
       
+      FilePath resourcePath = pkgPath.completeChildPath(resource);
       try
       {
          pWorker->onWork(pkgName, resourcePath);
@@ -130,6 +205,8 @@ void Indexer::beginIndexing()
 {
    // reset indexer state
    pkgDirs_.clear();
+   pkgResources_.clear();
+   unindexedLibPaths_.clear();
    index_ = 0;
 
    // discover packages available on the current library paths
@@ -148,6 +225,8 @@ void Indexer::beginIndexing()
                pkgDirs_.end(),
                pkgPaths.begin(),
                pkgPaths.end());
+      
+      readLibraryIndex(libPath);
    }
    n_ = pkgDirs_.size();
    
@@ -180,6 +259,143 @@ void Indexer::endIndexing()
             payload_);
    
    module_context::enqueClientEvent(event);
+   
+   // publish indexes for libraries we had to probe
+   for (const std::string& libPath : unindexedLibPaths_)
+      writeLibraryIndex(FilePath(libPath));
+   
+   pkgResources_.clear();
+   unindexedLibPaths_.clear();
+}
+
+bool Indexer::resourceExists(const FilePath& pkgPath,
+                             const std::string& resourcePath,
+                             bool* pExists)
+{
+   if (!running_ || resourcePath.empty() || !isIndexedResource(resourcePath))
+      return false;
+   
+   std::map<std::string, std::set<std::string> >::const_iterator it =
+         pkgResources_.find(pkgPath.getAbsolutePath());
+   
+   if (it == pkgResources_.end())
+      return false;
+   
+   *pExists = it->second.count(resourcePath) > 0;
+   return true;
+}
+
+void Indexer::readLibraryIndex(const FilePath& libPath)
+{
+   FilePath indexPath = libraryIndexPath(libPath);
+   if (!indexPath.exists())
+   {
+      unindexedLibPaths_.insert(libPath.getAbsolutePath());
+      return;
+   }
+   
+   std::string contents;
+   Error error = core::readStringFromFile(indexPath, &contents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      unindexedLibPaths_.insert(libPath.getAbsolutePath());
+      return;
+   }
+   
+   json::Value indexJson;
+   error = indexJson.parse(contents);
+   if (error || !indexJson.isObject())
+   {
+      if (error)
+         LOG_ERROR(error);
+      unindexedLibPaths_.insert(libPath.getAbsolutePath());
+      return;
+   }
+   
+   for (const json::Object::Member& member : indexJson.getObject())
+   {
+      if (!member.getValue().isArray())
+         continue;
+      
+      std::set<std::string>& resources =
+            pkgResources_[libPath.completeChildPath(member.getName()).getAbsolutePath()];
+      
+      for (const json::Value& resourceJson : member.getValue().getArray())
+         if (resourceJson.isString())
+            resources.insert(resourceJson.getString());
+   }
+}
+
+void Indexer::indexPackageResources(const FilePath& pkgPath)
+{
+   std::set<std::string>& resources = pkgResources_[pkgPath.getAbsolutePath()];
+   
+   FilePath rstudioPath = pkgPath.completeChildPath(kRStudioResourcesPath);
+   if (rstudioPath.isDirectory())
+   {
+      resources.insert(kRStudioResourcesPath);
+      Error error = rstudioPath.getChildrenRecursive(
+               boost::bind(addResource, boost::cref(pkgPath), _2, &resources));
+      if (error)
+         LOG_ERROR(error);
+   }
+   
+   if (pkgPath.completeChildPath(kRMarkdownTemplatesPath).isDirectory())
+      resources.insert(kRMarkdownTemplatesPath);
+}
+
+void Indexer::writeLibraryIndex(const FilePath& libPath)
+{
+   json::Object indexJson;
+   for (const FilePath& pkgPath : pkgDirs_)
+   {
+      if (pkgPath.getParent() != libPath)
+         continue;
+      
+      json::Array resourcesJson;
+      for (const std::string& resource : pkgResources_[pkgPath.getAbsolutePath()])
+         resourcesJson.push_back(resource);
+      
+      indexJson[pkgPath.getFilename()] = resourcesJson;
+   }
+   
+   FilePath indexPath = libraryIndexPath(libPath);
+   Error error = indexPath.getParent().ensureDirectory();
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+   
+   // only one session populates a given index; if another session holds
+   // the lock, it will publish the same index so we can skip writing ours
+   boost::shared_ptr<FileLock> pLock = FileLock::createDefault();
+   FilePath lockPath = indexPath.getParent().completeChildPath(indexPath.getStem() + ".lock");
+   if (pLock->acquire(lockPath))
+      return;
+   
+   if (!indexPath.exists())
+   {
+      // write to a temporary file and then move into place, so that
+      // readers never observe a partially written index
+      FilePath tempPath = indexPath.getParent().completeChildPath(
+               indexPath.getStem() + "-" + core::system::generateShortenedUuid());
+      
+      error = core::writeStringToFile(tempPath, indexJson.write());
+      if (!error)
+         error = tempPath.move(indexPath, FilePath::MoveDirect, true);
+      
+      if (error)
+      {
+         LOG_ERROR(error);
+         tempPath.removeIfExists();
+      }
+   }
+   
+   error = pLock->release();
+   if (error)
+      LOG_ERROR(error);
 }
 
 Indexer& indexer()
@@ -359,9 +359,8 @@ class AddinWorker : public ppe::Worker
    void onWork(const std::string& pkgName, const FilePath& pkgPath)
    {
       // first, check for bundled addins
-      FilePath bundledAddinsPath = pkgPath.completeChildPath("rstudio/addins.dcf");
-      if (bundledAddinsPath.exists())
-         pRegistry_->add(pkgName, bundledAddinsPath);
+      if (ppe::packageResourceExists(pkgPath, "rstudio/addins.dcf"))
+         pRegistry_->add(pkgName, pkgPath.completeChildPath("rstudio/addins.dcf"));
       
       // next, check for addins in R_user_dir() folder
       if (!userConfigPath_.isEmpty())
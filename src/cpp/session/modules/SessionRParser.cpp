@@ -1483,6 +1483,13 @@ ParseResults parse(const FilePath& filePath,
       return ParseResults();
    
    RTokens rTokens(rCode, RTokens::StripComments);
+   return parse(filePath, rTokens, parseOptions);
+}
+
+ParseResults parse(const FilePath& filePath,
+                   const RTokens& rTokens,
+                   const ParseOptions& parseOptions)
+{
    if (rTokens.empty())
       return ParseResults();
    
@@ -1481,6 +1481,12 @@ ParseResults parse(const core::FilePath& filePath,
                    const std::wstring& rCode,
                    const ParseOptions& parseOptions = ParseOptions());
 
+// Parse pre-tokenized code; the tokens must have been
+// produced with RTokens::StripComments
+ParseResults parse(const core::FilePath& filePath,
+                   const core::r_util::RTokens& rTokens,
+                   const ParseOptions& parseOptions = ParseOptions());
+
 // Useful aliases ----
 ParseResults parse(const core::FilePath& filePath,
                    const ParseOptions& parseOptions = ParseOptions());
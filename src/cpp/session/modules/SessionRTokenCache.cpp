@@ -0,0 +1,190 @@
+/*
+ * SessionRTokenCache.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionRTokenCache.hpp"
+
+#include <map>
+#include <vector>
+
+#include <shared_core/Error.hpp>
+#include <shared_core/Hash.hpp>
+#include <shared_core/SafeConvert.hpp>
+
+#include <core/collection/LruCache.hpp>
+
+#include <r/RSexp.hpp>
+#include <r/RRoutines.hpp>
+
+#include <session/SessionSourceDatabase.hpp>
+
+using namespace rstudio::core;
+using namespace rstudio::core::r_util;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace token_cache {
+
+namespace {
+
+// maximum number of documents whose tokens are held in the cache
+const unsigned int kMaxCacheEntries = 32;
+
+// maximum number of tokenizations held per document; consumers may tokenize
+// different code derived from the same document (e.g. just the R chunks of
+// an R Markdown document), and these shouldn't evict each other
+const std::size_t kMaxTokenizationsPerDocument = 2;
+
+// tokens stripped from those of a tokenization, which they refer into
+struct TokensView
+{
+   TokensView(boost::shared_ptr<RTokens> pSource, int flags)
+      : pSource(pSource), tokens(*pSource, flags)
+   {
+   }
+
+   boost::shared_ptr<RTokens> pSource;
+   RTokens tokens;
+};
+
+// code tokenized in full, with the views of its tokens (by tokenizer flags)
+// requested so far
+struct Tokenization
+{
+   std::string hash;
+   boost::shared_ptr<RTokens> pTokens;
+   std::map<int, boost::shared_ptr<RTokens> > views;
+};
+
+// the tokenizations of a document's code, most recently used first
+struct CacheEntry
+{
+   std::vector<Tokenization> tokenizations;
+};
+
+collection::LruCache<std::string, CacheEntry>& cache()
+{
+   static collection::LruCache<std::string, CacheEntry> instance(kMaxCacheEntries);
+   return instance;
+}
+
+// cache statistics
+std::size_t s_hits = 0;
+std::size_t s_misses = 0;
+
+std::string codeHash(const std::wstring& code)
+{
+   return hash::crc32HexHash(
+            std::string(reinterpret_cast<const char*>(code.data()),
+                        code.size() * sizeof(wchar_t)));
+}
+
+// the tokens of a tokenization with those stripped by the flags removed; all
+// consumers share the one tokenization, whichever flags they ask for
+boost::shared_ptr<RTokens> tokensView(Tokenization* pTokenization, int flags)
+{
+   if (flags == RTokens::None)
+      return pTokenization->pTokens;
+
+   boost::shared_ptr<RTokens>& pView = pTokenization->views[flags];
+   if (!pView)
+   {
+      boost::shared_ptr<TokensView> pTokensView(
+               new TokensView(pTokenization->pTokens, flags));
+      pView = boost::shared_ptr<RTokens>(pTokensView, &pTokensView->tokens);
+   }
+   return pView;
+}
+
+void onDocRemoved(const std::string& id, const std::string&)
+{
+   cache().remove(id);
+}
+
+void onRemoveAll()
+{
+   cache().clear();
+}
+
+SEXP rs_tokenCacheStatistics()
+{
+   r::sexp::Protect protect;
+   r::sexp::ListBuilder builder(&protect);
+   builder.add("hits", static_cast<int>(s_hits));
+   builder.add("misses", static_cast<int>(s_misses));
+   builder.add("size", static_cast<int>(cache().size()));
+   return r::sexp::create(builder, &protect);
+}
+
+} // anonymous namespace
+
+boost::shared_ptr<RTokens> tokens(const std::string& documentId,
+                                  const std::wstring& code,
+                                  int flags)
+{
+   // nothing to cache against; just tokenize
+   if (documentId.empty())
+      return boost::shared_ptr<RTokens>(new RTokens(code, flags));
+   
+   // tokenizations are replaced (rather than explicitly invalidated) when
+   // a document's contents change, since consumers may tokenize code
+   // derived from the document rather than its contents
+   std::string hash = codeHash(code);
+   CacheEntry entry;
+   cache().get(documentId, &entry);
+   
+   std::vector<Tokenization>& tokenizations = entry.tokenizations;
+   std::vector<Tokenization>::iterator it = tokenizations.begin();
+   while (it != tokenizations.end() && it->hash != hash)
+      ++it;
+   
+   Tokenization tokenization;
+   if (it != tokenizations.end())
+   {
+      ++s_hits;
+      tokenization = *it;
+      tokenizations.erase(it);
+   }
+   else
+   {
+      ++s_misses;
+      tokenization.hash = hash;
+      tokenization.pTokens.reset(new RTokens(code));
+   }
+   
+   boost::shared_ptr<RTokens> pTokens = tokensView(&tokenization, flags);
+   
+   tokenizations.insert(tokenizations.begin(), tokenization);
+   if (tokenizations.size() > kMaxTokenizationsPerDocument)
+      tokenizations.resize(kMaxTokenizationsPerDocument);
+   cache().insert(documentId, entry);
+   
+   return pTokens;
+}
+
+Error initialize()
+{
+   source_database::events().onDocRemoved.connect(onDocRemoved);
+   source_database::events().onRemoveAll.connect(onRemoveAll);
+   
+   RS_REGISTER_CALL_METHOD(rs_tokenCacheStatistics, 0);
+   
+   return Success();
+}
+
+} // namespace token_cache
+} // namespace modules
+} // namespace session
+} // namespace rstudio
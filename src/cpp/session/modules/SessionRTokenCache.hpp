@@ -0,0 +1,52 @@
+/*
+ * SessionRTokenCache.hpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_MODULES_R_TOKEN_CACHE_HPP
+#define SESSION_MODULES_R_TOKEN_CACHE_HPP
+
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+#include <core/r_util/RTokenizer.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace token_cache {
+
+// Returns the tokens for R code belonging to a source document. The code is
+// tokenized in full once and cached per document, for as long as it's
+// unchanged; tokens for other tokenizer flags are filtered from those, so
+// that features which tokenize the same document with different flags
+// (diagnostics, code search indexing) share the work.
+boost::shared_ptr<core::r_util::RTokens> tokens(const std::string& documentId,
+                                                const std::wstring& code,
+                                                int flags);
+
+core::Error initialize();
+
+} // namespace token_cache
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_MODULES_R_TOKEN_CACHE_HPP
@@ -31,6 +31,7 @@
 #include <core/Exec.hpp>
 #include <shared_core/Error.hpp>
 #include <shared_core/FilePath.hpp>
+#include <shared_core/Hash.hpp>
 #include <core/FileInfo.hpp>
 #include <core/FileSerializer.hpp>
 #include <core/StringUtils.hpp>
@@ -75,6 +76,10 @@ namespace {
 module_context::WaitForMethodFunction s_waitForRequestDocumentSave;
 module_context::WaitForMethodFunction s_waitForRequestDocumentClose;
 
+// chunked checksums of the documents saved by diff, so that the hash of an
+// edited document only requires re-hashing the chunks touched by the edit
+std::map<std::string, hash::ChunkedCrc32> s_contentsHashes;
+
 Error sourceDatabaseError(Error error)
 {
    if (isFileNotFoundError(error))
@@ -216,9 +221,9 @@ void detectExtendedType(boost::shared_ptr<SourceDocument> pDoc)
 
 int numSourceDocuments()
 {
-   std::vector<boost::shared_ptr<SourceDocument> > docs;
-   source_database::list(&docs);
-   return gsl::narrow_cast<int>(docs.size());
+   std::vector<std::string> ids;
+   source_database::list(&ids);
+   return gsl::narrow_cast<int>(ids.size());
 }
 
 // wrap source_database::put for situations where there are new contents
@@ -236,6 +241,20 @@ Error sourceDatabasePutWithUpdatedContents(boost::shared_ptr<SourceDocument> pDo
 
    return Success();
 }
+
+// as above, for new contents which are the result of edits
+Error sourceDatabasePutWithEdits(boost::shared_ptr<SourceDocument> pDoc,
+                                 const std::vector<ContentEdit>& edits)
+{
+   // journal the edits in the database
+   Error error = source_database::putEdits(pDoc, edits);
+   if (error)
+      return error;
+
+   source_database::events().onDocUpdated(pDoc);
+
+   return Success();
+}
    
 Error newDocument(const json::JsonRpcRequest& request,
                   json::JsonRpcResponse* pResponse)
@@ -383,6 +402,48 @@ Error openDocument(const json::JsonRpcRequest& request,
    return Success();
 } 
 
+// applies edits (each relative to the contents as of after the previous
+// one) to the contents of a document, yielding the edited contents and their
+// hash; edits are clamped to the contents they apply to
+Error applyContentEdits(boost::shared_ptr<SourceDocument> pDoc,
+                        std::vector<ContentEdit>* pEdits,
+                        std::string* pContents,
+                        std::string* pHash)
+{
+   *pContents = pDoc->contents();
+
+   // start over if the checksums aren't those of the current contents
+   hash::ChunkedCrc32& contentsHash = s_contentsHashes[pDoc->id()];
+   if (contentsHash.size() != pContents->length() ||
+       safe_convert::numberToString(contentsHash.checksum()) != pDoc->hash())
+   {
+      contentsHash.reset(*pContents);
+   }
+
+   for (ContentEdit& edit : *pEdits)
+   {
+      if (edit.offset > pContents->length())
+      {
+         s_contentsHashes.erase(pDoc->id());
+         Error error = systemError(boost::system::errc::invalid_argument,
+                                   "Edit is out of range",
+                                   ERROR_LOCATION);
+         error.addProperty("offset", safe_convert::numberToString(edit.offset));
+         return error;
+      }
+
+      // the offsets we receive are in bytes, so we can replace the contents
+      // of the string directly at the supplied offset + length (the contents
+      // string itself is already UTF-8 encoded)
+      edit.length = std::min(edit.length, pContents->length() - edit.offset);
+      pContents->replace(edit.offset, edit.length, edit.text);
+      contentsHash.replace(*pContents, edit.offset, edit.length, edit.text.length());
+   }
+
+   *pHash = safe_convert::numberToString(contentsHash.checksum());
+   return Success();
+}
+
 Error saveDocumentCore(const std::string& contents,
                        const json::Value& jsonPath,
                        const json::Value& jsonType,
@@ -390,7 +451,8 @@ Error saveDocumentCore(const std::string& contents,
                        const json::Value& jsonFoldSpec,
                        const json::Value& jsonChunkOutput,
                        boost::shared_ptr<SourceDocument> pDoc,
-                       bool retryWrite)
+                       bool retryWrite,
+                       const std::string& contentsHash = std::string())
 {
    // check whether we have a path and if we do get/resolve its value
    std::string oldPath, path;
@@ -508,7 +570,10 @@ Error saveDocumentCore(const std::string& contents,
    }
 
    // always update the contents so it holds the original UTF-8 data
-   pDoc->setContents(contents);
+   if (contentsHash.empty())
+      pDoc->setContents(contents);
+   else
+      pDoc->setContents(contents, contentsHash);
 
    return Success();
 }
@@ -556,11 +621,75 @@ Error saveDocument(const json::JsonRpcRequest& request,
    return Success();
 }
 
+// saves a document changed by edits made against the contents with the given
+// hash; if the document has changed since then, or the save fails, no hash is
+// returned and the client falls back to a save of the full contents
+Error saveDocumentWithEdits(const std::string& id,
+                            const json::Value& jsonPath,
+                            const json::Value& jsonType,
+                            const json::Value& jsonEncoding,
+                            const json::Value& jsonFoldSpec,
+                            const json::Value& jsonChunkOutput,
+                            std::vector<ContentEdit> edits,
+                            const std::string& hash,
+                            bool retryWrite,
+                            json::JsonRpcResponse* pResponse)
+{
+   // if this has no path then it is an autosave, in this case
+   // suppress change detection and write retries
+   bool hasPath = json::isType<std::string>(jsonPath);
+   if (!hasPath)
+      pResponse->setSuppressDetectChanges(true);
+
+   // get the doc
+   boost::shared_ptr<SourceDocument> pDoc(new SourceDocument());
+   Error error = source_database::get(id, pDoc);
+   if (error)
+      return sourceDatabaseError(error);
+   
+   // Don't even attempt anything if we're not working off the same original
+   if (pDoc->hash() != hash)
+      return Success();
+   
+   try
+   {
+      std::string contents, contentsHash;
+      error = applyContentEdits(pDoc, &edits, &contents, &contentsHash);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return Success();
+      }
+
+      // track if we're updating the document contents
+      bool hasChanges = contents != pDoc->contents();
+      error = saveDocumentCore(contents, jsonPath, jsonType, jsonEncoding,
+                               jsonFoldSpec, jsonChunkOutput, pDoc, retryWrite,
+                               contentsHash);
+      if (error)
+         return error;
+
+      // write to the source database (journaling the edits rather than
+      // rewriting the contents, and not writing contents at all if those
+      // have not changed)
+      if (hasChanges)
+         error = sourceDatabasePutWithEdits(pDoc, edits);
+      else
+         error = sourceDatabasePutWithUpdatedContents(pDoc, false, retryWrite);
+      if (error)
+         return error;
+
+      // set document hash
+      pResponse->setResult(pDoc->hash());
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+   
+   return Success();
+}
+
 Error saveDocumentDiff(const json::JsonRpcRequest& request,
                        json::JsonRpcResponse* pResponse)
 {
-   using namespace rstudio::core::string_utils;
-
    // unique id and jsonPath (can be null for auto-save)
    std::string id;
    json::Value jsonPath, jsonType, jsonEncoding, jsonFoldSpec, jsonChunkOutput;
@@ -598,62 +727,72 @@ Error saveDocumentDiff(const json::JsonRpcRequest& request,
                                   &retryWrite);
    if (error)
       return error;
-   
-   // if this has no path then it is an autosave, in this case
-   // suppress change detection and write retries
-   bool hasPath = json::isType<std::string>(jsonPath);
-   if (!hasPath)
-      pResponse->setSuppressDetectChanges(true);
 
-   // get the doc
-   boost::shared_ptr<SourceDocument> pDoc(new SourceDocument());
-   error = source_database::get(id, pDoc);
-   if (error)
-      return sourceDatabaseError(error);
-   
-   // Don't even attempt anything if we're not working off the same original
-   if (pDoc->hash() != hash)
-      return Success();
-   
-   // attempt the document save. note that if this fails,
-   // we won't set a response hash and RStudio will take this as a signal
-   // to attempt a 'full' document save rather than just a diff-based save
-   try
+   // NOTE: this flag denotes whether the front-end successfully
+   // constructed a diff to be saved; we leave this in while still
+   // going down this code path just to ensure that any code that
+   // runs in response to a document save (even if that save fails)
+   // still has a chance to run
+   std::vector<ContentEdit> edits;
+   if (valid)
    {
-      std::string contents(pDoc->contents());
-      
-      // NOTE: this flag denotes whether the front-end successfully
-      // constructed a diff to be saved; we leave this in while still
-      // going down this code path just to ensure that any code that
-      // runs in response to a document save (even if that save fails)
-      // still has a chance to run
-      if (valid)
-      {
-         // the offsets we receive are in bytes, so we can replace the contents
-         // of the string directly at the supplied offset + length (the contents
-         // string itself is already UTF-8 encoded)
-         contents.replace(offset, length, replacement);
-      }
+      if (offset < 0 || length < 0)
+         return Success();
+      edits.push_back(ContentEdit(offset, length, replacement));
+   }
 
-      // track if we're updating the document contents
-      bool hasChanges = contents != pDoc->contents();
-      error = saveDocumentCore(contents, jsonPath, jsonType, jsonEncoding,
-                               jsonFoldSpec, jsonChunkOutput, pDoc, retryWrite);
-      if (error)
-         return error;
+   return saveDocumentWithEdits(id, jsonPath, jsonType, jsonEncoding,
+                                jsonFoldSpec, jsonChunkOutput, edits, hash,
+                                retryWrite, pResponse);
+}
 
-      // write to the source database (don't worry about writing document
-      // contents if those have not changed)
-      error = sourceDatabasePutWithUpdatedContents(pDoc, hasChanges, retryWrite);
+Error saveDocumentEdits(const json::JsonRpcRequest& request,
+                        json::JsonRpcResponse* pResponse)
+{
+   // as for save_document_diff, but with a list of edits, each an object
+   // with an offset and length (in bytes) and the text replacing that range,
+   // applied in order
+   std::string id, hash;
+   json::Value jsonPath, jsonType, jsonEncoding, jsonFoldSpec, jsonChunkOutput;
+   json::Array jsonEdits;
+   bool retryWrite = false;
+   Error error = json::readParams(request.params,
+                                  &id,
+                                  &jsonPath,
+                                  &jsonType,
+                                  &jsonEncoding,
+                                  &jsonFoldSpec,
+                                  &jsonChunkOutput,
+                                  &jsonEdits,
+                                  &hash,
+                                  &retryWrite);
+   if (error)
+      return error;
+
+   std::vector<ContentEdit> edits;
+   for (const json::Value& jsonEdit : jsonEdits)
+   {
+      if (!json::isType<json::Object>(jsonEdit))
+         return Error(json::errc::ParamTypeMismatch, ERROR_LOCATION);
+
+      int offset = 0, length = 0;
+      std::string text;
+      error = json::readObject(jsonEdit.getObject(),
+                               "offset", offset,
+                               "length", length,
+                               "text", text);
       if (error)
          return error;
 
-      // set document hash
-      pResponse->setResult(pDoc->hash());
+      if (offset < 0 || length < 0)
+         return Error(json::errc::ParamInvalid, ERROR_LOCATION);
+
+      edits.push_back(ContentEdit(offset, length, text));
    }
-   CATCH_UNEXPECTED_EXCEPTION
-   
-   return Success();
+
+   return saveDocumentWithEdits(id, jsonPath, jsonType, jsonEncoding,
+                                jsonFoldSpec, jsonChunkOutput, edits, hash,
+                                retryWrite, pResponse);
 }
 
 Error checkForExternalEdit(const json::JsonRpcRequest& request,
@@ -889,6 +1028,7 @@ Error closeDocument(const json::JsonRpcRequest& request,
    if (error)
       return error;
 
+   s_contentsHashes.erase(id);
    source_database::events().onDocRemoved(id, path);
 
    return Success();
@@ -901,6 +1041,7 @@ Error closeAllDocuments(const json::JsonRpcRequest& request,
    if (error)
       return error;
 
+   s_contentsHashes.clear();
    source_database::events().onRemoveAll();
 
    return Success();
@@ -1183,7 +1324,7 @@ Error setDocOrder(const json::JsonRpcRequest& request,
    Error error = json::readParams(request.params, &ids);
    if (error)
       return error;
-   source_database::list(&docs);
+   source_database::list(&docs, false);
 
    for (boost::shared_ptr<SourceDocument>& pDoc : docs)
    {
@@ -1195,7 +1336,7 @@ Error setDocOrder(const json::JsonRpcRequest& request,
              pDoc->relativeOrder() != gsl::narrow_cast<int>(i + 1))
          {
             pDoc->setRelativeOrder(i + 1);
-            source_database::put(pDoc);
+            source_database::put(pDoc, false);
          }
       }
    }
@@ -1306,19 +1447,16 @@ void onSuspend(Settings*)
 {
 }
 
-// update the source database index on resume
-
-// TODO: a resume followed by a client_init will cause us to call
-// source_database::list twice (which will cause us to read all of
-// the files twice). find a way to prevent this.
-
+// update the source database index on resume (the docs are listed without
+// their contents, which listeners read only for the docs they index -- so a
+// resume followed by a client_init reads the contents just once)
 void onResume(const Settings&)
 {
    source_database::events().onRemoveAll();
 
    // get the docs and sort them by created
    std::vector<boost::shared_ptr<SourceDocument> > docs;
-   Error error = source_database::list(&docs);
+   Error error = source_database::list(&docs, false);
    if (error)
    {
       LOG_ERROR(error);
@@ -1513,6 +1651,7 @@ Error initialize()
       (bind(registerRpcMethod, "open_document", openDocument))
       (bind(registerRpcMethod, "save_document", saveDocument))
       (bind(registerRpcMethod, "save_document_diff", saveDocumentDiff))
+      (bind(registerRpcMethod, "save_document_edits", saveDocumentEdits))
       (bind(registerRpcMethod, "check_for_external_edit", checkForExternalEdit))
       (bind(registerRpcMethod, "ignore_external_edit", ignoreExternalEdit))
       (bind(registerRpcMethod, "set_source_document_on_save", setSourceDocumentOnSave))
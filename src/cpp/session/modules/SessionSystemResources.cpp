@@ -21,6 +21,10 @@
 #include <chrono>
 
 #include <core/Exec.hpp>
+#include <core/system/Process.hpp>
+#include <core/system/Resources.hpp>
+
+#include <monitor/MonitorClient.hpp>
 
 #include <r/RExec.hpp>
 #include <r/RSexp.hpp>
@@ -45,6 +49,58 @@ boost::mutex s_queryMutex;
 // The interval, in seconds, at which we will query for memory statistics
 std::atomic<int> s_queryInterval;
 
+bool isNotSupportedError(const Error& error)
+{
+   return error.getCode() == boost::system::errc::not_supported;
+}
+
+/**
+ * Gets the resource usage of the process trees rooted at each child of the
+ * session's process supervisor (terminals, jobs, builds, etc.)
+ */
+Error getChildResourceUsage(std::vector<core::system::ProcessTreeResourceUsage>* pUsage)
+{
+   std::vector<PidType> pids = module_context::processSupervisor().childPids();
+   if (pids.empty())
+      return Success();
+
+   return core::system::getProcessTreeResourceUsage(pids, pUsage);
+}
+
+/**
+ * Reports the aggregate resource usage of the session's children to the
+ * monitor, so that it can be attributed to the session.
+ */
+void sendChildResourceMetrics()
+{
+   std::vector<core::system::ProcessTreeResourceUsage> usage;
+   Error error = getChildResourceUsage(&usage);
+   if (error)
+   {
+      if (!isNotSupportedError(error))
+         LOG_ERROR(error);
+      return;
+   }
+
+   if (usage.empty())
+      return;
+
+   double processes = 0, cpuSeconds = 0, residentKb = 0;
+   for (const core::system::ProcessTreeResourceUsage& child : usage)
+   {
+      processes += child.processes;
+      cpuSeconds += child.cpuSeconds;
+      residentKb += static_cast<double>(child.residentKb);
+   }
+
+   using namespace monitor::metrics;
+   std::vector<Metric> metrics;
+   metrics.push_back(Metric("session", MetricData("children.processes", processes)));
+   metrics.push_back(Metric("session", MetricData("children.cpu_seconds", cpuSeconds)));
+   metrics.push_back(Metric("session", MetricData("children.resident_kb", residentKb)));
+   monitor::client().sendMetrics(metrics);
+}
+
 
 /**
  * Performs a previously scheduled query for available memory.
@@ -103,6 +159,7 @@ void performPeriodicWork(bool refreshStats)
    if (refreshStats)
    {
       scheduleMemoryChangedEvent();
+      sendChildResourceMetrics();
    }
 
    // Schedule the next re-query; we re-read the pref every time so it can be
@@ -184,9 +241,31 @@ Error getMemoryUsageReport(const json::JsonRpcRequest& , json::JsonRpcResponse*
       return error;
    }
    
+   // Get resource usage of child process trees; this isn't available on
+   // every platform, so failures are logged rather than failing the report
+   json::Array childrenJson;
+   std::vector<core::system::ProcessTreeResourceUsage> children;
+   error = getChildResourceUsage(&children);
+   if (error && !isNotSupportedError(error))
+      LOG_ERROR(error);
+
+   for (const core::system::ProcessTreeResourceUsage& child : children)
+   {
+      json::Object childJson;
+      childJson["pid"] = static_cast<int64_t>(child.pid);
+      childJson["name"] = child.name;
+      childJson["processes"] = child.processes;
+      childJson["cpu_seconds"] = child.cpuSeconds;
+      childJson["resident_kb"] = static_cast<int64_t>(child.residentKb);
+      childJson["read_bytes"] = static_cast<int64_t>(child.readBytes);
+      childJson["write_bytes"] = static_cast<int64_t>(child.writeBytes);
+      childrenJson.push_back(childJson);
+   }
+
    // Emit report to client
    report["system"] = pMemUsage->toJson();
    report["r"] = rMemUsageVal;
+   report["children"] = childrenJson;
    pResponse->setResult(report);
 
    return Success();
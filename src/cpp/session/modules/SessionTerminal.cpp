@@ -17,6 +17,14 @@
 #include "SessionWorkbench.hpp"
 
 #include <core/Exec.hpp>
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+#include <core/system/PosixSystem.hpp>
+#endif
+
+#include <r/RSexp.hpp>
+#include <r/RRoutines.hpp>
+
 #include <session/prefs/UserPrefs.hpp>
 #include <session/SessionModuleContext.hpp>
 #include <session/SessionConsoleProcess.hpp>
@@ -91,15 +99,33 @@ Error getTerminalOptions(const json::JsonRpcRequest& request,
 }
 
 
+// report the cost of terminal subprocess detection
+SEXP rs_terminalSubprocessStatistics()
+{
+   r::sexp::Protect protect;
+   r::sexp::ListBuilder builder(&protect);
+#if !defined(_WIN32) && !defined(__APPLE__)
+   core::system::SubprocScanStatistics stats = core::system::subprocessScanStatistics();
+   builder.add("scans", static_cast<double>(stats.scans));
+   builder.add("full_scans", static_cast<double>(stats.fullScans));
+   builder.add("files_read", static_cast<double>(stats.filesRead));
+   builder.add("elapsed_ms", static_cast<double>(stats.elapsedMicroseconds) / 1000.0);
+#endif
+   return r::sexp::create(builder, &protect);
+}
+
 } // anonymous namespace
 
 core::Error initialize()
 {
+   RS_REGISTER_CALL_METHOD(rs_terminalSubprocessStatistics, 0);
+
    using boost::bind;
    using namespace module_context;
    ExecBlock initBlock;
    initBlock.addFunctions()
-      (bind(registerRpcMethod, "get_terminal_options", getTerminalOptions));
+      (bind(registerRpcMethod, "get_terminal_options", getTerminalOptions))
+      (bind(sourceModuleRFile, "SessionTerminal.R"));
    return initBlock.execute();
 }
 
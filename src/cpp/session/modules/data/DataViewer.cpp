@@ -15,12 +15,14 @@
 
 #include "DataViewer.hpp"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <sstream>
 #include <gsl/gsl>
 
 #include <boost/format.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/bind/bind.hpp>
 
@@ -41,6 +43,10 @@
 #include <r/RFunctionHook.hpp>
 #include <r/RRoutines.hpp>
 
+#include "DataViewerColumnar.hpp"
+#include "DataViewerFormat.hpp"
+#include "DataViewerTransform.hpp"
+
 #include <session/SessionModuleContext.hpp>
 #include <session/SessionContentUrls.hpp>
 #include <session/SessionSourceDatabase.hpp>
@@ -52,16 +58,10 @@
 #define kGridResourceLocation "/" kGridResource "/"
 #define kNoBoundEnv "_rs_no_env"
 
-// separates filter type from contents (e.g. "numeric|12-25")
-#define kFilterSeparator "|"
-
 // the largest number of factor values we're willing to display (after this
 // point the column's text is searched as though it were a character column)
 #define MAX_FACTORS 64
 
-// special cell values
-#define SPECIAL_CELL_NA 0
-
 // default max value for columns to return unless client requests more
 #define MAX_COLUMNS 50
 
@@ -115,19 +115,21 @@ namespace {
  *    housewares between $10-$25, then only housewares between $10-25 and
  *    matching the text "eggs".
  *    
- *    In order to avoid re-ordering and re-filtering the entire dataset every
- *    time a new set of rows is requested, we keep a "working copy" of the
- *    object in a second environment, .rs.WorkingDataEnv, using the same cache
- *    keys.
+ *    Rather than copying the object, an ordered/filtered view is a "working
+ *    index" of the rows it shows (in display order), which we keep along with
+ *    the CachedFrame for the object. Pages of the view are read from the
+ *    object through the index, so a view costs a few bytes per row however
+ *    wide the object is.
  *    
- *    When a request for data arrives, we check to see if the data requested is
- *    a subset of the data already in our working copy. If it is, we use the
- *    working copy as a starting postion rather than the original or cached
- *    object.
+ *    In order to avoid re-ordering and re-filtering the entire dataset every
+ *    time a new set of rows is requested, when a request for data arrives, we
+ *    check to see if the data requested is a subset of the rows in our working
+ *    index. If it is, we use the working index as a starting postion rather
+ *    than all the rows of the object.
  *
  *    This allows us to efficiently perform operations on very large datasets
- *    once they've been winnowed down to smaller objects using searches and
- *    filters.
+ *    once they've been winnowed down to smaller sets of rows using searches
+ *    and filters.
  */    
 
 // indicates whether one filter string is a subset of another; e.g. if a column
@@ -233,6 +235,8 @@ struct CachedFrame
    CachedFrame(const std::string& env, const std::string& obj, SEXP sexp):
       envName(env),
       objName(obj),
+      ncol(0),
+      workingNRow(0),
       observedSEXP(sexp)
    {
       if (sexp == nullptr)
@@ -252,7 +256,7 @@ struct CachedFrame
       ncol = safeDim(sexp, DIM_COLS);
    };
 
-   CachedFrame() {};
+   CachedFrame() : ncol(0), workingNRow(0), observedSEXP(nullptr) {};
 
    // The location of the frame (if we know it)
    std::string envName;
@@ -289,6 +293,11 @@ struct CachedFrame
    std::vector<int> workingOrderCols;
    std::vector<std::string> workingOrderDirs;
 
+   // The rows shown with the current search, filters and order (if any), and
+   // the number of rows in the frame they index
+   boost::shared_ptr<RowIndex> pWorkingRows;
+   int workingNRow;
+
    // NB: There's no protection on this SEXP and it may be a stale pointer!
    // Used only to test for changes.
    SEXP observedSEXP;
@@ -465,9 +474,52 @@ json::Value getCols(SEXP dataSEXP)
    return result;
 }
 
+// reads the character vector produced by one of our R formatting functions
+void readFormattedStrings(SEXP stringsSEXP, FormattedColumn* pColumn)
+{
+   if (stringsSEXP == nullptr || TYPEOF(stringsSEXP) == NILSXP)
+      return;
+
+   for (int i = 0, n = r::sexp::length(stringsSEXP); i < n; i++)
+   {
+      // validate that we have a character vector
+      if (TYPEOF(stringsSEXP) != STRSXP)
+      {
+         pColumn->push("");
+         continue;
+      }
+
+      SEXP stringSEXP = STRING_ELT(stringsSEXP, i);
+      if (stringSEXP == nullptr)
+         pColumn->push("");
+      else if (stringSEXP == NA_STRING)
+         pColumn->pushNA();
+      else
+         pColumn->push(Rf_translateCharUTF8(stringSEXP));
+   }
+}
+
+// formats the given (1-based) rows of a column (which we can't format
+// natively) with .rs.formatDataColumnRows
+void formatColumnInR(SEXP columnSEXP,
+                     const std::vector<int>& rowNumbers,
+                     FormattedColumn* pColumn)
+{
+   r::sexp::Protect protect;
+   SEXP formattedColumnSEXP = R_NilValue;
+   r::exec::RFunction formatFx(".rs.formatDataColumnRows");
+   formatFx.addParam(columnSEXP);
+   formatFx.addParam(rowNumbers);
+   Error error = formatFx.call(&formattedColumnSEXP, &protect);
+   if (error)
+      throw r::exec::RErrorException(error.getSummary());
+
+   readFormattedStrings(formattedColumnSEXP, pColumn);
+}
+
 // given an object from which to return data, and a description of the data to
-// return via URL-encoded parameters supplied by the DataTables API, returns the
-// data requested by the parameters. 
+// return via URL-encoded parameters supplied by the DataTables API, formats the
+// page of data requested by the parameters. 
 //
 // the shape of the API is described here:
 // http://datatables.net/manual/server-side
@@ -475,9 +527,8 @@ json::Value getCols(SEXP dataSEXP)
 // NB: may throw exceptions! these are expected to be handled by the handlers
 // in getGridData, where they will be marshaled to JSON and displayed on the
 // client.
-json::Value getData(SEXP dataSEXP, const http::Fields& fields)
+void getData(SEXP dataSEXP, const http::Fields& fields, GridPage* pPage)
 {
-   Error error;
    r::sexp::Protect protect;
 
    // read draw parameters from DataTables
@@ -548,69 +599,80 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
    }
 
    bool needsTransform = ordercols.size() > 0 || hasFilter || !search.empty();
-   bool hasTransform = false;
+
+   // the rows of the ordered/filtered view, if any (otherwise all rows are
+   // shown in their original order)
+   boost::shared_ptr<RowIndex> pRows;
 
    // check to see if we have an ordered/filtered view we can build from
    auto cachedFrame = s_cachedFrames.find(cacheKey);
-   if (needsTransform)
+   boost::shared_ptr<RowIndex> pWorkingRows;
+   if (needsTransform && cachedFrame != s_cachedFrames.end())
    {
-      if (cachedFrame != s_cachedFrames.end())
+      // do we have a previously ordered/filtered view of the same rows?
+      CachedFrame& frame = cachedFrame->second;
+      if (frame.pWorkingRows && frame.workingNRow == nrow)
       {
-         // do we have a previously ordered/filtered view?
-         SEXP workingDataSEXP = R_NilValue;
-         r::exec::RFunction(".rs.findWorkingData", cacheKey)
-            .call(&workingDataSEXP, &protect);
-         
-         if (workingDataSEXP != R_NilValue)
+         if (frame.workingSearch == search &&
+             frame.workingFilters == filters && 
+             frame.workingOrderDirs == orderdirs &&
+             frame.workingOrderCols == ordercols)
          {
-            if (cachedFrame->second.workingSearch == search &&
-                cachedFrame->second.workingFilters == filters && 
-                cachedFrame->second.workingOrderDirs == orderdirs &&
-                cachedFrame->second.workingOrderCols == ordercols)
-            {
-               // we have one with exactly the same parameters as requested;
-               // use it exactly as is
-               dataSEXP = workingDataSEXP;
-               needsTransform = false;
-               hasTransform = true;
-            }
-            else if (cachedFrame->second.isSupersetOf(search, filters))
-            {
-               // we have one that is a strict superset of the parameters
-               // requested; transform the filtered set instead of starting
-               // from scratch
-               dataSEXP = workingDataSEXP;
-            }
+            // we have one with exactly the same parameters as requested;
+            // use it exactly as is
+            pRows = frame.pWorkingRows;
+         }
+         else if (frame.isSupersetOf(search, filters))
+         {
+            // we have one that is a strict superset of the parameters
+            // requested; transform the filtered rows instead of starting
+            // from scratch
+            pWorkingRows = frame.pWorkingRows;
          }
       }
    }
 
-   // apply transformations if needed.    
-   if (needsTransform) 
+   // apply transformations if needed
+   if (needsTransform && !pRows)
    {
-      // can we use a working copy? 
-      r::exec::RFunction transform(".rs.applyTransform");
-      transform.addParam("x", dataSEXP);       // data to transform
-      transform.addParam("filtered", filters); // which columns are filtered
-      transform.addParam("search", search);    // global search (across cols)
-      transform.addParam("cols", ordercols);     // which column to order on
-      transform.addParam("dirs", orderdirs);     // order direction ("asc"/"desc")
-      transform.call(&dataSEXP, &protect);
-      if (error)
-         throw r::exec::RErrorException(error.getSummary());
+      pRows = boost::make_shared<RowIndex>();
+      bool needsOrder = true;
+      if (pWorkingRows)
+      {
+         const CachedFrame& frame = cachedFrame->second;
+         *pRows = *pWorkingRows;
 
-      // check to see if we've accidentally transformed ourselves into nothing
-      // (this shouldn't generally happen without a specific error)
-      if (dataSEXP == R_NilValue)
+         // the rows already match the search and filters which haven't
+         // changed, so those needn't be applied again
+         std::vector<std::string> narrowingFilters = filters;
+         for (std::size_t i = 0; i < std::min(filters.size(), frame.workingFilters.size()); i++)
+         {
+            if (filters[i] == frame.workingFilters[i])
+               narrowingFilters[i].clear();
+         }
+         std::string narrowingSearch = search == frame.workingSearch ? std::string() : search;
+         filterRows(dataSEXP, narrowingFilters, narrowingSearch, pRows.get());
+
+         // filtering preserves order; if the rows are to be ordered
+         // differently, restore their original order first
+         needsOrder = frame.workingOrderCols != ordercols || frame.workingOrderDirs != orderdirs;
+         if (needsOrder)
+            std::sort(pRows->begin(), pRows->end());
+      }
+      else
       {
-         throw r::exec::RErrorException("Failure to sort or filter data");
+         allRows(nrow, pRows.get());
+         filterRows(dataSEXP, filters, search, pRows.get());
       }
 
-      // save the working data state (it's okay if this fails; it's a
-      // performance optimization)
-      r::exec::RFunction(".rs.assignWorkingData", cacheKey, dataSEXP).call();
+      if (needsOrder)
+         orderRows(dataSEXP, ordercols, orderdirs, pRows.get());
+
+      // save the working index
       if (cachedFrame != s_cachedFrames.end())
       {
+         cachedFrame->second.pWorkingRows = pRows;
+         cachedFrame->second.workingNRow = nrow;
          cachedFrame->second.workingSearch = search;
          cachedFrame->second.workingFilters = filters;
          cachedFrame->second.workingOrderDirs = orderdirs;
@@ -618,21 +680,35 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
       }
    }
 
-   // apply new row count if we've transformed the data (or need to)
-   filteredNRow = needsTransform || hasTransform
-      ? safeDim(dataSEXP, DIM_ROWS)
-      : nrow;
+   // apply new row count if we've transformed the data
+   filteredNRow = pRows ? static_cast<int>(pRows->size()) : nrow;
 
    // return the lesser of the rows available and rows requested
    length = std::min(length, filteredNRow - start);
 
+   // find the rows of the page, as .rs.formatDataColumn would (i.e. with one
+   // row beyond those requested, which may affect how columns are formatted)
+   std::vector<int> pageRows;
+   for (int i = std::max(start, 0); i < std::min(filteredNRow, start + length + 1); i++)
+      pageRows.push_back(pRows ? (*pRows)[i] : i);
+
    // DataTables uses 0-based indexing, but R uses 1-based indexing
    start++;
+   std::vector<int> pageRowNumbers;
+   for (int row : pageRows)
+      pageRowNumbers.push_back(row + 1);
+
+   pPage->draw = draw;
+   pPage->recordsTotal = nrow;
+   pPage->recordsFiltered = filteredNRow;
+   pPage->start = start;
+   pPage->length = length;
 
-   // extract the portion of the column vector requested by the client
+   // format the rows of each column requested by the client
    int numFormattedColumns = ncol - columnOffset < maxColumns ? ncol - columnOffset : maxColumns;
-   SEXP formattedDataSEXP = Rf_allocVector(VECSXP, numFormattedColumns);
-   protect.add(formattedDataSEXP);
+   std::vector<FormattedColumn>& columns = pPage->columns;
+   columns.resize(std::max(numFormattedColumns, 0));
+   FormatOptions options = formatOptions();
 
    int initialIndex = 0 + columnOffset;
    for (int i = initialIndex; i < initialIndex + numFormattedColumns; i++)
@@ -652,118 +728,39 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
          throw r::exec::RErrorException(
                   string_utils::sprintf("No data in column %i", i));
       }
-      
-      SEXP formattedColumnSEXP = R_NilValue;
-      r::exec::RFunction formatFx(".rs.formatDataColumn");
-      formatFx.addParam(columnSEXP);
-      formatFx.addParam(gsl::narrow_cast<int>(start));
-      formatFx.addParam(gsl::narrow_cast<int>(length));
-      error = formatFx.call(&formattedColumnSEXP, &protect);
-      if (error)
-         throw r::exec::RErrorException(error.getSummary());
-      
-      SET_VECTOR_ELT(formattedDataSEXP, i - initialIndex, formattedColumnSEXP);
-   }
 
-   // format the row names
-   SEXP rownamesSEXP = R_NilValue;
-   r::exec::RFunction(".rs.formatRowNames", dataSEXP, start, length)
-      .call(&rownamesSEXP, &protect);
-   
-   // create the result grid as JSON
-   
-   json::Array data;
-   for (int row = 0; row < length; row++)
-   {
-      // first, handle row names
-      json::Array rowData;
-      if (rownamesSEXP != nullptr && TYPEOF(rownamesSEXP) == STRSXP)
-      {
-         SEXP nameSEXP = STRING_ELT(rownamesSEXP, row);
-         if (nameSEXP == nullptr)
-         {
-            rowData.push_back(row + start);
-         }
-         else if (nameSEXP == NA_STRING)
-         {
-            rowData.push_back(SPECIAL_CELL_NA);
-         }
-         else if (r::sexp::length(nameSEXP) == 0)
-         {
-            rowData.push_back(row + start);
-         }
-         else
-         {
-            rowData.push_back(Rf_translateCharUTF8(nameSEXP));
-         }
-      }
-      else
+      // common column types are formatted natively; others by R
+      FormattedColumn& column = columns[i - initialIndex];
+      if (!formatColumn(columnSEXP, pageRows, options, &column))
       {
-         rowData.push_back(row + start);
+         column.clear();
+         formatColumnInR(columnSEXP, pageRowNumbers, &column);
       }
-
-      // now, handle remaining columns in formatted data
-      for (int col = 0, ncol = r::sexp::length(formattedDataSEXP); col < ncol; col++)
-      {
-         // NOTE: it is possible for malformed data.frames to have columns with
-         // differing number of elements; this is rare in practice but needs
-         // to be handled to avoid crashes
-         // https://github.com/rstudio/rstudio/issues/9364
-         SEXP columnSEXP = VECTOR_ELT(formattedDataSEXP, col);
-         if (row >= r::sexp::length(columnSEXP))
-         {
-            // because R's default print method pads with NAs in this case,
-            // we replicate that with our own padded NAs
-            rowData.push_back(SPECIAL_CELL_NA);
-            continue;
-         }
-         
-         // validate that we have a character vector
-         if (columnSEXP == nullptr || TYPEOF(columnSEXP) != STRSXP)
-         {
-            rowData.push_back("");
-            continue;
-         }
-         
-         // we have a valid character vector; access the string element
-         // and push back data as appropriate
-         SEXP stringSEXP = STRING_ELT(columnSEXP, row);
-         if (stringSEXP == nullptr)
-         {
-            rowData.push_back("");
-         }
-         else if (stringSEXP == NA_STRING)
-         {
-            rowData.push_back(SPECIAL_CELL_NA);
-         }
-         else if (r::sexp::length(stringSEXP) == 0)
-         {
-            rowData.push_back("");
-         }
-         else
-         {
-            rowData.push_back(Rf_translateCharUTF8(stringSEXP));
-         }
-      }
-      
-      // all done, add row data
-      data.push_back(rowData);
    }
 
-   json::Object result;
-   result["draw"] = draw;
-   result["recordsTotal"] = nrow;
-   result["recordsFiltered"] = filteredNRow;
-   result["data"] = data;
-   return std::move(result);
+   // format the row names
+   if (!formatRowNames(dataSEXP, pageRows, &pPage->rowNames))
+   {
+      SEXP rownamesSEXP = R_NilValue;
+      r::exec::RFunction(".rs.formatRowNames", dataSEXP, pageRowNumbers)
+         .call(&rownamesSEXP, &protect);
+      readFormattedStrings(rownamesSEXP, &pPage->rowNames);
+   }
 }
 
 Error getGridData(const http::Request& request,
                   http::Response* pResponse)
 {
    json::Value result;
+   std::string data;
+   std::string contentType = "application/json";
    http::status::Code status = http::status::Ok;
 
+   // clients which can decode grid pages in the columnar format ask for it;
+   // others (and errors) are sent JSON
+   bool columnar = boost::algorithm::contains(
+            request.headerValue("Accept"), kColumnarGridContentType);
+
    try
    {
       // find the data frame we're going to be pulling data from
@@ -827,7 +824,17 @@ Error getGridData(const http::Request& request,
          }
          else if (show == "data")
          {
-            result = getData(dataSEXP, fields);
+            GridPage page;
+            getData(dataSEXP, fields, &page);
+            if (columnar)
+            {
+               writeColumnarGrid(page, &data);
+               contentType = kColumnarGridContentType;
+            }
+            else
+            {
+               data = gridJson(page);
+            }
          }
       }
    }
@@ -849,9 +856,10 @@ Error getGridData(const http::Request& request,
    // is another option here for some character ranges but since (a) these are
    // unprintable and (b) some characters are invalid *even if escaped* e.g.
    // \v, there's little to be gained here in trying to marshal them to the
-   // viewer.
-   std::string output = result.write();
-   for (size_t i = 0; i < output.size(); i++)
+   // viewer. (The columnar format replaces these in its strings itself.)
+   std::string output = data.empty() ? result.write() : data;
+   bool isJson = contentType != kColumnarGridContentType;
+   for (size_t i = 0; isJson && i < output.size(); i++)
    {
       char c = output[i];
       // These ranges for control character values come from empirical testing
@@ -863,7 +871,12 @@ Error getGridData(const http::Request& request,
 
    pResponse->setNoCacheHeaders();    // don't cache data/grid shape
    pResponse->setStatusCode(status);
-   pResponse->setContentType("application/json");
+   pResponse->setContentType(contentType);
+
+   // columnar pages are compressed if the client accepts it (JSON pages are
+   // sent as they always have been)
+   if (!isJson && request.acceptsEncoding(http::kGzipEncoding))
+      pResponse->setContentEncoding(http::kGzipEncoding);
    pResponse->setBody(output);
 
    return Success();
@@ -960,9 +973,6 @@ void onDetectChanges(module_context::ChangeSource source)
          // create a new frame object to capture the new state of the frame
          CachedFrame newFrame(i->second.envName, i->second.objName, sexp);
 
-         // clear working data for the object
-         r::exec::RFunction(".rs.removeWorkingData", i->first).call();
-
          // replace cached copy (if we have something to replace it with)
          if (sexp != nullptr)
             r::exec::RFunction(".rs.assignCachedData", 
@@ -1034,7 +1044,7 @@ void onDeferredInit(bool newSession)
 {
    // get all the cache keys in the source database
    std::vector<boost::shared_ptr<source_database::SourceDocument> > docs;
-   Error error = source_database::list(&docs);
+   Error error = source_database::list(&docs, false);
    if (error)
    {
       LOG_ERROR(error);
@@ -0,0 +1,426 @@
+/*
+ * DataViewerColumnar.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "DataViewerColumnar.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+const std::uint32_t kColumnarMagic = 0x43475352;   // "RSGC"
+const std::uint32_t kColumnarVersion = 2;
+
+// the layouts in which a column's cells are sent
+enum ColumnKind
+{
+   kTextColumn = 0,
+   kFixedColumn = 1,
+   kScientificColumn = 2
+};
+
+// special text cells
+const std::uint32_t kNACell = 0xFFFFFFFF;
+const std::uint32_t kRowNumberCell = 0xFFFFFFFE;
+
+// NA in a column of numbers sent as i32 digits
+const std::int32_t kNADigits = std::numeric_limits<std::int32_t>::min();
+
+// the largest integer which (along with all smaller ones) the client can hold
+// exactly in a double
+const double kMaxExactInteger = 9007199254740991.0;
+
+// the most decimal places of a numeric cell; more digits than this can't be
+// held exactly in any case
+const int kMaxDecimals = 16;
+
+class ColumnarWriter
+{
+public:
+   explicit ColumnarWriter(std::string* pOutput)
+      : pOutput_(pOutput)
+   {
+   }
+
+   void writeU8(std::uint8_t value)
+   {
+      pOutput_->push_back(static_cast<char>(value));
+   }
+
+   void writeU16(std::uint16_t value)
+   {
+      writeU8(static_cast<std::uint8_t>(value));
+      writeU8(static_cast<std::uint8_t>(value >> 8));
+   }
+
+   void writeU32(std::uint32_t value)
+   {
+      writeU16(static_cast<std::uint16_t>(value));
+      writeU16(static_cast<std::uint16_t>(value >> 16));
+   }
+
+   void writeI32(std::int32_t value)
+   {
+      writeU32(static_cast<std::uint32_t>(value));
+   }
+
+   void writeF64(double value)
+   {
+      std::uint64_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      writeU32(static_cast<std::uint32_t>(bits));
+      writeU32(static_cast<std::uint32_t>(bits >> 32));
+   }
+
+   void writeString(const std::string& value)
+   {
+      writeU32(static_cast<std::uint32_t>(value.size()));
+      std::size_t offset = pOutput_->size();
+      pOutput_->append(value);
+
+      // replace the control characters which getGridData replaces in JSON,
+      // so that the grid shows the same text whichever format it's sent in
+      for (std::size_t i = offset; i < pOutput_->size(); i++)
+      {
+         char c = (*pOutput_)[i];
+         if ((c >= 1 && c <= 7) || c == 11 || (c >= 14 && c <= 31))
+            (*pOutput_)[i] = ' ';
+      }
+   }
+
+private:
+   std::string* pOutput_;
+};
+
+// the strings of a page, each stored once
+class StringTable
+{
+public:
+   std::uint32_t index(const std::string& value)
+   {
+      auto it = indexes_.find(value);
+      if (it != indexes_.end())
+         return it->second;
+
+      std::uint32_t index = static_cast<std::uint32_t>(strings_.size());
+      indexes_[value] = index;
+      strings_.push_back(value);
+      return index;
+   }
+
+   const std::vector<std::string>& strings() const { return strings_; }
+
+private:
+   std::unordered_map<std::string, std::uint32_t> indexes_;
+   std::vector<std::string> strings_;
+};
+
+// the layout chosen for a column, with its cells in that layout
+struct EncodedColumn
+{
+   EncodedColumn() : kind(kTextColumn), decimals(0) {}
+
+   ColumnKind kind;
+   int decimals;
+   std::vector<std::uint32_t> text;
+   std::vector<double> digits;
+   std::vector<std::int16_t> exponents;
+};
+
+bool isMissing(const FormattedColumn& column, int row)
+{
+   return static_cast<std::size_t>(row) >= column.size() || column.isNA(row);
+}
+
+// the text of a number whose digits, read as an integer, are given, with the
+// given number of decimal places (as the client rebuilds it)
+std::string fixedText(double digits, int decimals)
+{
+   std::string text = std::to_string(static_cast<long long>(std::fabs(digits)));
+   if (decimals > 0)
+   {
+      std::size_t width = static_cast<std::size_t>(decimals) + 1;
+      if (text.size() < width)
+         text.insert(0, width - text.size(), '0');
+      text.insert(text.size() - decimals, ".");
+   }
+   return digits < 0 ? "-" + text : text;
+}
+
+std::string scientificText(double digits, int exponent, int decimals)
+{
+   std::string text = fixedText(digits, decimals) + (exponent < 0 ? "e-" : "e+");
+   std::string power = std::to_string(std::abs(exponent));
+   if (power.size() < 2)
+      power.insert(0, "0");
+   return text + power;
+}
+
+// reads the digits of a number (e.g. "-12.50") as an integer (-1250), and
+// its number of decimal places; returns the position after the number
+std::size_t readDigits(const std::string& text,
+                       std::size_t pos,
+                       double* pDigits,
+                       int* pDecimals)
+{
+   bool negative = pos < text.size() && text[pos] == '-';
+   if (negative)
+      pos++;
+
+   double digits = 0;
+   int count = 0;
+   int decimals = -1;
+   for (; pos < text.size(); pos++)
+   {
+      char c = text[pos];
+      if (c == '.' && decimals < 0)
+      {
+         decimals = 0;
+      }
+      else if (c >= '0' && c <= '9')
+      {
+         // once this many digits are read the value may not be exact; such
+         // numbers are rejected below
+         if (count++ < 17)
+            digits = digits * 10 + (c - '0');
+         if (decimals >= 0)
+            decimals++;
+      }
+      else
+      {
+         break;
+      }
+   }
+
+   if (count == 0 || count > 16 || digits > kMaxExactInteger)
+      return std::string::npos;
+
+   *pDigits = negative ? -digits : digits;
+   *pDecimals = std::max(decimals, 0);
+   return pos;
+}
+
+// attempts to encode the cells of a column as numbers in the fixed layout;
+// succeeds only if every cell is rebuilt from them as it was formatted
+bool encodeFixed(const FormattedColumn& column, int rows, EncodedColumn* pEncoded)
+{
+   pEncoded->kind = kFixedColumn;
+   pEncoded->decimals = -1;
+   pEncoded->digits.reserve(rows);
+
+   for (int row = 0; row < rows; row++)
+   {
+      if (isMissing(column, row))
+      {
+         pEncoded->digits.push_back(std::numeric_limits<double>::quiet_NaN());
+         continue;
+      }
+
+      const std::string& value = column.value(row);
+      double digits;
+      int decimals;
+      if (readDigits(value, 0, &digits, &decimals) != value.size() ||
+          decimals > kMaxDecimals)
+         return false;
+
+      // all cells of a column share the same number of decimal places
+      if (pEncoded->decimals < 0)
+         pEncoded->decimals = decimals;
+      if (decimals != pEncoded->decimals || fixedText(digits, decimals) != value)
+         return false;
+
+      pEncoded->digits.push_back(digits);
+   }
+
+   // a column with no values is sent as text
+   return pEncoded->decimals >= 0;
+}
+
+// attempts to encode the cells of a column as numbers in the scientific
+// layout, as for encodeFixed
+bool encodeScientific(const FormattedColumn& column, int rows, EncodedColumn* pEncoded)
+{
+   pEncoded->kind = kScientificColumn;
+   pEncoded->decimals = -1;
+   pEncoded->digits.reserve(rows);
+   pEncoded->exponents.reserve(rows);
+
+   for (int row = 0; row < rows; row++)
+   {
+      if (isMissing(column, row))
+      {
+         pEncoded->digits.push_back(std::numeric_limits<double>::quiet_NaN());
+         pEncoded->exponents.push_back(0);
+         continue;
+      }
+
+      const std::string& value = column.value(row);
+      double digits;
+      int decimals;
+      std::size_t pos = readDigits(value, 0, &digits, &decimals);
+      if (pos == std::string::npos || pos + 2 >= value.size() || value[pos] != 'e' ||
+          decimals > kMaxDecimals)
+         return false;
+
+      // read the exponent (R writes at least two digits, and at most three)
+      bool negative = value[++pos] == '-';
+      if (!negative && value[pos] != '+')
+         return false;
+      int exponent = 0;
+      for (pos++; pos < value.size(); pos++)
+      {
+         char c = value[pos];
+         if (c < '0' || c > '9' || exponent > 999)
+            return false;
+         exponent = exponent * 10 + (c - '0');
+      }
+      if (negative)
+         exponent = -exponent;
+
+      if (pEncoded->decimals < 0)
+         pEncoded->decimals = decimals;
+      if (decimals != pEncoded->decimals || scientificText(digits, exponent, decimals) != value)
+         return false;
+
+      pEncoded->digits.push_back(digits);
+      pEncoded->exponents.push_back(static_cast<std::int16_t>(exponent));
+   }
+
+   return pEncoded->decimals >= 0;
+}
+
+void encodeText(const FormattedColumn& column,
+                int rows,
+                bool rowNames,
+                StringTable* pStrings,
+                EncodedColumn* pEncoded)
+{
+   pEncoded->kind = kTextColumn;
+   pEncoded->decimals = 0;
+   pEncoded->text.reserve(rows);
+
+   for (int row = 0; row < rows; row++)
+   {
+      // rows without names are shown by their numbers
+      if (rowNames && (static_cast<std::size_t>(row) >= column.size() ||
+                       (!column.isNA(row) && column.value(row).empty())))
+         pEncoded->text.push_back(kRowNumberCell);
+      else if (isMissing(column, row))
+         pEncoded->text.push_back(kNACell);
+      else
+         pEncoded->text.push_back(pStrings->index(column.value(row)));
+   }
+}
+
+void encodeColumn(const FormattedColumn& column,
+                  int rows,
+                  StringTable* pStrings,
+                  EncodedColumn* pEncoded)
+{
+   if (encodeFixed(column, rows, pEncoded))
+      return;
+
+   *pEncoded = EncodedColumn();
+   if (encodeScientific(column, rows, pEncoded))
+      return;
+
+   *pEncoded = EncodedColumn();
+   encodeText(column, rows, false, pStrings, pEncoded);
+}
+
+// the number of bytes in which each of a column's digits are sent: most
+// columns' digits fit in an i32, and the rest are sent as f64
+std::uint8_t digitsWidth(const EncodedColumn& column)
+{
+   if (column.kind == kTextColumn)
+      return 0;
+
+   const double kMaxDigits = std::numeric_limits<std::int32_t>::max();
+   for (double digits : column.digits)
+   {
+      if (!std::isnan(digits) && std::fabs(digits) > kMaxDigits)
+         return 8;
+   }
+   return 4;
+}
+
+void writeColumn(const EncodedColumn& column, ColumnarWriter* pWriter)
+{
+   std::uint8_t width = digitsWidth(column);
+   pWriter->writeU8(static_cast<std::uint8_t>(column.kind));
+   pWriter->writeU8(static_cast<std::uint8_t>(column.decimals));
+   pWriter->writeU8(width);
+
+   for (std::uint32_t cell : column.text)
+      pWriter->writeU32(cell);
+   for (double digits : column.digits)
+   {
+      if (width == 8)
+         pWriter->writeF64(digits);
+      else
+         pWriter->writeI32(std::isnan(digits) ? kNADigits : static_cast<std::int32_t>(digits));
+   }
+   for (std::int16_t exponent : column.exponents)
+      pWriter->writeU16(static_cast<std::uint16_t>(exponent));
+}
+
+} // anonymous namespace
+
+void writeColumnarGrid(const GridPage& page, std::string* pOutput)
+{
+   int rows = std::max(page.length, 0);
+
+   // encode the row names and columns first, so that the strings they use
+   // can be written ahead of them
+   StringTable strings;
+   std::vector<EncodedColumn> columns(page.columns.size() + 1);
+   encodeText(page.rowNames, rows, true, &strings, &columns[0]);
+   for (std::size_t i = 0; i < page.columns.size(); i++)
+      encodeColumn(page.columns[i], rows, &strings, &columns[i + 1]);
+
+   ColumnarWriter writer(pOutput);
+   writer.writeU32(kColumnarMagic);
+   writer.writeU32(kColumnarVersion);
+   writer.writeU32(static_cast<std::uint32_t>(page.draw));
+   writer.writeU32(static_cast<std::uint32_t>(page.recordsTotal));
+   writer.writeU32(static_cast<std::uint32_t>(page.recordsFiltered));
+   writer.writeU32(static_cast<std::uint32_t>(page.start));
+   writer.writeU32(static_cast<std::uint32_t>(rows));
+   writer.writeU32(static_cast<std::uint32_t>(columns.size()));
+
+   writer.writeU32(static_cast<std::uint32_t>(strings.strings().size()));
+   for (const std::string& value : strings.strings())
+      writer.writeString(value);
+
+   for (const EncodedColumn& column : columns)
+      writeColumn(column, &writer);
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
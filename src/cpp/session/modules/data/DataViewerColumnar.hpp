@@ -0,0 +1,66 @@
+/*
+ * DataViewerColumnar.hpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_DATA_VIEWER_COLUMNAR_HPP
+#define SESSION_DATA_VIEWER_COLUMNAR_HPP
+
+#include <string>
+
+#include "DataViewerFormat.hpp"
+
+// the content type of grid pages in the columnar format; clients which can
+// decode the format list it in their Accept header (others are sent JSON)
+#define kColumnarGridContentType "application/vnd.rstudio.grid-columnar"
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+// writes a page of the grid in a compact columnar binary format, decoded by
+// decodeColumnarGrid in dtviewer.js. all values are little-endian:
+//
+//    u32  magic ("RSGC") and format version
+//    u32  draw, recordsTotal, recordsFiltered, start, row count, column count
+//    u32  string count, then each string as a u32 byte length and UTF-8 bytes
+//
+// followed by each column (the row names first) as a u8 column kind, a u8
+// count of decimal places and a u8 digit width (the bytes in which a number's
+// digits are sent; 0 for text), then the column's cells:
+//
+//    text        u32 per row: an index into the strings, kNACell or
+//                kRowNumberCell (an unnamed row, shown by its number)
+//    fixed       i32 or f64 per row (by the digit width): the cell's digits
+//                as an integer (e.g. 1.25 is 125 with 2 decimals), or NA
+//                (the smallest i32, or NaN)
+//    scientific  digits per row: the mantissa's digits, as for fixed; then
+//                i16 per row: the exponent
+//
+// digits are sent as i32 whenever all of a column's digits fit one, as they
+// do for most columns (f64 holds up to 15 or 16 digits exactly)
+//
+// numeric columns are sent in the fixed or scientific layouts only when every
+// cell can be rebuilt from them exactly as formatted; otherwise (and for
+// other columns) cells are sent as text, with repeated strings sent once
+void writeColumnarGrid(const GridPage& page, std::string* pOutput);
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_DATA_VIEWER_COLUMNAR_HPP
@@ -0,0 +1,336 @@
+/*
+ * DataViewerColumnarTests.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "DataViewerColumnar.hpp"
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+// a cell decoded from the columnar format, as the client shows it
+struct Cell
+{
+   Cell() : isNA(false), rowNumber(0) {}
+
+   bool isNA;
+   int rowNumber;
+   std::string text;
+};
+
+// reads the columnar format back as decodeColumnarGrid in dtviewer.js does
+class ColumnarReader
+{
+public:
+   explicit ColumnarReader(const std::string& input)
+      : input_(input), pos_(0)
+   {
+   }
+
+   std::uint32_t readU8()
+   {
+      return static_cast<unsigned char>(input_.at(pos_++));
+   }
+
+   std::uint32_t readU16()
+   {
+      std::uint32_t low = readU8();
+      return low | (readU8() << 8);
+   }
+
+   std::uint32_t readU32()
+   {
+      std::uint32_t low = readU16();
+      return low | (readU16() << 16);
+   }
+
+   double readF64()
+   {
+      std::uint64_t low = readU32();
+      std::uint64_t bits = low | (static_cast<std::uint64_t>(readU32()) << 32);
+      double value;
+      std::memcpy(&value, &bits, sizeof(value));
+      return value;
+   }
+
+   std::string readString()
+   {
+      std::uint32_t length = readU32();
+      std::string value = input_.substr(pos_, length);
+      pos_ += length;
+      return value;
+   }
+
+   bool atEnd() const { return pos_ == input_.size(); }
+
+private:
+   const std::string& input_;
+   std::size_t pos_;
+};
+
+std::string numberText(double digits, int decimals)
+{
+   std::string text = std::to_string(static_cast<long long>(std::fabs(digits)));
+   while (decimals > 0 && text.size() < static_cast<std::size_t>(decimals) + 1)
+      text = "0" + text;
+   if (decimals > 0)
+      text.insert(text.size() - decimals, ".");
+   return digits < 0 ? "-" + text : text;
+}
+
+// decodes a page into rows of cells, returning the kind of each column (and
+// optionally the width of its digits)
+std::vector<int> decode(const std::string& input,
+                        int* pStart,
+                        std::vector<std::vector<Cell>>* pRows,
+                        std::vector<int>* pWidths = nullptr)
+{
+   std::vector<int> kinds;
+   ColumnarReader reader(input);
+   expect_true(reader.readU32() == 0x43475352);
+   expect_true(reader.readU32() == 2);
+   reader.readU32();   // draw
+   reader.readU32();   // recordsTotal
+   reader.readU32();   // recordsFiltered
+   *pStart = reader.readU32();
+   std::uint32_t rows = reader.readU32();
+   std::uint32_t columns = reader.readU32();
+
+   std::vector<std::string> strings(reader.readU32());
+   for (std::string& value : strings)
+      value = reader.readString();
+
+   pRows->assign(rows, std::vector<Cell>(columns));
+   for (std::uint32_t column = 0; column < columns; column++)
+   {
+      int kind = reader.readU8();
+      int decimals = reader.readU8();
+      int width = reader.readU8();
+      kinds.push_back(kind);
+      if (pWidths)
+         pWidths->push_back(width);
+      expect_true(kind == 0 ? width == 0 : (width == 4 || width == 8));
+
+      for (std::uint32_t row = 0; row < rows; row++)
+      {
+         Cell& cell = (*pRows)[row][column];
+         if (kind == 0)
+         {
+            std::uint32_t index = reader.readU32();
+            if (index == 0xFFFFFFFF)
+               cell.isNA = true;
+            else if (index == 0xFFFFFFFE)
+               cell.rowNumber = *pStart + row;
+            else
+               cell.text = strings.at(index);
+         }
+         else if (width == 4)
+         {
+            std::int32_t value = static_cast<std::int32_t>(reader.readU32());
+            cell.isNA = value == std::numeric_limits<std::int32_t>::min();
+            if (!cell.isNA)
+               cell.text = numberText(value, decimals);
+         }
+         else
+         {
+            double value = reader.readF64();
+            cell.isNA = std::isnan(value);
+            if (!cell.isNA)
+               cell.text = numberText(value, decimals);
+         }
+      }
+
+      for (std::uint32_t row = 0; kind == 2 && row < rows; row++)
+      {
+         int exponent = static_cast<std::int16_t>(reader.readU16());
+         Cell& cell = (*pRows)[row][column];
+         if (cell.isNA)
+            continue;
+         std::string power = std::to_string(std::abs(exponent));
+         cell.text += (exponent < 0 ? "e-" : "e+") + std::string(power.size() < 2 ? "0" : "") + power;
+      }
+   }
+
+   expect_true(reader.atEnd());
+   return kinds;
+}
+
+FormattedColumn column(const std::vector<const char*>& values)
+{
+   FormattedColumn column;
+   for (const char* value : values)
+   {
+      if (value == nullptr)
+         column.pushNA();
+      else
+         column.push(value);
+   }
+   return column;
+}
+
+// checks that the cells of each column of the page decode as they were
+// formatted
+bool roundTrips(const GridPage& page, const std::vector<int>& expectedKinds)
+{
+   std::string output;
+   writeColumnarGrid(page, &output);
+
+   int start = 0;
+   std::vector<std::vector<Cell>> rows;
+   if (decode(output, &start, &rows) != expectedKinds)
+      return false;
+   if (start != page.start || rows.size() != static_cast<std::size_t>(page.length))
+      return false;
+
+   for (std::size_t row = 0; row < rows.size(); row++)
+   {
+      for (std::size_t i = 0; i < page.columns.size(); i++)
+      {
+         const FormattedColumn& formatted = page.columns[i];
+         const Cell& cell = rows[row][i + 1];
+         bool isNA = row >= formatted.size() || formatted.isNA(row);
+         if (cell.isNA != isNA || (!isNA && cell.text != formatted.value(row)))
+            return false;
+      }
+   }
+
+   return true;
+}
+
+} // anonymous namespace
+
+test_context("Data viewer columnar format")
+{
+   test_that("Numeric columns are sent as numbers")
+   {
+      GridPage page;
+      page.length = 4;
+      page.rowNames = column({ "", "", "", "" });
+      page.columns.push_back(column({ "1.50", "-0.25", nullptr, "1234567.00" }));
+      page.columns.push_back(column({ "1.234e+05", "-5.000e-300", "0.000e+00", nullptr }));
+      page.columns.push_back(column({ "12", "-3", "0", "7" }));
+      expect_true(roundTrips(page, std::vector<int> { 0, 1, 2, 1 }));
+   }
+
+   test_that("Digits are sent as i32 when they fit, and f64 otherwise")
+   {
+      GridPage page;
+      page.length = 2;
+      page.columns.push_back(column({ "21474836.47", "-21474836.47" }));
+      page.columns.push_back(column({ "2147483648", nullptr }));
+      page.columns.push_back(column({ "1.234567890e+10", "-2.000000000e-05" }));
+      page.columns.push_back(column({ "123456789012345", "1" }));
+      expect_true(roundTrips(page, std::vector<int> { 0, 1, 1, 2, 1 }));
+
+      std::string output;
+      writeColumnarGrid(page, &output);
+      int start = 0;
+      std::vector<std::vector<Cell>> rows;
+      std::vector<int> widths;
+      decode(output, &start, &rows, &widths);
+      expect_true(widths == std::vector<int>({ 0, 4, 8, 4, 8 }));
+   }
+
+   test_that("Numeric pages are smaller than their JSON")
+   {
+      // a page of doubles as R formats them
+      GridPage page;
+      page.length = 100;
+      std::vector<std::string> values;
+      for (int row = 0; row < page.length; row++)
+         values.push_back(std::to_string(row * 37 % 1000) + "." + std::to_string(10 + row % 90));
+      for (int i = 0; i < 10; i++)
+      {
+         FormattedColumn formatted;
+         for (const std::string& value : values)
+            formatted.push(value);
+         page.columns.push_back(formatted);
+      }
+
+      std::string output;
+      writeColumnarGrid(page, &output);
+      std::vector<int> kinds(11, 1);
+      kinds[0] = 0;
+      expect_true(roundTrips(page, kinds));
+      expect_true(output.size() * 2 < gridJson(page).size());
+   }
+
+   test_that("Cells which can't be rebuilt from numbers are sent as text")
+   {
+      GridPage page;
+      page.length = 3;
+      page.rowNames = column({ "a", nullptr, "c" });
+      page.columns.push_back(column({ "1.5", "NaN", "Inf" }));
+      page.columns.push_back(column({ "007", "1", "2" }));
+      page.columns.push_back(column({ "-0.00", "1.00", "2.00" }));
+      page.columns.push_back(column({ "1.5", "2.25", "3" }));
+      page.columns.push_back(column({ "12345678901234567", "1", "2" }));
+      page.columns.push_back(column({ nullptr, nullptr, nullptr }));
+      page.columns.push_back(column({ "b", "b", "caf\xc3\xa9" }));
+      expect_true(roundTrips(page, std::vector<int> { 0, 0, 0, 0, 0, 0, 0, 0 }));
+   }
+
+   test_that("Rows without names are numbered")
+   {
+      GridPage page;
+      page.start = 26;
+      page.length = 3;
+      page.rowNames = column({ "x", "" });
+      page.columns.push_back(column({ "a", "b" }));
+
+      std::string output;
+      writeColumnarGrid(page, &output);
+      int start = 0;
+      std::vector<std::vector<Cell>> rows;
+      decode(output, &start, &rows);
+      expect_true(rows.size() == 3);
+      expect_true(rows[0][0].text == "x");
+      expect_true(rows[1][0].rowNumber == 27);
+      expect_true(rows[2][0].rowNumber == 28);
+      expect_true(rows[2][1].isNA);
+   }
+
+   test_that("Repeated strings are sent once")
+   {
+      GridPage single, repeated;
+      single.length = repeated.length = 100;
+      std::vector<const char*> once(100, "a long, frequently repeated factor level");
+      once[0] = "another level";
+      single.columns.push_back(column(once));
+      repeated.columns.push_back(column(std::vector<const char*>(100, "another level")));
+
+      std::string singleOutput, repeatedOutput;
+      writeColumnarGrid(single, &singleOutput);
+      writeColumnarGrid(repeated, &repeatedOutput);
+      expect_true(singleOutput.size() - repeatedOutput.size() ==
+                  std::strlen("a long, frequently repeated factor level") + 4);
+   }
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,699 @@
+/*
+ * DataViewerFormat.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#define R_INTERNAL_FUNCTIONS
+
+#include "DataViewerFormat.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <gsl/gsl>
+
+#include <r/RInternal.hpp>
+#include <r/ROptions.hpp>
+
+#include <shared_core/json/rapidjson/stringbuffer.h>
+#include <shared_core/json/rapidjson/writer.h>
+
+// special cell values
+#define SPECIAL_CELL_NA 0
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+// the largest power of ten held exactly, and the smallest decimal exponent of
+// a (normalized) double (as in R's format.c)
+const int kMaxPower = 27;
+const int kMinDecimalExponent = -308;
+
+long double powerOfTen(int power)
+{
+   static long double table[kMaxPower + 1];
+   static bool initialized = false;
+   if (!initialized)
+   {
+      table[0] = 1.0L;
+      for (int i = 1; i <= kMaxPower; i++)
+         table[i] = table[i - 1] * 10.0L;
+      initialized = true;
+   }
+   return table[power];
+}
+
+// for a finite number x, computes whether it's negative, its decimal exponent,
+// the number of significant digits (at most digits) needed to represent it,
+// and whether rounding to those digits widens it (a port of scientific() in
+// R's format.c)
+void scientific(double x,
+                int digits,
+                bool* pNegative,
+                int* pPower,
+                int* pSignificant,
+                bool* pRoundingWidens)
+{
+   if (x == 0.0)
+   {
+      *pNegative = false;
+      *pPower = 0;
+      *pSignificant = 1;
+      *pRoundingWidens = false;
+      return;
+   }
+
+   *pNegative = x < 0.0;
+   double r = std::fabs(x);
+
+   int kp = static_cast<int>(std::floor(std::log10(r))) - digits + 1;
+   long double scaled = r;
+   if (std::abs(kp) < 10)
+   {
+      if (kp > 0)
+         scaled /= powerOfTen(kp);
+      else if (kp < 0)
+         scaled *= powerOfTen(-kp);
+   }
+   else if (kp <= kMinDecimalExponent)
+   {
+      scaled = (r * 1e+303) / std::pow(10.0L, kp + 303);
+   }
+   else
+   {
+      scaled /= std::pow(10.0L, static_cast<long double>(kp));
+   }
+
+   if (scaled < powerOfTen(digits - 1))
+   {
+      scaled *= 10.0;
+      kp--;
+   }
+
+   // round to an integer with the requested number of digits, and drop the
+   // trailing zeros
+   double alpha = static_cast<double>(nearbyintl(scaled));
+   int significant = digits;
+   for (int j = 1; j <= digits; j++)
+   {
+      alpha /= 10.0;
+      if (alpha == std::floor(alpha))
+         significant--;
+      else
+         break;
+   }
+
+   if (significant == 0 && digits > 0)
+   {
+      significant = 1;
+      kp += 1;
+   }
+
+   *pPower = kp + digits - 1;
+   *pSignificant = significant;
+
+   // scientific format may round more than fixed format (e.g. 9996 with 3
+   // digits is 1e+04 in scientific format, but 9996 in fixed format)
+   int right = digits - *pPower;
+   right = right < 0 ? 0 : right > kMaxPower ? kMaxPower : right;
+   double fuzz = 0.5 / static_cast<double>(powerOfTen(right));
+   *pRoundingWidens = *pPower > 0 && *pPower <= kMaxPower &&
+                      r < static_cast<double>(powerOfTen(*pPower)) - fuzz;
+}
+
+// a common format for a vector of numbers: fixed with the given number of
+// decimal places, or scientific with the given number of mantissa decimals
+struct RealFormat
+{
+   bool scientific;
+   int decimals;
+};
+
+// computes the common format of the finite values (a port of formatReal()
+// in R's format.c)
+RealFormat realFormat(const std::vector<double>& values, const FormatOptions& options)
+{
+   bool anyNegative = false;
+   int right = INT_MIN, maxLeft = INT_MIN, minLeft = INT_MAX;
+   int maxSignedLeft = INT_MIN, maxSignificant = INT_MIN;
+
+   for (double value : values)
+   {
+      if (!std::isfinite(value))
+         continue;
+
+      bool negative, roundingWidens;
+      int power, significant;
+      scientific(value, options.digits, &negative, &power, &significant, &roundingWidens);
+
+      int left = power + 1;
+      if (roundingWidens)
+         left--;
+
+      int signedLeft = negative + ((left <= 0) ? 1 : left);
+      anyNegative = anyNegative || negative;
+      right = std::max(right, significant - left);
+      maxLeft = std::max(maxLeft, left);
+      minLeft = std::min(minLeft, left);
+      maxSignedLeft = std::max(maxSignedLeft, signedLeft);
+      maxSignificant = std::max(maxSignificant, significant);
+   }
+
+   RealFormat format;
+   format.scientific = false;
+   format.decimals = 0;
+   if (maxSignificant == INT_MIN)
+      return format;
+
+   if (maxLeft < 0)
+      maxSignedLeft = 1 + anyNegative;
+   if (right < 0)
+      right = 0;
+
+   int fixedWidth = maxSignedLeft + right + (right != 0);
+   int exponentDigits = (maxLeft > 100 || minLeft <= -99) ? 2 : 1;
+   int mantissaDecimals = maxSignificant - 1;
+   int scientificWidth = anyNegative + (mantissaDecimals > 0) + mantissaDecimals + 4 + exponentDigits;
+
+   if (fixedWidth <= scientificWidth + options.scipen)
+   {
+      format.decimals = right;
+   }
+   else
+   {
+      format.scientific = true;
+      format.decimals = mantissaDecimals;
+   }
+
+   return format;
+}
+
+// formats a number as R's encodeReal does (with no padding)
+std::string encodeReal(double value, const RealFormat& format)
+{
+   if (R_IsNA(value))
+      return "NA";
+   else if (ISNAN(value))
+      return "NaN";
+   else if (!std::isfinite(value))
+      return value > 0 ? "Inf" : "-Inf";
+
+   // don't show negative zero
+   if (value == 0.0)
+      value = 0.0;
+
+   char buffer[512];
+   if (format.scientific)
+      std::snprintf(buffer, sizeof(buffer), format.decimals ? "%#.*e" : "%.*e", format.decimals, value);
+   else
+      std::snprintf(buffer, sizeof(buffer), "%.*f", format.decimals, value);
+   return buffer;
+}
+
+void formatNumeric(SEXP columnSEXP,
+                   const std::vector<int>& rows,
+                   const FormatOptions& options,
+                   FormattedColumn* pColumn)
+{
+   // show numbers as doubles
+   std::vector<double> values;
+   values.reserve(rows.size());
+   R_xlen_t length = XLENGTH(columnSEXP);
+   if (TYPEOF(columnSEXP) == INTSXP)
+   {
+      const int* pData = INTEGER(columnSEXP);
+      for (int row : rows)
+         values.push_back(row >= length || pData[row] == NA_INTEGER ? NA_REAL : pData[row]);
+   }
+   else
+   {
+      const double* pData = REAL(columnSEXP);
+      for (int row : rows)
+         values.push_back(row >= length ? NA_REAL : pData[row]);
+   }
+
+   RealFormat format = realFormat(values, options);
+   for (double value : values)
+   {
+      // NA values are missing, but NaN values are shown as such
+      if (R_IsNA(value))
+      {
+         pColumn->pushNA();
+         continue;
+      }
+
+      // like R, show the decimal mark given by 'OutDec'
+      std::string encoded = encodeReal(value, format);
+      std::size_t point = encoded.find('.');
+      if (point != std::string::npos && options.outDec != ".")
+         encoded.replace(point, 1, options.outDec);
+      pColumn->push(encoded);
+   }
+}
+
+void formatLogical(SEXP columnSEXP,
+                   const std::vector<int>& rows,
+                   FormattedColumn* pColumn)
+{
+   const int* pData = LOGICAL(columnSEXP);
+   R_xlen_t length = XLENGTH(columnSEXP);
+   for (int row : rows)
+   {
+      if (row >= length || pData[row] == NA_LOGICAL)
+         pColumn->pushNA();
+      else
+         pColumn->push(pData[row] ? "TRUE" : "FALSE");
+   }
+}
+
+void pushString(SEXP stringSEXP, FormattedColumn* pColumn)
+{
+   if (stringSEXP == NA_STRING)
+      pColumn->pushNA();
+   else
+      pColumn->push(Rf_translateCharUTF8(stringSEXP));
+}
+
+void formatCharacter(SEXP columnSEXP,
+                     const std::vector<int>& rows,
+                     FormattedColumn* pColumn)
+{
+   R_xlen_t length = XLENGTH(columnSEXP);
+   for (int row : rows)
+   {
+      if (row >= length)
+         pColumn->pushNA();
+      else
+         pushString(STRING_ELT(columnSEXP, row), pColumn);
+   }
+}
+
+bool formatFactor(SEXP columnSEXP,
+                  const std::vector<int>& rows,
+                  FormattedColumn* pColumn)
+{
+   SEXP levelsSEXP = Rf_getAttrib(columnSEXP, R_LevelsSymbol);
+   if (TYPEOF(columnSEXP) != INTSXP || TYPEOF(levelsSEXP) != STRSXP)
+      return false;
+
+   const int* pData = INTEGER(columnSEXP);
+   R_xlen_t length = XLENGTH(columnSEXP);
+   R_xlen_t numLevels = XLENGTH(levelsSEXP);
+   for (int row : rows)
+   {
+      int level = row < length ? pData[row] : NA_INTEGER;
+      if (level == NA_INTEGER || level < 1 || level > numLevels)
+      {
+         pColumn->pushNA();
+      }
+      else
+      {
+         // a level which is itself NA is shown as such
+         SEXP levelSEXP = STRING_ELT(levelsSEXP, level - 1);
+         pColumn->push(levelSEXP == NA_STRING ? "NA" : Rf_translateCharUTF8(levelSEXP));
+      }
+   }
+   return true;
+}
+
+// converts days since the epoch to a civil (proleptic Gregorian) date
+void civilFromDays(long long days, int* pYear, int* pMonth, int* pDay)
+{
+   days += 719468;
+   long long era = (days >= 0 ? days : days - 146096) / 146097;
+   long long dayOfEra = days - era * 146097;
+   long long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+   long long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+   long long monthIndex = (5 * dayOfYear + 2) / 153;
+   *pDay = static_cast<int>(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+   *pMonth = static_cast<int>(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+   *pYear = static_cast<int>(yearOfEra + era * 400 + (*pMonth <= 2));
+}
+
+// reads the elements of a Date or POSIXct column as doubles; returns false if
+// any is infinite or outside of the range of four digit years (R's
+// formatting of which we don't replicate)
+bool readTimes(SEXP columnSEXP,
+               const std::vector<int>& rows,
+               double unitsPerDay,
+               std::vector<double>* pValues)
+{
+   R_xlen_t length = XLENGTH(columnSEXP);
+   for (int row : rows)
+   {
+      double value;
+      if (TYPEOF(columnSEXP) != INTSXP && TYPEOF(columnSEXP) != REALSXP)
+         return false;
+      else if (row >= length)
+         value = NA_REAL;
+      else if (TYPEOF(columnSEXP) == INTSXP)
+         value = INTEGER(columnSEXP)[row] == NA_INTEGER ? NA_REAL : INTEGER(columnSEXP)[row];
+      else
+         value = REAL(columnSEXP)[row];
+
+      if (!ISNAN(value))
+      {
+         // the range of years 0001 through 9999
+         double days = value / unitsPerDay;
+         if (!std::isfinite(value) || days < -719162 || days >= 2932897)
+            return false;
+      }
+
+      pValues->push_back(value);
+   }
+   return true;
+}
+
+bool formatDate(SEXP columnSEXP,
+                const std::vector<int>& rows,
+                FormattedColumn* pColumn)
+{
+   std::vector<double> values;
+   if (!readTimes(columnSEXP, rows, 1, &values))
+      return false;
+
+   for (double value : values)
+   {
+      if (ISNAN(value))
+      {
+         pColumn->pushNA();
+         continue;
+      }
+
+      int year, month, day;
+      civilFromDays(static_cast<long long>(std::floor(value)), &year, &month, &day);
+
+      char buffer[16];
+      std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", year, month, day);
+      pColumn->push(buffer);
+   }
+   return true;
+}
+
+bool isUtc(SEXP columnSEXP)
+{
+   SEXP tzoneSEXP = Rf_getAttrib(columnSEXP, Rf_install("tzone"));
+   if (TYPEOF(tzoneSEXP) != STRSXP || XLENGTH(tzoneSEXP) < 1 ||
+       STRING_ELT(tzoneSEXP, 0) == NA_STRING)
+   {
+      return false;
+   }
+
+   const char* tzone = CHAR(STRING_ELT(tzoneSEXP, 0));
+   return std::strcmp(tzone, "UTC") == 0 || std::strcmp(tzone, "GMT") == 0;
+}
+
+bool formatDateTime(SEXP columnSEXP,
+                    const std::vector<int>& rows,
+                    const FormatOptions& options,
+                    FormattedColumn* pColumn)
+{
+   // we only format times in UTC, and without fractional seconds
+   if (!isUtc(columnSEXP) || options.digitsSecs)
+      return false;
+
+   std::vector<double> values;
+   if (!readTimes(columnSEXP, rows, 86400, &values))
+      return false;
+
+   // like format.POSIXlt, show seconds only if any are non-zero, and times
+   // only if any aren't midnight
+   bool showSeconds = false, showTimes = false;
+   for (double value : values)
+   {
+      if (ISNAN(value))
+         continue;
+
+      double seconds = value - 86400 * std::floor(value / 86400);
+      showTimes = showTimes || seconds != 0;
+      showSeconds = showSeconds || std::fmod(seconds, 60) != 0;
+   }
+
+   for (double value : values)
+   {
+      if (ISNAN(value))
+      {
+         pColumn->pushNA();
+         continue;
+      }
+
+      long long seconds = static_cast<long long>(std::floor(value));
+      long long days = seconds >= 0 ? seconds / 86400 : -((-seconds + 86399) / 86400);
+      long long secondOfDay = seconds - days * 86400;
+
+      int year, month, day;
+      civilFromDays(days, &year, &month, &day);
+      int hour = static_cast<int>(secondOfDay / 3600);
+      int minute = static_cast<int>(secondOfDay / 60 % 60);
+      int second = static_cast<int>(secondOfDay % 60);
+
+      char buffer[32];
+      if (showSeconds)
+         std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d",
+                       year, month, day, hour, minute, second);
+      else if (showTimes)
+         std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d",
+                       year, month, day, hour, minute);
+      else
+         std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", year, month, day);
+      pColumn->push(buffer);
+   }
+   return true;
+}
+
+// returns the class of an object as a single string (e.g. "POSIXct/POSIXt")
+std::string classOf(SEXP objectSEXP)
+{
+   SEXP classSEXP = Rf_getAttrib(objectSEXP, R_ClassSymbol);
+   if (TYPEOF(classSEXP) != STRSXP)
+      return std::string();
+
+   std::string classes;
+   for (R_xlen_t i = 0; i < XLENGTH(classSEXP); i++)
+   {
+      if (i > 0)
+         classes += "/";
+      SEXP classNameSEXP = STRING_ELT(classSEXP, i);
+      if (classNameSEXP != NA_STRING)
+         classes += CHAR(classNameSEXP);
+   }
+   return classes;
+}
+
+// reads the (possibly compact) row names of an object without expanding them
+SEXP rowNamesAttribute(SEXP objectSEXP)
+{
+   for (SEXP attribSEXP = ATTRIB(objectSEXP);
+        attribSEXP != R_NilValue;
+        attribSEXP = CDR(attribSEXP))
+   {
+      if (TAG(attribSEXP) == R_RowNamesSymbol)
+         return CAR(attribSEXP);
+   }
+   return R_NilValue;
+}
+
+int optionAsInteger(const std::string& name, int defaultValue)
+{
+   SEXP valueSEXP = r::options::getOption(name);
+   if (valueSEXP == R_NilValue || Rf_length(valueSEXP) < 1)
+      return defaultValue;
+
+   int value = Rf_asInteger(valueSEXP);
+   return value == NA_INTEGER ? defaultValue : value;
+}
+
+void writeString(const std::string& value,
+                 rapidjson::Writer<rapidjson::StringBuffer>* pWriter)
+{
+   pWriter->String(value.c_str(), gsl::narrow_cast<rapidjson::SizeType>(value.length()));
+}
+
+} // anonymous namespace
+
+std::string gridJson(const GridPage& page)
+{
+   const FormattedColumn& rowNames = page.rowNames;
+
+   rapidjson::StringBuffer buffer;
+   rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+   writer.StartObject();
+   writer.Key("draw");
+   writer.Int(page.draw);
+   writer.Key("recordsTotal");
+   writer.Int(page.recordsTotal);
+   writer.Key("recordsFiltered");
+   writer.Int(page.recordsFiltered);
+   writer.Key("data");
+   writer.StartArray();
+   for (int row = 0; row < page.length; row++)
+   {
+      writer.StartArray();
+
+      // first, handle row names (rows without names are numbered)
+      if (static_cast<std::size_t>(row) < rowNames.size() && rowNames.isNA(row))
+         writer.Int(SPECIAL_CELL_NA);
+      else if (static_cast<std::size_t>(row) < rowNames.size() && !rowNames.value(row).empty())
+         writeString(rowNames.value(row), &writer);
+      else
+         writer.Int(row + page.start);
+
+      // now, handle remaining columns in formatted data
+      for (const FormattedColumn& column : page.columns)
+      {
+         // NOTE: it is possible for malformed data.frames to have columns with
+         // differing number of elements; this is rare in practice but needs
+         // to be handled to avoid crashes
+         // https://github.com/rstudio/rstudio/issues/9364
+         if (static_cast<std::size_t>(row) >= column.size())
+         {
+            // because R's default print method pads with NAs in this case,
+            // we replicate that with our own padded NAs
+            writer.Int(SPECIAL_CELL_NA);
+         }
+         else if (column.isNA(row))
+         {
+            writer.Int(SPECIAL_CELL_NA);
+         }
+         else
+         {
+            writeString(column.value(row), &writer);
+         }
+      }
+
+      writer.EndArray();
+   }
+   writer.EndArray();
+   writer.EndObject();
+
+   return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+FormatOptions formatOptions()
+{
+   FormatOptions options;
+
+   // R constrains digits to [1, 22], and bounds scipen
+   options.digits = std::max(1, std::min(22, optionAsInteger("digits", 7)));
+   options.scipen = std::max(-9, std::min(9999, optionAsInteger("scipen", 0)));
+   options.digitsSecs = r::options::getOption("digits.secs") != R_NilValue;
+
+   SEXP outDecSEXP = r::options::getOption("OutDec");
+   if (TYPEOF(outDecSEXP) == STRSXP && Rf_length(outDecSEXP) > 0 &&
+       STRING_ELT(outDecSEXP, 0) != NA_STRING)
+   {
+      options.outDec = Rf_translateCharUTF8(STRING_ELT(outDecSEXP, 0));
+   }
+   return options;
+}
+
+bool formatColumn(SEXP columnSEXP,
+                  const std::vector<int>& rows,
+                  const FormatOptions& options,
+                  FormattedColumn* pColumn)
+{
+   pColumn->reserve(rows.size());
+
+   if (OBJECT(columnSEXP))
+   {
+      // we only handle a few well known classes; everything else (including
+      // subclasses of these, which may have their own format methods) is
+      // formatted by R
+      std::string classes = classOf(columnSEXP);
+      if (classes == "factor" || classes == "ordered/factor")
+         return formatFactor(columnSEXP, rows, pColumn);
+      else if (classes == "Date")
+         return formatDate(columnSEXP, rows, pColumn);
+      else if (classes == "POSIXct/POSIXt")
+         return formatDateTime(columnSEXP, rows, options, pColumn);
+      return false;
+   }
+
+   switch (TYPEOF(columnSEXP))
+   {
+   case INTSXP:
+   case REALSXP:
+      formatNumeric(columnSEXP, rows, options, pColumn);
+      return true;
+   case LGLSXP:
+      formatLogical(columnSEXP, rows, pColumn);
+      return true;
+   case STRSXP:
+      formatCharacter(columnSEXP, rows, pColumn);
+      return true;
+   default:
+      return false;
+   }
+}
+
+bool formatRowNames(SEXP dataSEXP,
+                    const std::vector<int>& rows,
+                    FormattedColumn* pRowNames)
+{
+   if (!Rf_inherits(dataSEXP, "data.frame"))
+      return false;
+
+   pRowNames->reserve(rows.size());
+
+   SEXP rowNamesSEXP = rowNamesAttribute(dataSEXP);
+   if (TYPEOF(rowNamesSEXP) == INTSXP)
+   {
+      // compact row names are c(NA, n) or c(NA, -n) for n automatic rows
+      R_xlen_t numRows = XLENGTH(rowNamesSEXP);
+      bool compact = numRows == 2 && INTEGER(rowNamesSEXP)[0] == NA_INTEGER;
+      if (compact)
+         numRows = std::abs(INTEGER(rowNamesSEXP)[1]);
+
+      for (int row : rows)
+      {
+         // rows without names are numbered
+         if (row >= numRows)
+            pRowNames->push(std::string());
+         else if (compact)
+            pRowNames->push(std::to_string(row + 1));
+         else if (INTEGER(rowNamesSEXP)[row] == NA_INTEGER)
+            pRowNames->pushNA();
+         else
+            pRowNames->push(std::to_string(INTEGER(rowNamesSEXP)[row]));
+      }
+      return true;
+   }
+   else if (TYPEOF(rowNamesSEXP) == STRSXP)
+   {
+      R_xlen_t numRows = XLENGTH(rowNamesSEXP);
+      for (int row : rows)
+      {
+         if (row >= numRows)
+            pRowNames->push(std::string());
+         else
+            pushString(STRING_ELT(rowNamesSEXP, row), pRowNames);
+      }
+      return true;
+   }
+
+   return false;
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
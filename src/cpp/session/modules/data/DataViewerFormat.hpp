@@ -0,0 +1,126 @@
+/*
+ * DataViewerFormat.hpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_DATA_VIEWER_FORMAT_HPP
+#define SESSION_DATA_VIEWER_FORMAT_HPP
+
+#include <string>
+#include <vector>
+
+#include <r/RSexp.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+// the formatted cells of a column of the data viewer grid; missing (NA)
+// cells are displayed specially by the grid so are kept apart from values
+class FormattedColumn
+{
+public:
+   void clear()
+   {
+      values_.clear();
+      na_.clear();
+   }
+
+   void reserve(std::size_t n)
+   {
+      values_.reserve(n);
+      na_.reserve(n);
+   }
+
+   void push(const std::string& value)
+   {
+      values_.push_back(value);
+      na_.push_back(false);
+   }
+
+   void pushNA()
+   {
+      values_.push_back(std::string());
+      na_.push_back(true);
+   }
+
+   std::size_t size() const { return values_.size(); }
+   bool isNA(std::size_t i) const { return na_[i]; }
+   const std::string& value(std::size_t i) const { return values_[i]; }
+
+private:
+   std::vector<std::string> values_;
+   std::vector<bool> na_;
+};
+
+// a page of the data viewer grid: the formatted cells of each column
+// requested by the client, with the row names of the page's rows (columns
+// may be longer or, if the frame is malformed, shorter than the page)
+struct GridPage
+{
+   GridPage() : draw(0), recordsTotal(0), recordsFiltered(0), start(1), length(0) {}
+
+   int draw;
+   int recordsTotal;
+   int recordsFiltered;
+   int start;     // the (1-based) number of the page's first row
+   int length;    // the number of rows in the page
+   FormattedColumn rowNames;
+   std::vector<FormattedColumn> columns;
+};
+
+// writes a page of the grid as the JSON object DataTables expects (see also
+// writeColumnarGrid, in DataViewerColumnar.hpp)
+std::string gridJson(const GridPage& page);
+
+// options which affect how numbers are formatted (R's 'digits', 'scipen' and
+// 'OutDec' options, and whether 'digits.secs' is set)
+struct FormatOptions
+{
+   FormatOptions() : digits(7), scipen(0), outDec("."), digitsSecs(false) {}
+
+   int digits;
+   int scipen;
+   std::string outDec;
+   bool digitsSecs;
+};
+
+// reads the current format options from R
+FormatOptions formatOptions();
+
+// formats the given (0-based) rows of a data viewer column as
+// .rs.formatDataColumnRows does, reading the column's data directly (rows
+// past the end of the column are missing). handles atomic vectors, factors,
+// Dates and UTC date-times; returns false for other columns (e.g. classed or
+// list columns), which must be formatted by R
+bool formatColumn(SEXP columnSEXP,
+                  const std::vector<int>& rows,
+                  const FormatOptions& options,
+                  FormattedColumn* pColumn);
+
+// formats the row names of the given rows of a data frame as
+// .rs.formatRowNames does (rows without names are empty); returns false if
+// the object isn't a data frame
+bool formatRowNames(SEXP dataSEXP,
+                    const std::vector<int>& rows,
+                    FormattedColumn* pRowNames);
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_DATA_VIEWER_FORMAT_HPP
@@ -0,0 +1,169 @@
+/*
+ * DataViewerFormatTests.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#define R_INTERNAL_FUNCTIONS
+
+#include <tests/TestThat.hpp>
+
+#include <r/RExec.hpp>
+
+#include "DataViewerFormat.hpp"
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+SEXP evaluate(const std::string& code, r::sexp::Protect* pProtect)
+{
+   SEXP resultSEXP = R_NilValue;
+   Error error = r::exec::evaluateString(code, &resultSEXP, pProtect);
+   expect_false(error);
+   return resultSEXP;
+}
+
+// the (0-based) rows [begin, end)
+std::vector<int> rowRange(int begin, int end)
+{
+   std::vector<int> rows;
+   for (int row = begin; row < end; row++)
+      rows.push_back(row);
+   return rows;
+}
+
+// formats the given (0-based) rows of a column both natively and with
+// .rs.formatDataColumnRows, and checks they agree
+bool formatsAsR(const std::string& code, const std::vector<int>& rows)
+{
+   r::sexp::Protect protect;
+   SEXP columnSEXP = evaluate(code, &protect);
+
+   FormattedColumn column;
+   if (!formatColumn(columnSEXP, rows, formatOptions(), &column))
+      return false;
+
+   std::vector<int> rowNumbers;
+   for (int row : rows)
+      rowNumbers.push_back(row + 1);
+
+   SEXP formattedSEXP = R_NilValue;
+   Error error = r::exec::RFunction(".rs.formatDataColumnRows", columnSEXP, rowNumbers)
+         .call(&formattedSEXP, &protect);
+   if (error || TYPEOF(formattedSEXP) != STRSXP)
+      return false;
+
+   if (column.size() != static_cast<std::size_t>(Rf_xlength(formattedSEXP)))
+      return false;
+
+   for (std::size_t i = 0; i < column.size(); i++)
+   {
+      SEXP stringSEXP = STRING_ELT(formattedSEXP, i);
+      if (stringSEXP == NA_STRING)
+      {
+         if (!column.isNA(i))
+            return false;
+      }
+      else if (column.isNA(i) || column.value(i) != Rf_translateCharUTF8(stringSEXP))
+      {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+} // anonymous namespace
+
+test_context("Data viewer formatting")
+{
+   test_that("Numbers are formatted as R formats them")
+   {
+      expect_true(formatsAsR("c(1, 2.5, NA, -3.25, NaN, Inf, -Inf)", rowRange(0, 7)));
+      expect_true(formatsAsR("c(1e-20, 1, 1e20)", rowRange(0, 3)));
+      expect_true(formatsAsR("c(123456789012, 0.1)", rowRange(0, 2)));
+      expect_true(formatsAsR("c(9996, 0.5, 1/3)", rowRange(0, 3)));
+      expect_true(formatsAsR("c(1L, NA, -42L)", rowRange(0, 3)));
+      expect_true(formatsAsR("seq(0, 1, length.out = 1000)", rowRange(199, 300)));
+      expect_true(formatsAsR("c(10, 0.25, 3)", std::vector<int> { 2, 0, 1 }));
+   }
+
+   test_that("Numbers are formatted with R's decimal mark")
+   {
+      expect_false(r::exec::executeString("options(OutDec = ',')"));
+      FormatOptions options = formatOptions();
+      expect_true(options.outDec == ",");
+      bool formatted = formatsAsR("c(1.5, -0.25, 1e-20, NA)", rowRange(0, 4)) &&
+                       formatsAsR("c(1L, 20L)", rowRange(0, 2));
+      expect_false(r::exec::executeString("options(OutDec = '.')"));
+      expect_true(formatted);
+
+      r::sexp::Protect protect;
+      FormattedColumn column;
+      expect_true(formatColumn(evaluate("c(1.5, 2)", &protect), rowRange(0, 2), options, &column));
+      expect_true(column.value(0) == "1,5");
+   }
+
+   test_that("Other atomic columns are formatted as R formats them")
+   {
+      expect_true(formatsAsR("c(TRUE, NA, FALSE)", rowRange(0, 3)));
+      expect_true(formatsAsR("c('a', NA, '\\u00e9')", rowRange(0, 3)));
+      expect_true(formatsAsR("factor(c('b', NA, 'a'))", rowRange(0, 3)));
+      expect_true(formatsAsR("factor(c('lo', 'hi'), ordered = TRUE)", rowRange(0, 2)));
+      expect_true(formatsAsR("as.Date(c('1970-01-01', NA, '1899-12-31', '2400-02-29'))", rowRange(0, 4)));
+      expect_true(formatsAsR("as.POSIXct(c('2020-01-01 10:30:00', NA), tz = 'UTC')", rowRange(0, 2)));
+      expect_true(formatsAsR("as.POSIXct(c('2020-01-01', '1960-06-01'), tz = 'UTC')", rowRange(0, 2)));
+   }
+
+   test_that("Unsupported columns are left to R")
+   {
+      r::sexp::Protect protect;
+      FormattedColumn column;
+      FormatOptions options = formatOptions();
+      expect_false(formatColumn(evaluate("list(1, 'a')", &protect), rowRange(0, 2), options, &column));
+      expect_false(formatColumn(evaluate("structure(1:2, class = 'custom')", &protect), rowRange(0, 2), options, &column));
+      expect_false(formatColumn(evaluate("as.POSIXct('2020-01-01', tz = 'America/New_York')", &protect), rowRange(0, 1), options, &column));
+   }
+
+   test_that("Row names are read without expanding them")
+   {
+      r::sexp::Protect protect;
+      FormattedColumn rowNames;
+      expect_true(formatRowNames(evaluate("data.frame(x = 1:5)", &protect), rowRange(2, 4), &rowNames));
+      expect_true(rowNames.size() == 2);
+      expect_true(rowNames.value(0) == "3");
+
+      rowNames.clear();
+      expect_true(formatRowNames(evaluate("mtcars", &protect), rowRange(0, 1), &rowNames));
+      expect_true(rowNames.value(0) == "Mazda RX4");
+   }
+
+   test_that("A page of a large column is formatted as R formats it")
+   {
+      // the page is formatted without formatting (or copying) the rest of
+      // the column, but must still agree with R
+      expect_true(formatsAsR("local({ set.seed(1); runif(1e6) })", rowRange(500000, 500100)));
+   }
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
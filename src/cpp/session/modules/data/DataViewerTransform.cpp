@@ -0,0 +1,584 @@
+/*
+ * DataViewerTransform.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#define R_INTERNAL_FUNCTIONS
+
+#include "DataViewerTransform.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <boost/regex.hpp>
+#include <boost/thread.hpp>
+
+#include <shared_core/Error.hpp>
+#include <shared_core/SafeConvert.hpp>
+
+#include <core/StringUtils.hpp>
+
+#include <r/RExec.hpp>
+#include <r/RInternal.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+// the fewest rows worth handing to a thread when evaluating filters
+const std::size_t kMinRowsPerThread = 64 * 1024;
+
+// the number of bits of a sort key handled by each pass of the radix sort
+const int kRadixBits = 16;
+const std::size_t kRadixBuckets = 1 << kRadixBits;
+
+// marks the rows of an index for which a predicate (evaluated on a position
+// in the index) holds; rows already marked are skipped. large indexes are
+// split among threads, so the predicate must not call into R
+template <typename Predicate>
+void markRows(const Predicate& predicate, std::vector<char>* pMarks)
+{
+   std::vector<char>& marks = *pMarks;
+   std::size_t n = marks.size();
+   std::size_t threadCount = std::min(
+            static_cast<std::size_t>(std::max(boost::thread::hardware_concurrency(), 1u)),
+            n / kMinRowsPerThread);
+
+   if (threadCount <= 1)
+   {
+      for (std::size_t i = 0; i < n; i++)
+         marks[i] = marks[i] || predicate(i);
+      return;
+   }
+
+   boost::thread_group threads;
+   for (std::size_t thread = 0; thread < threadCount; thread++)
+   {
+      std::size_t begin = n * thread / threadCount;
+      std::size_t end = n * (thread + 1) / threadCount;
+      threads.create_thread([&predicate, &marks, begin, end]()
+      {
+         for (std::size_t i = begin; i < end; i++)
+            marks[i] = marks[i] || predicate(i);
+      });
+   }
+   threads.join_all();
+}
+
+// drops the rows of an index which aren't marked, preserving order
+void retainMarkedRows(const std::vector<char>& marks, RowIndex* pRows)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < marks.size(); i++)
+   {
+      if (marks[i])
+         (*pRows)[count++] = (*pRows)[i];
+   }
+   pRows->resize(count);
+}
+
+// whether a column is a factor whose elements we can read as level codes
+// (subclasses may have their own methods, so are left to R)
+bool isPlainFactor(SEXP columnSEXP)
+{
+   SEXP classSEXP = Rf_getAttrib(columnSEXP, R_ClassSymbol);
+   if (TYPEOF(columnSEXP) != INTSXP || TYPEOF(classSEXP) != STRSXP ||
+       TYPEOF(Rf_getAttrib(columnSEXP, R_LevelsSymbol)) != STRSXP)
+   {
+      return false;
+   }
+
+   R_xlen_t numClasses = XLENGTH(classSEXP);
+   if (numClasses == 1)
+      return std::strcmp(CHAR(STRING_ELT(classSEXP, 0)), "factor") == 0;
+   else if (numClasses == 2)
+      return std::strcmp(CHAR(STRING_ELT(classSEXP, 0)), "ordered") == 0 &&
+             std::strcmp(CHAR(STRING_ELT(classSEXP, 1)), "factor") == 0;
+   return false;
+}
+
+// marks the elements of a column matching a filter or search by evaluating
+// it in R (for those we can't evaluate natively)
+void markMatchesInR(const std::string& function,
+                    SEXP columnSEXP,
+                    const std::string& filter,
+                    const RowIndex& rows,
+                    std::vector<char>* pMarks)
+{
+   r::sexp::Protect protect;
+   SEXP matchesSEXP = R_NilValue;
+   Error error = r::exec::RFunction(function, columnSEXP, filter)
+         .call(&matchesSEXP, &protect);
+   if (error)
+      throw r::exec::RErrorException(error.getSummary());
+   if (TYPEOF(matchesSEXP) != LGLSXP)
+      throw r::exec::RErrorException("Failure to filter data");
+
+   const int* pMatches = LOGICAL(matchesSEXP);
+   R_xlen_t length = Rf_xlength(matchesSEXP);
+   markRows([&](std::size_t i)
+   {
+      return rows[i] < length && pMatches[rows[i]] == 1;
+   }, pMarks);
+}
+
+char asciiLower(char c)
+{
+   return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+// whether a (UTF-8) string contains a lower case ASCII needle, ignoring
+// case; this is how PCRE matches ASCII patterns without regard to case, save
+// for a couple of non-ASCII characters which fold to ASCII letters
+bool containsIgnoringCase(const char* value, const std::string& needle)
+{
+   for (const char* pStart = value; ; pStart++)
+   {
+      std::size_t i = 0;
+      while (i < needle.size() && pStart[i] && asciiLower(pStart[i]) == needle[i])
+         i++;
+      if (i == needle.size())
+         return true;
+      if (!*pStart)
+         return false;
+   }
+}
+
+// reads the text of a character filter or search as a lower case needle;
+// returns false if it can't be matched natively (i.e. it isn't ASCII, or it
+// would end the \Q...\E quoting R uses)
+bool readNeedle(const std::string& text, std::string* pNeedle)
+{
+   if (text.find("\\E") != std::string::npos)
+      return false;
+
+   pNeedle->clear();
+   for (char c : text)
+   {
+      if (static_cast<unsigned char>(c) >= 0x80)
+         return false;
+      pNeedle->push_back(asciiLower(c));
+   }
+   return true;
+}
+
+// marks the elements of a column containing the needle (after conversion to
+// character, as grepl does); returns false for columns we can't convert
+// natively
+bool markTextMatches(SEXP columnSEXP,
+                     const std::string& needle,
+                     const RowIndex& rows,
+                     std::vector<char>* pMarks)
+{
+   R_xlen_t length = Rf_xlength(columnSEXP);
+
+   if (isPlainFactor(columnSEXP))
+   {
+      // factors match by their levels
+      SEXP levelsSEXP = Rf_getAttrib(columnSEXP, R_LevelsSymbol);
+      R_xlen_t numLevels = XLENGTH(levelsSEXP);
+      std::vector<char> levelMatches(numLevels);
+      for (R_xlen_t i = 0; i < numLevels; i++)
+      {
+         SEXP levelSEXP = STRING_ELT(levelsSEXP, i);
+         levelMatches[i] = levelSEXP != NA_STRING &&
+               containsIgnoringCase(Rf_translateCharUTF8(levelSEXP), needle);
+      }
+
+      const int* pCodes = INTEGER(columnSEXP);
+      markRows([&](std::size_t i)
+      {
+         int code = rows[i] < length ? pCodes[rows[i]] : NA_INTEGER;
+         return code != NA_INTEGER && code >= 1 && code <= numLevels &&
+                levelMatches[code - 1];
+      }, pMarks);
+      return true;
+   }
+
+   if (OBJECT(columnSEXP))
+      return false;
+
+   switch (TYPEOF(columnSEXP))
+   {
+   case STRSXP:
+   {
+      // reading (and translating) strings may allocate, so is done up front
+      // rather than in the predicate
+      std::vector<const char*> values(rows.size());
+      for (std::size_t i = 0; i < rows.size(); i++)
+      {
+         SEXP stringSEXP = rows[i] < length ? STRING_ELT(columnSEXP, rows[i]) : NA_STRING;
+         values[i] = stringSEXP == NA_STRING ? nullptr : Rf_translateCharUTF8(stringSEXP);
+      }
+
+      markRows([&](std::size_t i)
+      {
+         return values[i] != nullptr && containsIgnoringCase(values[i], needle);
+      }, pMarks);
+      return true;
+   }
+
+   case LGLSXP:
+   {
+      bool trueMatches = containsIgnoringCase("TRUE", needle);
+      bool falseMatches = containsIgnoringCase("FALSE", needle);
+      const int* pData = LOGICAL(columnSEXP);
+      markRows([&](std::size_t i)
+      {
+         int value = rows[i] < length ? pData[rows[i]] : NA_LOGICAL;
+         return value != NA_LOGICAL && (value ? trueMatches : falseMatches);
+      }, pMarks);
+      return true;
+   }
+
+   case INTSXP:
+   {
+      const int* pData = INTEGER(columnSEXP);
+      markRows([&](std::size_t i)
+      {
+         int value = rows[i] < length ? pData[rows[i]] : NA_INTEGER;
+         if (value == NA_INTEGER)
+            return false;
+
+         char buffer[16];
+         std::snprintf(buffer, sizeof(buffer), "%d", value);
+         return containsIgnoringCase(buffer, needle);
+      }, pMarks);
+      return true;
+   }
+
+   default:
+      // e.g. doubles, whose conversion to character we don't replicate
+      return false;
+   }
+}
+
+// reads the numbers of a numeric filter value (as sent by the client, e.g.
+// "12" or "2.5_32"); returns false if they aren't in the expected form
+bool readFilterNumbers(const std::string& value, std::vector<double>* pNumbers)
+{
+   static const boost::regex reNumbers("(-?\\d+\\.?\\d*)(?:_(-?\\d+\\.?\\d*))?");
+   boost::smatch match;
+   if (!boost::regex_match(value, match, reNumbers))
+      return false;
+
+   pNumbers->push_back(safe_convert::stringTo<double>(match[1], 0));
+   if (match[2].matched)
+      pNumbers->push_back(safe_convert::stringTo<double>(match[2], 0));
+   return true;
+}
+
+// the elements of a numeric (or logical) column, read as doubles; the data
+// is located up front, so elements can be read off the main thread
+class NumericColumn
+{
+public:
+   explicit NumericColumn(SEXP columnSEXP)
+      : pReal_(nullptr),
+        pInteger_(nullptr),
+        length_(Rf_xlength(columnSEXP))
+   {
+      if (TYPEOF(columnSEXP) == REALSXP)
+         pReal_ = REAL(columnSEXP);
+      else if (TYPEOF(columnSEXP) == INTSXP)
+         pInteger_ = INTEGER(columnSEXP);
+      else if (TYPEOF(columnSEXP) == LGLSXP)
+         pInteger_ = LOGICAL(columnSEXP);
+      else
+         length_ = 0;
+   }
+
+   double at(int row) const
+   {
+      if (row >= length_)
+         return NA_REAL;
+      else if (pReal_ != nullptr)
+         return pReal_[row];
+      return pInteger_[row] == NA_INTEGER ? NA_REAL : pInteger_[row];
+   }
+
+private:
+   const double* pReal_;
+   const int* pInteger_;
+   R_xlen_t length_;
+};
+
+// marks the elements of a column matching a filter (as .rs.dataFilterMatches
+// does); returns false for filters and columns we can't evaluate natively
+bool markFilterMatches(SEXP columnSEXP,
+                       const std::string& type,
+                       const std::string& value,
+                       const RowIndex& rows,
+                       std::vector<char>* pMarks)
+{
+   NumericColumn column(columnSEXP);
+   std::vector<double> numbers;
+
+   if (type == "character")
+   {
+      std::string needle;
+      return readNeedle(value, &needle) &&
+             markTextMatches(columnSEXP, needle, rows, pMarks);
+   }
+   else if (type == "factor")
+   {
+      // factors match by level code
+      if (!isPlainFactor(columnSEXP) || !readFilterNumbers(value, &numbers) ||
+          numbers.size() != 1)
+      {
+         return false;
+      }
+
+      markRows([&](std::size_t i)
+      {
+         return column.at(rows[i]) == numbers[0];
+      }, pMarks);
+      return true;
+   }
+   else if (type == "numeric")
+   {
+      // range ("2_32") or equality ("15") filters; only finite values match
+      if (OBJECT(columnSEXP) ||
+          (TYPEOF(columnSEXP) != INTSXP && TYPEOF(columnSEXP) != REALSXP) ||
+          !readFilterNumbers(value, &numbers))
+      {
+         return false;
+      }
+
+      double min = numbers[0];
+      double max = numbers.size() > 1 ? numbers[1] : numbers[0];
+      markRows([&](std::size_t i)
+      {
+         double number = column.at(rows[i]);
+         return R_FINITE(number) && number >= min && number <= max;
+      }, pMarks);
+      return true;
+   }
+   else if (type == "boolean")
+   {
+      if (OBJECT(columnSEXP) || TYPEOF(columnSEXP) != LGLSXP)
+         return false;
+
+      double expected = value == "TRUE" ? 1 : 0;
+      markRows([&](std::size_t i)
+      {
+         return column.at(rows[i]) == expected;
+      }, pMarks);
+      return true;
+   }
+
+   return false;
+}
+
+// an order preserving key for a number, for sorting by radix; missing values
+// (NA and NaN alike, as in R's radix sort) sort last
+std::uint64_t sortKey(double value)
+{
+   if (ISNAN(value))
+      return UINT64_MAX;
+
+   // -0 and 0 are equal
+   if (value == 0)
+      value = 0;
+
+   // flip all bits of negative numbers, and the sign bit of positive ones,
+   // so that keys compare as the numbers do
+   std::uint64_t bits;
+   std::memcpy(&bits, &value, sizeof(bits));
+   const std::uint64_t kSignBit = static_cast<std::uint64_t>(1) << 63;
+   return (bits & kSignBit) ? ~bits : bits | kSignBit;
+}
+
+// reads the sort keys of the rows of a column; like order(), classed columns
+// (and character columns, which sort in the collation of the current locale)
+// are sorted by their xtfrm(), and descending sorts by negated keys
+void readSortKeys(SEXP columnSEXP,
+                  bool descending,
+                  const RowIndex& rows,
+                  std::vector<std::uint64_t>* pKeys)
+{
+   r::sexp::Protect protect;
+   SEXP keysSEXP = columnSEXP;
+   bool numeric = TYPEOF(columnSEXP) == INTSXP || TYPEOF(columnSEXP) == REALSXP ||
+                  TYPEOF(columnSEXP) == LGLSXP;
+   if (!isPlainFactor(columnSEXP) && (OBJECT(columnSEXP) || !numeric))
+   {
+      Error error = r::exec::RFunction("xtfrm", columnSEXP).call(&keysSEXP, &protect);
+      if (error)
+         throw r::exec::RErrorException(error.getSummary());
+      if (TYPEOF(keysSEXP) != INTSXP && TYPEOF(keysSEXP) != REALSXP &&
+          TYPEOF(keysSEXP) != LGLSXP)
+      {
+         throw r::exec::RErrorException("Failure to sort data");
+      }
+   }
+
+   NumericColumn keys(keysSEXP);
+   pKeys->resize(rows.size());
+   for (std::size_t i = 0; i < rows.size(); i++)
+   {
+      double value = keys.at(rows[i]);
+      (*pKeys)[i] = sortKey(descending ? -value : value);
+   }
+}
+
+// stably sorts the rows of an index by their keys (with a least significant
+// digit radix sort, skipping digits which all keys share)
+void radixSort(std::vector<std::uint64_t>* pKeys, RowIndex* pRows)
+{
+   std::size_t n = pKeys->size();
+   if (n < kRadixBuckets)
+   {
+      // not worth a radix sort
+      std::vector<std::size_t> positions(n);
+      for (std::size_t i = 0; i < n; i++)
+         positions[i] = i;
+      const std::vector<std::uint64_t>& keys = *pKeys;
+      std::stable_sort(positions.begin(), positions.end(),
+                       [&](std::size_t lhs, std::size_t rhs) { return keys[lhs] < keys[rhs]; });
+
+      RowIndex sorted(n);
+      for (std::size_t i = 0; i < n; i++)
+         sorted[i] = (*pRows)[positions[i]];
+      pRows->swap(sorted);
+      return;
+   }
+
+   std::vector<std::uint64_t> sortedKeys(n);
+   RowIndex sortedRows(n);
+   std::vector<std::size_t> offsets(kRadixBuckets);
+   for (int shift = 0; shift < 64; shift += kRadixBits)
+   {
+      std::fill(offsets.begin(), offsets.end(), 0);
+      for (std::uint64_t key : *pKeys)
+         offsets[(key >> shift) & (kRadixBuckets - 1)]++;
+
+      if (offsets[((*pKeys)[0] >> shift) & (kRadixBuckets - 1)] == n)
+         continue;
+
+      std::size_t offset = 0;
+      for (std::size_t& bucket : offsets)
+      {
+         std::size_t count = bucket;
+         bucket = offset;
+         offset += count;
+      }
+
+      for (std::size_t i = 0; i < n; i++)
+      {
+         std::uint64_t key = (*pKeys)[i];
+         std::size_t position = offsets[(key >> shift) & (kRadixBuckets - 1)]++;
+         sortedKeys[position] = key;
+         sortedRows[position] = (*pRows)[i];
+      }
+      pKeys->swap(sortedKeys);
+      pRows->swap(sortedRows);
+   }
+}
+
+} // anonymous namespace
+
+void allRows(int nrow, RowIndex* pRows)
+{
+   pRows->resize(std::max(nrow, 0));
+   for (int i = 0; i < nrow; i++)
+      (*pRows)[i] = i;
+}
+
+void filterRows(SEXP dataSEXP,
+                const std::vector<std::string>& filters,
+                const std::string& search,
+                RowIndex* pRows)
+{
+   int ncol = Rf_length(dataSEXP);
+
+   // apply columnwise filters
+   for (std::size_t i = 0; i < filters.size() && static_cast<int>(i) < ncol; i++)
+   {
+      const std::string& filter = filters[i];
+      if (filter.empty() || pRows->empty())
+         continue;
+
+      // split filter into type and value; a filter without type information
+      // is skipped
+      std::size_t separator = filter.find(kFilterSeparator);
+      if (separator == std::string::npos || separator + 1 == filter.size())
+         continue;
+      std::string type = filter.substr(0, separator);
+      std::string value = filter.substr(separator + 1);
+      value = value.substr(0, value.find(kFilterSeparator));
+
+      SEXP columnSEXP = VECTOR_ELT(dataSEXP, i);
+      std::vector<char> marks(pRows->size());
+      if (!markFilterMatches(columnSEXP, type, value, *pRows, &marks))
+         markMatchesInR(".rs.dataFilterMatches", columnSEXP, filter, *pRows, &marks);
+      retainMarkedRows(marks, pRows);
+   }
+
+   // apply global search; rows are kept if any column matches
+   if (!search.empty() && !pRows->empty())
+   {
+      std::string needle;
+      bool nativeSearch = readNeedle(search, &needle);
+
+      std::vector<char> marks(pRows->size());
+      for (int i = 0; i < ncol; i++)
+      {
+         SEXP columnSEXP = VECTOR_ELT(dataSEXP, i);
+         if (!nativeSearch || !markTextMatches(columnSEXP, needle, *pRows, &marks))
+            markMatchesInR(".rs.dataSearchMatches", columnSEXP, search, *pRows, &marks);
+      }
+      retainMarkedRows(marks, pRows);
+   }
+}
+
+void orderRows(SEXP dataSEXP,
+               const std::vector<int>& columns,
+               const std::vector<std::string>& directions,
+               RowIndex* pRows)
+{
+   if (pRows->empty())
+      return;
+
+   // sort by the last column first; since each sort is stable, rows end up
+   // ordered by the first column, with ties broken by the next, and so on
+   int ncol = Rf_length(dataSEXP);
+   for (std::size_t i = columns.size(); i-- > 0; )
+   {
+      int column = columns[i] - 1;
+      if (column < 0 || column >= ncol)
+      {
+         throw r::exec::RErrorException(
+                  string_utils::sprintf("Can't sort on column %i", columns[i]));
+      }
+
+      bool descending = i >= directions.size() || directions[i] != "asc";
+      std::vector<std::uint64_t> keys;
+      readSortKeys(VECTOR_ELT(dataSEXP, column), descending, *pRows, &keys);
+      radixSort(&keys, pRows);
+   }
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,64 @@
+/*
+ * DataViewerTransform.hpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_DATA_VIEWER_TRANSFORM_HPP
+#define SESSION_DATA_VIEWER_TRANSFORM_HPP
+
+#include <string>
+#include <vector>
+
+#include <r/RSexp.hpp>
+
+// separates filter type from contents (e.g. "numeric|12_25")
+#define kFilterSeparator "|"
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+// the rows of a data frame shown by the data viewer once it's been filtered
+// and sorted, as (0-based) row numbers in display order; views are kept as
+// indexes into the frame rather than as copies of it
+typedef std::vector<int> RowIndex;
+
+// fills the index with all rows of a frame, in their original order
+void allRows(int nrow, RowIndex* pRows);
+
+// narrows the rows of the index to those matching the column filters (indexed
+// by column; empty filters are skipped) and containing the search text in any
+// column, preserving their order. NB: may throw r::exec::RErrorException if R
+// fails to evaluate a filter we can't evaluate natively
+void filterRows(SEXP dataSEXP,
+                const std::vector<std::string>& filters,
+                const std::string& search,
+                RowIndex* pRows);
+
+// stably sorts the rows of the index by the given (1-based) columns, in the
+// given directions ("asc" or "desc"), as order() does; missing values sort
+// last. NB: may throw r::exec::RErrorException
+void orderRows(SEXP dataSEXP,
+               const std::vector<int>& columns,
+               const std::vector<std::string>& directions,
+               RowIndex* pRows);
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_DATA_VIEWER_TRANSFORM_HPP
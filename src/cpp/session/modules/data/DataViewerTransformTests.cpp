@@ -0,0 +1,184 @@
+/*
+ * DataViewerTransformTests.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#define R_INTERNAL_FUNCTIONS
+
+#include <tests/TestThat.hpp>
+
+#include <r/RExec.hpp>
+
+#include "DataViewerTransform.hpp"
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+// a frame with a few rows of each kind of column, and a frame large enough
+// that filters are evaluated on several threads
+const char* const kFrame =
+      "data.frame("
+      "  num = c(3.5, NA, -1, 0, NaN, 3.5, Inf, 2),"
+      "  int = c(2L, 1L, NA, 2L, 5L, 1L, 0L, 2L),"
+      "  chr = c('b', 'A', NA, 'apple', 'B', 'Banana', '\\u00e9t\\u00e9', 'a'),"
+      "  fct = factor(c('x', 'y', NA, 'z', 'x', 'y', 'z', 'x')),"
+      "  lgl = c(TRUE, FALSE, NA, TRUE, TRUE, FALSE, NA, TRUE),"
+      "  day = as.Date('2020-01-01') + c(3, 1, 2, NA, 0, 5, 4, 6),"
+      "  stringsAsFactors = FALSE)";
+
+const char* const kLargeFrame =
+      "local({ set.seed(42); n <- 3e5; data.frame("
+      "  num = round(runif(n, -100, 100), 1),"
+      "  chr = sample(c('alpha', 'Beta', 'gamma', NA), n, TRUE),"
+      "  stringsAsFactors = FALSE) })";
+
+SEXP evaluate(const std::string& code, r::sexp::Protect* pProtect)
+{
+   SEXP resultSEXP = R_NilValue;
+   Error error = r::exec::evaluateString(code, &resultSEXP, pProtect);
+   expect_false(error);
+   return resultSEXP;
+}
+
+// the (0-based) rows selected by an R expression (evaluated with the frame
+// bound to 'x'), e.g. an order() or which()
+RowIndex rowsInR(SEXP dataSEXP, const std::string& code)
+{
+   r::sexp::Protect protect;
+   SEXP functionSEXP = evaluate("function(x) " + code, &protect);
+
+   SEXP rowsSEXP = R_NilValue;
+   r::exec::RFunction function(functionSEXP);
+   function.addParam(dataSEXP);
+   Error error = function.call(&rowsSEXP, &protect);
+   expect_false(error);
+
+   std::vector<int> rows;
+   r::sexp::extract(rowsSEXP, &rows);
+   for (int& row : rows)
+      row--;
+   return rows;
+}
+
+RowIndex orderedRows(SEXP dataSEXP, int column, const std::string& direction)
+{
+   RowIndex rows;
+   allRows(Rf_length(VECTOR_ELT(dataSEXP, 0)), &rows);
+   orderRows(dataSEXP, std::vector<int> { column }, std::vector<std::string> { direction }, &rows);
+   return rows;
+}
+
+RowIndex filteredRows(SEXP dataSEXP,
+                      const std::vector<std::string>& filters,
+                      const std::string& search)
+{
+   RowIndex rows;
+   allRows(Rf_length(VECTOR_ELT(dataSEXP, 0)), &rows);
+   filterRows(dataSEXP, filters, search, &rows);
+   return rows;
+}
+
+} // anonymous namespace
+
+test_context("Data viewer transforms")
+{
+   r::sexp::Protect protect;
+   SEXP frameSEXP = evaluate(kFrame, &protect);
+
+   test_that("Rows are ordered as order() orders them")
+   {
+      for (int column = 1; column <= Rf_length(frameSEXP); column++)
+      {
+         std::string name = "x[[" + std::to_string(column) + "]]";
+         expect_true(orderedRows(frameSEXP, column, "asc") == rowsInR(frameSEXP, "order(" + name + ")"));
+         expect_true(orderedRows(frameSEXP, column, "desc") == rowsInR(frameSEXP, "order(-xtfrm(" + name + "))"));
+      }
+   }
+
+   test_that("Rows are ordered by several columns")
+   {
+      RowIndex rows;
+      allRows(8, &rows);
+      orderRows(frameSEXP,
+                std::vector<int> { 2, 4 },
+                std::vector<std::string> { "asc", "desc" },
+                &rows);
+      expect_true(rows == rowsInR(frameSEXP, "order(x$int, -xtfrm(x$fct))"));
+   }
+
+   test_that("Filters select the rows .rs.dataFilterMatches selects")
+   {
+      const char* filters[][2] = {
+         { "num", "numeric|0_3.5" },
+         { "num", "numeric|2" },
+         { "int", "numeric|1_2" },
+         { "chr", "character|a" },
+         { "chr", "character|\xc3\xa9" },
+         { "fct", "factor|2" },
+         { "lgl", "boolean|TRUE" },
+         { "lgl", "boolean|FALSE" },
+         { "day", "numeric|18262_18265" },
+      };
+
+      for (const auto& filter : filters)
+      {
+         SEXP namesSEXP = Rf_getAttrib(frameSEXP, R_NamesSymbol);
+         int column = 0;
+         while (std::string(CHAR(STRING_ELT(namesSEXP, column))) != filter[0])
+            column++;
+
+         std::vector<std::string> columnFilters(column + 1);
+         columnFilters[column] = filter[1];
+         std::string expected = "which(.rs.dataFilterMatches(x$" + std::string(filter[0]) +
+               ", '" + filter[1] + "'))";
+         expect_true(filteredRows(frameSEXP, columnFilters, "") == rowsInR(frameSEXP, expected));
+      }
+   }
+
+   test_that("Searches select rows with a match in any column")
+   {
+      const char* searches[] = { "a", "NA", "2", "TRU", "3.5", "2020-01-0", "\xc3\xa9" };
+      for (const char* search : searches)
+      {
+         std::string expected = std::string("which(Reduce('|', lapply(x, .rs.dataSearchMatches, '") +
+               search + "')))";
+         expect_true(filteredRows(frameSEXP, std::vector<std::string>(), search) ==
+                     rowsInR(frameSEXP, expected));
+      }
+   }
+
+   test_that("Large frames are filtered and ordered as R does")
+   {
+      SEXP largeSEXP = evaluate(kLargeFrame, &protect);
+
+      RowIndex rows = filteredRows(largeSEXP, std::vector<std::string> { "numeric|-50_50", "character|a" }, "");
+      orderRows(largeSEXP, std::vector<int> { 1 }, std::vector<std::string> { "desc" }, &rows);
+
+      expect_true(rows == rowsInR(largeSEXP,
+         "local({ i <- which(.rs.dataFilterMatches(x$num, 'numeric|-50_50') & "
+         "  .rs.dataFilterMatches(x$chr, 'character|a')); i[order(-x$num[i])] })"));
+   }
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -13,10 +13,18 @@
  *
  */
 
+#define R_INTERNAL_FUNCTIONS
+
 #include "EnvironmentMonitor.hpp"
 
+#include <algorithm>
+
+#include <boost/bind/bind.hpp>
+#include <boost/functional/hash.hpp>
+
 #include <r/RSexp.hpp>
 #include <r/RInterface.hpp>
+#include <r/RInternal.hpp>
 #include <session/SessionModuleContext.hpp>
 #include <session/prefs/UserPrefs.hpp>
 
@@ -30,11 +38,11 @@ namespace modules {
 namespace environment {
 namespace {
 
-bool compareVarName(const r::sexp::Variable& var1,
-                    const r::sexp::Variable& var2)
-{
-   return var1.first < var2.first;
-}
+// how long to spend describing changed objects when changes are detected;
+// describing an object runs R code, so when many change at once (e.g. when a
+// workspace is loaded) the rest are described in increments while idle
+const boost::posix_time::time_duration kDescribeDuration =
+      boost::posix_time::milliseconds(200);
 
 void enqueRefreshEvent()
 {
@@ -42,54 +50,87 @@ void enqueRefreshEvent()
    module_context::enqueClientEvent(refreshEvent);
 }
 
-// if the given variable is an unevaluated promise, add it to the given
-// list of variables
-void addUnevaledPromise(std::vector<r::sexp::Variable>* pEnv,
-                        const r::sexp::Variable& var)
-{
-   if (isUnevaluatedPromise(var.second))
-   {
-      pEnv->push_back(var);
-   }
-}
+} // anonymous namespace
+
+EnvironmentMonitor::Binding::Binding() :
+   value(R_NilValue),
+   attributes(R_NilValue),
+   length(0),
+   unevaluatedPromise(false),
+   active(false)
+{}
 
-// If the given variable exists in the given list, remove it. Compares on name
-// only.
-void removeVarFromList(std::vector<r::sexp::Variable>* pEnv,
-                       const r::sexp::Variable& var)
+EnvironmentMonitor::Binding::Binding(SEXP valueSEXP, bool isActive) :
+   value(valueSEXP),
+   attributes(ATTRIB(valueSEXP)),
+   length(Rf_isVector(valueSEXP) ? XLENGTH(valueSEXP) : 0),
+   unevaluatedPromise(isUnevaluatedPromise(valueSEXP)),
+   active(isActive)
+{}
+
+bool EnvironmentMonitor::Binding::operator==(const Binding& other) const
 {
-   for (std::vector<r::sexp::Variable>::iterator iter = pEnv->begin();
-        iter != pEnv->end(); iter++)
-   {
-      if (iter->first == var.first)
-      {
-         pEnv->erase(iter);
-         break;
-      }
-   }
+   return value == other.value &&
+          attributes == other.attributes &&
+          length == other.length &&
+          unevaluatedPromise == other.unevaluatedPromise &&
+          active == other.active;
 }
 
-} // anonymous namespace
-
 EnvironmentMonitor::EnvironmentMonitor() :
+   lastCount_(0),
+   lastFingerprint_(0),
+   describingPending_(false),
    initialized_(false),
    refreshOnInit_(false)
 {}
 
-void EnvironmentMonitor::enqueRemovedEvent(const r::sexp::Variable& variable)
+void EnvironmentMonitor::enqueRemovedEvent(const std::string& name)
 {
-   ClientEvent removedEvent(client_events::kEnvironmentRemoved, variable.first);
+   ClientEvent removedEvent(client_events::kEnvironmentRemoved, name);
    module_context::enqueClientEvent(removedEvent);
 }
 
-void EnvironmentMonitor::enqueAssignedEvent(const r::sexp::Variable& variable)
+void EnvironmentMonitor::enqueAssignedEvents(const std::vector<std::string>& names)
 {
-   // get object info
-   json::Value objInfo = varToJson(getMonitoredEnvironment(), variable);
+   pendingAssigned_.insert(names.begin(), names.end());
+   if (pendingAssigned_.empty() || describingPending_)
+      return;
+
+   describingPending_ = true;
+   module_context::scheduleIncrementalWork(
+            kDescribeDuration,
+            kDescribeDuration,
+            boost::bind(&EnvironmentMonitor::enqueNextAssignedEvent, this));
+}
+
+bool EnvironmentMonitor::enqueNextAssignedEvent()
+{
+   if (!pendingAssigned_.empty())
+   {
+      std::string name = *pendingAssigned_.begin();
+      pendingAssigned_.erase(pendingAssigned_.begin());
+
+      // look up the object again, since describing others may have changed
+      // or removed it
+      r::sexp::Protect protect;
+      SEXP valueSEXP = bindingValue(name);
+      if (valueSEXP != R_UnboundValue)
+      {
+         protect.add(valueSEXP);
+
+         // get object info
+         json::Value objInfo = varToJson(getMonitoredEnvironment(),
+                                         std::make_pair(name, valueSEXP));
+
+         // enque event
+         ClientEvent assignedEvent(client_events::kEnvironmentAssigned, objInfo);
+         module_context::enqueClientEvent(assignedEvent);
+      }
+   }
 
-   // enque event
-   ClientEvent assignedEvent(client_events::kEnvironmentAssigned, objInfo);
-   module_context::enqueClientEvent(assignedEvent);
+   describingPending_ = !pendingAssigned_.empty();
+   return describingPending_;
 }
 
 void EnvironmentMonitor::setMonitoredEnvironment(SEXP pEnvironment,
@@ -104,6 +145,7 @@ void EnvironmentMonitor::setMonitoredEnvironment(SEXP pEnvironment,
    // init the environment by doing an initial check for changes
    initialized_ = false;
    refreshOnInit_ = refresh;
+   pendingAssigned_.clear();
    checkForChanges();
 }
 
@@ -118,127 +160,161 @@ bool EnvironmentMonitor::hasEnvironment()
    return envir != nullptr && r::sexp::isPrimitiveEnvironment(envir);
 }
 
-void EnvironmentMonitor::listEnv(std::vector<r::sexp::Variable>* pEnv)
+void EnvironmentMonitor::listFrame(Frame* pFrame, std::size_t* pFingerprint)
 {
+   *pFingerprint = 0;
    if (!hasEnvironment())
       return;
 
-   r::sexp::Protect rProtect;
-   r::sexp::listEnvironment(getMonitoredEnvironment(),
-                            false,
-                            prefs::userPrefs().showLastDotValue(),
-                            &rProtect,
-                            pEnv);
+   // list the names in the environment; they needn't be sorted since
+   // bindings are compared by name
+   SEXP envSEXP = getMonitoredEnvironment();
+   r::sexp::Protect protect;
+   SEXP namesSEXP = R_NilValue;
+   protect.add(namesSEXP = R_lsInternal3(envSEXP, FALSE, FALSE));
+
+   int n = Rf_length(namesSEXP);
+   pFrame->reserve(n + 1);
+   for (int i = 0; i < n; i++)
+   {
+      SEXP symbolSEXP = Rf_installChar(STRING_ELT(namesSEXP, i));
+
+      // merely reading an active binding fires it, so these are listed
+      // without their values (as r::sexp::listEnvironment lists them)
+      SEXP valueSEXP = R_NilValue;
+      bool active = R_BindingIsActive(symbolSEXP, envSEXP);
+      if (!active)
+         valueSEXP = Rf_findVarInFrame(envSEXP, symbolSEXP);
+
+      if (valueSEXP != R_UnboundValue) // should never be unbound
+         pFrame->push_back(std::make_pair(PRINTNAME(symbolSEXP), Binding(valueSEXP, active)));
+   }
+
+   // add in .Last.value if it's shown (it lives in the base environment)
+   if (prefs::userPrefs().showLastDotValue())
+   {
+      SEXP symbolSEXP = Rf_install(".Last.value");
+      SEXP valueSEXP = Rf_findVar(symbolSEXP, envSEXP);
+      if (valueSEXP != R_UnboundValue)
+         pFrame->push_back(std::make_pair(PRINTNAME(symbolSEXP), Binding(valueSEXP, false)));
+   }
+
+   // the frame's fingerprint combines those of its bindings, in any order
+   for (const auto& binding : *pFrame)
+   {
+      std::size_t hash = 0;
+      boost::hash_combine(hash, binding.first);
+      boost::hash_combine(hash, binding.second.value);
+      boost::hash_combine(hash, binding.second.attributes);
+      boost::hash_combine(hash, binding.second.length);
+      boost::hash_combine(hash, binding.second.unevaluatedPromise);
+      boost::hash_combine(hash, binding.second.active);
+      *pFingerprint += hash;
+   }
 }
 
-void EnvironmentMonitor::checkForChanges()
+SEXP EnvironmentMonitor::bindingValue(const std::string& name)
 {
-   // information about the current environment
-   std::vector<r::sexp::Variable> currentEnv;
-   std::vector<r::sexp::Variable> currentPromises;
-
-   // list of assigns/removes (includes both value changes and promise
-   // evaluations)
-   std::vector<r::sexp::Variable> addedVars;
-   std::vector<r::sexp::Variable> removedVars;
+   if (!hasEnvironment())
+      return R_UnboundValue;
+
+   SEXP envSEXP = getMonitoredEnvironment();
+   SEXP symbolSEXP = Rf_install(name.c_str());
+   if (name == ".Last.value")
+      return Rf_findVar(symbolSEXP, envSEXP);
+
+   // the bindings listed when changes were last checked for tell which are
+   // active without asking R (R_BindingIsActive errors for unbound symbols,
+   // and R_existsVarInFrame is only available from R 4.2). a regular
+   // binding can't be made active without first being removed, so any
+   // other binding is safely read (being unbound if it's since been removed)
+   auto binding = lastBindings_.find(name);
+   if (binding == lastBindings_.end())
+      return R_UnboundValue;
+   else if (binding->second.active)
+      return R_NilValue;
+   else
+      return Rf_findVarInFrame(envSEXP, symbolSEXP);
+}
 
-   // get the set of variables and promises in the current environment
-   listEnv(&currentEnv);
+void EnvironmentMonitor::checkForChanges()
+{
+   // list the bindings in the current environment
+   Frame frame;
+   std::size_t fingerprint = 0;
+   listFrame(&frame, &fingerprint);
+
+   // if no binding has been added, removed, assigned, or forced since we
+   // last checked (as is usual), there's nothing more to do
+   if (initialized_ &&
+       frame.size() == lastCount_ &&
+       fingerprint == lastFingerprint_)
+   {
+      return;
+   }
 
-   // R returns an environment list sorted in dictionary order. Since the
-   // set difference algorithms below use simple string comparisons to
-   // establish order, we need to re-sort the list into canonical order
-   // to avoid the algorithms detecting superfluous insertions.
-   std::sort(currentEnv.begin(), currentEnv.end(), compareVarName);
+   Bindings currentBindings;
+   currentBindings.reserve(frame.size());
+   for (const auto& binding : frame)
+      currentBindings[Rf_translateChar(binding.first)] = binding.second;
 
-   std::for_each(currentEnv.begin(), currentEnv.end(),
-                 boost::bind(addUnevaledPromise, &currentPromises, _1));
+   // list of removes and assigns (includes both value changes and promise
+   // evaluations)
+   std::vector<std::string> removedVars;
+   std::vector<std::string> assignedVars;
 
-   bool refreshEnqueued = false;
    if (!initialized_)
    {
       if (refreshOnInit_ ||
           getMonitoredEnvironment() == R_GlobalEnv)
       {
          enqueRefreshEvent();
-         refreshEnqueued = true;
       }
       initialized_ = true;
       refreshOnInit_ = false;
    }
+   // optimize for empty currentBindings (user reset workspace) or empty
+   // lastBindings_ (startup) by just sending a single refresh event
+   // only do this for the global environment--while debugging local
+   // environments, the environment object list is sent down as part of
+   // the context depth event.
+   else if ((currentBindings.empty() || lastBindings_.empty())
+            && getMonitoredEnvironment() == R_GlobalEnv)
+   {
+      // the refresh describes every object
+      enqueRefreshEvent();
+      pendingAssigned_.clear();
+   }
    else
    {
-      if (currentEnv != lastEnv_)
+      for (const auto& binding : lastBindings_)
       {
-         // optimize for empty currentEnv (user reset workspace) or empty
-         // lastEnv_ (startup) by just sending a single refresh event
-         // only do this for the global environment--while debugging local
-         // environments, the environment object list is sent down as part of
-         // the context depth event.
-         if ((currentEnv.empty() || lastEnv_.empty())
-             && getMonitoredEnvironment() == R_GlobalEnv)
-         {
-            enqueRefreshEvent();
-            refreshEnqueued = true;
-         }
-         else
-         {
-            std::set_difference(lastEnv_.begin(), lastEnv_.end(),
-                                currentEnv.begin(), currentEnv.end(),
-                                std::back_inserter(removedVars),
-                                compareVarName);
-
-            // fire removed event for deletes
-            std::for_each(removedVars.begin(),
-                          removedVars.end(),
-                          boost::bind(&EnvironmentMonitor::enqueRemovedEvent,
-                                      this, _1));
-
-            // remove deleted objects from the list of uneval'ed promises
-            // so we'll stop monitoring them for evaluation
-            std::for_each(removedVars.begin(),
-                          removedVars.end(),
-                          boost::bind(removeVarFromList, &unevaledPromises_, _1));
-
-            // find adds & assigns (all variable name/value combinations in the
-            // current environment but NOT in the previous environment)
-            std::set_difference(currentEnv.begin(), currentEnv.end(),
-                                lastEnv_.begin(), lastEnv_.end(),
-                                std::back_inserter(addedVars));
-
-            // remove assigned objects from the list of uneval'ed promises
-            // (otherwise, we double-assign in the case where a promise SEXP
-            // is simultaneously forced/evaluated and assigned a new value)
-            std::for_each(addedVars.begin(),
-                          addedVars.end(),
-                          boost::bind(removeVarFromList, &unevaledPromises_, _1));
-
-         }
+         if (currentBindings.find(binding.first) == currentBindings.end())
+            removedVars.push_back(binding.first);
       }
-      // if a refresh is scheduled there's no need to emit add events one by one
-      if (!refreshEnqueued)
+
+      for (const auto& binding : currentBindings)
       {
-         // have any promises been evaluated since we last checked?
-         if (currentPromises != unevaledPromises_)
-         {
-            // for each promise that is in the set of promises we are monitoring
-            // for evaluation but not in the set of currently tracked promises,
-            // we assume this to be an eval--process as an assign
-            std::set_difference(unevaledPromises_.begin(), unevaledPromises_.end(),
-                                currentPromises.begin(), currentPromises.end(),
-                                std::back_inserter(addedVars));
-         }
-
-         // fire assigned event for adds, assigns, and promise evaluations
-         std::for_each(addedVars.begin(),
-                       addedVars.end(),
-                       boost::bind(&EnvironmentMonitor::enqueAssignedEvent,
-                                    this, _1));
+         auto last = lastBindings_.find(binding.first);
+         if (last == lastBindings_.end() || last->second != binding.second)
+            assignedVars.push_back(binding.first);
+      }
+
+      // fire removed event for deletes (and stop describing them)
+      std::sort(removedVars.begin(), removedVars.end());
+      for (const std::string& name : removedVars)
+      {
+         pendingAssigned_.erase(name);
+         enqueRemovedEvent(name);
       }
    }
 
-   unevaledPromises_ = currentPromises;
-   lastEnv_ = currentEnv;
+   lastBindings_.swap(currentBindings);
+   lastCount_ = frame.size();
+   lastFingerprint_ = fingerprint;
+
+   // fire assigned event for adds, assigns, and promise evaluations
+   enqueAssignedEvents(assignedVars);
 }
 
 } // namespace environment
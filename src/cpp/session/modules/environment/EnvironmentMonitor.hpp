@@ -13,6 +13,13 @@
  *
  */
 
+#include <cstddef>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include <r/RSexp.hpp>
 #include <r/RInterface.hpp>
 
@@ -30,17 +37,53 @@ class EnvironmentMonitor : boost::noncopyable
 {
 public:
    EnvironmentMonitor();
+   virtual ~EnvironmentMonitor() {}
    void setMonitoredEnvironment(SEXP pEnvironment, bool refresh = false);
    SEXP getMonitoredEnvironment();
    bool hasEnvironment();
    void checkForChanges();
+
+protected:
+   // the value of the named binding (R_NilValue for an active binding), or
+   // R_UnboundValue if there is none; only bindings listed when changes were
+   // last checked for are found
+   SEXP bindingValue(const std::string& name);
+
+   // overridden in tests to observe the changes found
+   virtual void enqueRemovedEvent(const std::string& name);
+   virtual void enqueAssignedEvents(const std::vector<std::string>& names);
+
 private:
-   void listEnv(std::vector<r::sexp::Variable>* pEnvironment);
-   void enqueRemovedEvent(const r::sexp::Variable& variable);
-   void enqueAssignedEvent(const r::sexp::Variable& variable);
+   // what can be cheaply observed of a binding's value: assigning a new
+   // value, changing its attributes or length in place, or forcing a promise
+   // all change it (active bindings are listed without their values)
+   struct Binding
+   {
+      Binding();
+      Binding(SEXP valueSEXP, bool isActive);
+
+      bool operator==(const Binding& other) const;
+      bool operator!=(const Binding& other) const { return !(*this == other); }
+
+      SEXP value;
+      SEXP attributes;
+      R_xlen_t length;
+      bool unevaluatedPromise;
+      bool active;
+   };
+
+   // the bindings of the environment, by name (as CHARSXPs when listed)
+   typedef std::vector<std::pair<SEXP, Binding> > Frame;
+   typedef std::unordered_map<std::string, Binding> Bindings;
+
+   void listFrame(Frame* pFrame, std::size_t* pFingerprint);
+   bool enqueNextAssignedEvent();
 
-   std::vector<r::sexp::Variable> lastEnv_;
-   std::vector<r::sexp::Variable> unevaledPromises_;
+   Bindings lastBindings_;
+   std::size_t lastCount_;
+   std::size_t lastFingerprint_;
+   std::set<std::string> pendingAssigned_;
+   bool describingPending_;
    r::sexp::PreservedSEXP environment_;
    bool initialized_;
    bool refreshOnInit_;
@@ -0,0 +1,169 @@
+/*
+ * EnvironmentMonitorTests.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <r/RExec.hpp>
+#include <r/RSexp.hpp>
+
+#include "EnvironmentMonitor.hpp"
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace environment {
+
+using namespace core;
+
+namespace {
+
+// records the changes found rather than sending them to the client
+// (.Last.value, which lives in the base environment, is ignored)
+class RecordingMonitor : public EnvironmentMonitor
+{
+public:
+   using EnvironmentMonitor::bindingValue;
+
+   void clear()
+   {
+      removed.clear();
+      assigned.clear();
+   }
+
+   std::vector<std::string> removed;
+   std::vector<std::string> assigned;
+
+protected:
+   void enqueRemovedEvent(const std::string& name)
+   {
+      if (name != ".Last.value")
+         removed.push_back(name);
+   }
+
+   void enqueAssignedEvents(const std::vector<std::string>& names)
+   {
+      for (const std::string& name : names)
+      {
+         if (name != ".Last.value")
+            assigned.push_back(name);
+      }
+   }
+};
+
+void evaluate(const std::string& code, SEXP envSEXP)
+{
+   r::sexp::Protect protect;
+   SEXP resultSEXP = R_NilValue;
+   expect_false(r::exec::executeStringUnsafe(code, envSEXP, &resultSEXP, &protect));
+}
+
+} // anonymous namespace
+
+test_context("Environment monitor")
+{
+   // each test starts from a newly monitored environment holding a and b
+   r::sexp::Protect protect;
+   SEXP envSEXP = R_NilValue;
+   expect_false(r::exec::evaluateString("new.env()", &envSEXP, &protect));
+
+   RecordingMonitor monitor;
+   monitor.setMonitoredEnvironment(envSEXP);
+   evaluate("a <- 1; b <- 'b'", envSEXP);
+   monitor.checkForChanges();
+   std::sort(monitor.assigned.begin(), monitor.assigned.end());
+   expect_true(monitor.assigned == std::vector<std::string>({ "a", "b" }));
+   monitor.clear();
+
+   test_that("Nothing is reported when nothing has changed")
+   {
+      monitor.checkForChanges();
+      expect_true(monitor.removed.empty());
+      expect_true(monitor.assigned.empty());
+
+      // reading a binding doesn't change it
+      evaluate("invisible(a + 1)", envSEXP);
+      monitor.checkForChanges();
+      expect_true(monitor.assigned.empty());
+   }
+
+   test_that("Changed values are reported as assigned")
+   {
+      evaluate("a <- 2; names(b) <- 'name'", envSEXP);
+      monitor.checkForChanges();
+      std::sort(monitor.assigned.begin(), monitor.assigned.end());
+      expect_true(monitor.assigned == std::vector<std::string>({ "a", "b" }));
+      expect_true(monitor.removed.empty());
+   }
+
+   test_that("Removed bindings are reported")
+   {
+      evaluate("rm(a)", envSEXP);
+      monitor.checkForChanges();
+      expect_true(monitor.removed == std::vector<std::string>({ "a" }));
+      expect_true(monitor.assigned.empty());
+   }
+
+   test_that("Renamed bindings are reported as removed and assigned")
+   {
+      evaluate("c <- b; rm(b)", envSEXP);
+      monitor.checkForChanges();
+      expect_true(monitor.removed == std::vector<std::string>({ "b" }));
+      expect_true(monitor.assigned == std::vector<std::string>({ "c" }));
+   }
+
+   test_that("Forcing a promise is reported as an assignment")
+   {
+      evaluate("delayedAssign('p', 42)", envSEXP);
+      monitor.checkForChanges();
+      expect_true(monitor.assigned == std::vector<std::string>({ "p" }));
+      monitor.clear();
+
+      evaluate("invisible(p)", envSEXP);
+      monitor.checkForChanges();
+      expect_true(monitor.assigned == std::vector<std::string>({ "p" }));
+      monitor.clear();
+
+      monitor.checkForChanges();
+      expect_true(monitor.assigned.empty());
+   }
+
+   test_that("Bindings are looked up without firing active bindings")
+   {
+      evaluate("fired <- FALSE; makeActiveBinding('active', function() fired <<- TRUE, environment())",
+               envSEXP);
+      monitor.checkForChanges();
+      std::sort(monitor.assigned.begin(), monitor.assigned.end());
+      expect_true(monitor.assigned == std::vector<std::string>({ "active", "fired" }));
+
+      expect_true(monitor.bindingValue("active") == R_NilValue);
+      expect_true(monitor.bindingValue("missing") == R_UnboundValue);
+      expect_true(monitor.bindingValue("a") != R_UnboundValue);
+
+      // bindings removed since the last check are unbound
+      evaluate("rm(a)", envSEXP);
+      expect_true(monitor.bindingValue("a") == R_UnboundValue);
+
+      expect_false(r::sexp::asLogical(r::sexp::findVar("fired", envSEXP)));
+   }
+}
+
+} // namespace environment
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -15,10 +15,12 @@
 
 #include <session/jobs/Job.hpp>
 
+#include <algorithm>
 #include <ctime>
 
 #include <boost/make_shared.hpp>
 #include <core/json/JsonRpc.hpp>
+#include <shared_core/SafeConvert.hpp>
 
 #include <session/SessionModuleContext.hpp>
 
@@ -54,6 +56,20 @@ namespace session {
 namespace modules { 
 namespace jobs {
 
+namespace {
+
+// number of lines of output between entries in the output index
+const int kOutputIndexInterval = 256;
+
+// maximum amount of output replayed to the client in one request; older
+// output is omitted (with a note saying so) beyond this
+const uintmax_t kMaxOutputReplaySize = 8 * 1024 * 1024;
+
+// maximum number of lines of omitted output paged in by one request
+const int kMaxOutputPageLines = 4096;
+
+} // anonymous namespace
+
 Job::Job(const std::string& id,
          time_t recorded,
          time_t started,
@@ -92,7 +108,10 @@ Job::Job(const std::string& id,
    show_(show),
    actions_(actions),
    cppActions_(cppActions),
-   tags_(tags)
+   tags_(tags),
+   outputLines_(0),
+   outputSize_(0),
+   outputIndexed_(false)
 {
    setState(state);
 }
@@ -110,7 +129,10 @@ Job::Job():
    listening_(false),
    saveOutput_(true),
    show_(true),
-   actions_(R_NilValue)
+   actions_(R_NilValue),
+   outputLines_(0),
+   outputSize_(0),
+   outputIndexed_(false)
 {
 }
 
@@ -127,6 +149,7 @@ Error Job::reset()
 
    // remove the stored output (cache) from the previous run
    outputCacheFile().removeIfExists();
+   clearOutputIndex();
 
    // emit a formfeed as job output if the client is listening so that output from the previous run
    // is cleared
@@ -461,6 +484,9 @@ void Job::addOutput(const std::string& output, bool asError)
       }
    }
 
+   // make sure we know where existing output ends before adding to it
+   indexOutput();
+
    // open output file for writing
    std::shared_ptr<std::ostream> file;
    error = outputFile.openForWrite(file, false /* don't truncate */);
@@ -470,20 +496,130 @@ void Job::addOutput(const std::string& output, bool asError)
       return;
    }
 
-   // create json array with output and write it to the file
+   // create json array with output and write it to the file (the file is
+   // newline-delimited JSON)
    json::Array contents;
    contents.push_back(type);
    contents.push_back(output);
-   contents.write(*file);
+   std::string line = contents.write() + "\n";
+   *file << line;
+   file->flush();
+   if (file->fail())
+   {
+      LOG_ERROR(systemError(boost::system::errc::io_error, ERROR_LOCATION));
+      clearOutputIndex();
+      return;
+   }
 
-   // append a newline (the file is newline-delimited JSON)
-   *file << std::endl;
+   // index the line
+   if (outputLines_ % kOutputIndexInterval == 0)
+      outputIndex_.push_back(outputSize_);
+   outputLines_++;
+   outputSize_ += line.size();
+}
+
+void Job::clearOutputIndex()
+{
+   outputIndex_.clear();
+   outputLines_ = 0;
+   outputSize_ = 0;
+   outputIndexed_ = false;
+}
+
+void Job::indexOutput()
+{
+   if (outputIndexed_)
+      return;
+
+   clearOutputIndex();
+   outputIndexed_ = true;
+
+   FilePath outputFile = outputCacheFile();
+   std::shared_ptr<std::istream> pIfs;
+   Error error = outputFile.openForRead(pIfs);
+   if (error)
+   {
+      // path not found is expected if the job hasn't produced any output yet
+      if (!isPathNotFoundError(error))
+         LOG_ERROR(error);
+      return;
+   }
+
+   try
+   {
+      // reading eof can trigger a failbit
+      pIfs->exceptions(std::istream::badbit);
+
+      std::string content;
+      while (std::getline(*pIfs, content))
+      {
+         if (outputLines_ % kOutputIndexInterval == 0)
+            outputIndex_.push_back(outputSize_);
+         outputLines_++;
+         outputSize_ += content.size() + (pIfs->eof() ? 0 : 1);
+      }
+   }
+   catch(const std::exception& e)
+   {
+      error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      error.addProperty("path", outputFile.getAbsolutePath());
+      LOG_ERROR(error);
+   }
 }
 
 json::Array Job::output(int position)
 {
-   // read the lines from the file
    json::Array output;
+   indexOutput();
+   if (position < 0)
+      position = 0;
+   if (position >= outputLines_)
+      return output;
+
+   // if there's more output than we're willing to replay, skip ahead to the
+   // first indexed line which brings it under the limit; the omitted lines
+   // can be paged in with outputBefore
+   int line = position;
+   std::size_t chunk = static_cast<std::size_t>(line / kOutputIndexInterval);
+   while (chunk + 1 < outputIndex_.size() &&
+          outputSize_ - outputIndex_[chunk] > kMaxOutputReplaySize)
+   {
+      chunk++;
+      line = static_cast<int>(chunk) * kOutputIndexInterval;
+   }
+
+   if (line > position)
+   {
+      json::Array omitted;
+      omitted.push_back(module_context::kCompileOutputNormal);
+      omitted.push_back("[ " + safe_convert::numberToString(line - position) +
+                        " earlier lines of output omitted ]\n");
+      output.push_back(omitted);
+   }
+
+   readOutput(line, outputLines_, &output);
+   return output;
+}
+
+json::Array Job::outputBefore(int before, int count)
+{
+   json::Array output;
+   indexOutput();
+   before = std::min(before, outputLines_);
+   count = std::min(count, kMaxOutputPageLines);
+   if (before <= 0 || count <= 0)
+      return output;
+
+   readOutput(std::max(before - count, 0), before, &output);
+   return output;
+}
+
+void Job::readOutput(int begin, int end, json::Array* pOutput)
+{
+   // read the lines from the file, starting from the indexed line
+   // preceding the first one sought
    FilePath outputFile = outputCacheFile();
    std::shared_ptr<std::istream> pIfs;
    Error error = outputFile.openForRead(pIfs);
@@ -492,28 +628,33 @@ json::Array Job::output(int position)
       // path not found is expected if the job hasn't produced any output yet
       if (!isPathNotFoundError(error))
          LOG_ERROR(error);
-      return json::Array();
+      return;
    }
 
+   std::size_t chunk = static_cast<std::size_t>(begin / kOutputIndexInterval);
+   if (chunk >= outputIndex_.size())
+      return;
+
    try
    {
-      int line = 0;
       std::string content;
       json::Value val;
 
       // reading eof can trigger a failbit
       pIfs->exceptions(std::istream::badbit);
 
-      // read each line; parse it as JSON and add it to the output array if it's past the sought
-      // position
-      while (!pIfs->eof())
+      pIfs->seekg(static_cast<std::streamoff>(outputIndex_[chunk]));
+      int line = static_cast<int>(chunk) * kOutputIndexInterval;
+
+      // read each line; parse it as JSON and add it to the output array if
+      // it's in the sought range
+      while (line < end && std::getline(*pIfs, content))
       {
-         std::getline(*pIfs, content);
-         if (++line > position)
+         if (line++ >= begin)
          {
             if (!val.parse(content))
             {
-               output.push_back(val);
+               pOutput->push_back(val);
             }
          }
       }
@@ -526,13 +667,12 @@ json::Array Job::output(int position)
       error.addProperty("path", outputFile.getAbsolutePath());
       LOG_ERROR(error);
    }
-
-   return output;
 }
 
 void Job::cleanup()
 {
    outputCacheFile().removeIfExists();
+   clearOutputIndex();
 }
 
 std::string Job::stateAsString(JobState state)
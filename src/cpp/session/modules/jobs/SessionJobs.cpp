@@ -331,6 +331,26 @@ Error jobOutput(const json::JsonRpcRequest& request,
    return Success();
 }
 
+Error jobOutputBefore(const json::JsonRpcRequest& request,
+                      json::JsonRpcResponse* pResponse)
+{
+   // extract job ID and the page of output sought
+   std::string id;
+   int before, count;
+   Error error = json::readParams(request.params, &id, &before, &count);
+   if (error)
+      return error;
+
+   // look up in cache
+   boost::shared_ptr<Job> pJob;
+   if (!lookupJob(id, &pJob))
+      return Error(json::errc::ParamInvalid, ERROR_LOCATION);
+
+   pResponse->setResult(pJob->outputBefore(before, count));
+
+   return Success();
+}
+
 Error runScriptJob(const json::JsonRpcRequest& request,
                    json::JsonRpcResponse* pResponse)
 {
@@ -500,6 +520,7 @@ core::Error initialize()
    initBlock.addFunctions()
       (bind(module_context::registerRpcMethod, "get_jobs", getJobs))
       (bind(module_context::registerRpcMethod, "job_output", jobOutput))
+      (bind(module_context::registerRpcMethod, "job_output_before", jobOutputBefore))
       (bind(module_context::registerRpcMethod, "set_job_listening", setJobListening))
       (bind(module_context::registerRpcMethod, "run_script_job", runScriptJob))
       (bind(module_context::registerRpcMethod, "clear_jobs", clearJobs))
@@ -52,12 +52,16 @@ class Worker : public ppe::Worker
    
    void onWork(const std::string& pkgName, const FilePath& pkgPath)
    {
+      // skip packages without a template folder
+      if (!ppe::packageResourceExists(pkgPath, "rmarkdown/templates"))
+         return;
+
       // form the path to the template folder
       FilePath templateRoot = pkgPath.completePath("rmarkdown")
                                      .completePath("templates");
 
-      // skip if this folder doesn't exist or isn't a directory
-      if (!templateRoot.exists() || !templateRoot.isDirectory())
+      // skip if this folder isn't a directory
+      if (!templateRoot.isDirectory())
          return;
 
       // get a list of all template folders under the root
@@ -498,7 +498,7 @@ void onDeferredInit(bool)
    {     
       // index docs
       std::vector<boost::shared_ptr<source_database::SourceDocument> > pDocs;
-      Error error = source_database::list(&pDocs);
+      Error error = source_database::list(&pDocs, false);
       if (error)
          LOG_ERROR(error);
       std::for_each(pDocs.begin(), pDocs.end(), onSourceDocUpdated);
@@ -249,6 +249,113 @@
     if (rsGridData) rsGridData.style.display = "none";
   };
 
+  // show an error returned by the server when fetching data
+  var showDataError = function (responseText, fallback) {
+    if (responseText[0] !== "{") showError(responseText);
+    else {
+      var result = $.parseJSON(responseText);
+      if (result.error) {
+        showError(result.error);
+      } else {
+        showError(fallback);
+      }
+    }
+  };
+
+  // the content type of grid pages in the columnar format (see
+  // DataViewerColumnar.hpp); we ask for it when we can decode it
+  var columnarContentType = "application/vnd.rstudio.grid-columnar";
+  var canDecodeColumnar =
+    typeof TextDecoder !== "undefined" && typeof DataView !== "undefined";
+
+  // the text of a number whose digits (read as an integer) are given, with the
+  // given number of decimal places
+  var numberText = function (digits, decimals) {
+    var text = Math.abs(digits).toString();
+    if (decimals > 0) {
+      while (text.length < decimals + 1) text = "0" + text;
+      text = text.substring(0, text.length - decimals) + "." + text.substring(text.length - decimals);
+    }
+    return digits < 0 ? "-" + text : text;
+  };
+
+  // decodes a page of the grid in the columnar format into the object
+  // DataTables expects (as the server would otherwise send it as JSON)
+  var decodeColumnarGrid = function (buffer) {
+    var view = new DataView(buffer);
+    var offset = 0;
+    var readU8 = function () {
+      return view.getUint8(offset++);
+    };
+    var readU32 = function () {
+      var value = view.getUint32(offset, true);
+      offset += 4;
+      return value;
+    };
+
+    if (readU32() !== 0x43475352 || readU32() !== 2)
+      throw new Error("Unexpected grid data format.");
+
+    var result = {
+      draw: readU32(),
+      recordsTotal: readU32(),
+      recordsFiltered: readU32(),
+      data: [],
+    };
+    var start = readU32();
+    var rowCount = readU32();
+    var columnCount = readU32();
+
+    var decoder = new TextDecoder("utf-8");
+    var strings = new Array(readU32());
+    for (var i = 0; i < strings.length; i++) {
+      var length = readU32();
+      strings[i] = decoder.decode(new Uint8Array(buffer, offset, length));
+      offset += length;
+    }
+
+    var row;
+    for (row = 0; row < rowCount; row++) result.data.push(new Array(columnCount));
+
+    for (var col = 0; col < columnCount; col++) {
+      var kind = readU8();
+      var decimals = readU8();
+      var width = readU8();
+      for (row = 0; row < rowCount; row++) {
+        if (kind === 0) {
+          // text: an index into the strings; 0xFFFFFFFF is NA, and 0xFFFFFFFE
+          // a row without a name (shown by its number)
+          var index = readU32();
+          result.data[row][col] =
+            index === 0xffffffff ? 0 : index === 0xfffffffe ? start + row : strings[index];
+        } else if (width === 4) {
+          // numbers: the digits of the number as an integer (the smallest
+          // i32 is NA)
+          var digits = view.getInt32(offset, true);
+          offset += 4;
+          result.data[row][col] = digits === -0x80000000 ? 0 : numberText(digits, decimals);
+        } else {
+          // numbers with digits too large for an i32, as f64 (NaN is NA)
+          var largeDigits = view.getFloat64(offset, true);
+          offset += 8;
+          result.data[row][col] = isNaN(largeDigits) ? 0 : numberText(largeDigits, decimals);
+        }
+      }
+
+      // numbers in scientific notation: the exponent of each
+      for (row = 0; kind === 2 && row < rowCount; row++) {
+        var exponent = view.getInt16(offset, true);
+        offset += 2;
+        if (result.data[row][col] === 0) continue;
+        var power = Math.abs(exponent).toString();
+        result.data[row][col] +=
+          (exponent < 0 ? "e-" : "e+") + (power.length < 2 ? "0" : "") + power;
+      }
+    }
+
+    return result;
+  };
+
   // simple HTML escaping (avoid XSS in data)
   var escapeHtml = function (html) {
     if (!html) return "";
@@ -1134,29 +1241,61 @@
     var dataTableColumns = null;
 
     if (!data) {
-      dataTableAjax = {
-        url: "../grid_data",
-        type: "POST",
-        data: function (d) {
-          d.env = env;
-          d.obj = obj;
-          d.cache_key = cacheKey;
-          d.show = "data";
-          d.column_offset = columnOffset;
-          d.max_columns = maxColumns;
-        },
-        error: function (jqXHR) {
-          if (jqXHR.responseText[0] !== "{") showError(jqXHR.responseText);
-          else {
-            var result = $.parseJSON(jqXHR.responseText);
-            if (result.error) {
-              showError(result.error);
-            } else {
-              showError("The data could not be displayed.");
-            }
-          }
-        },
+      var dataTableParams = function (d) {
+        d.env = env;
+        d.obj = obj;
+        d.cache_key = cacheKey;
+        d.show = "data";
+        d.column_offset = columnOffset;
+        d.max_columns = maxColumns;
       };
+
+      if (canDecodeColumnar) {
+        // fetch pages in the columnar format (the server may still answer
+        // with JSON, e.g. for errors)
+        dataTableAjax = function (d, callback) {
+          dataTableParams(d);
+          var xhr = new XMLHttpRequest();
+          xhr.open("POST", "../grid_data");
+          xhr.responseType = "arraybuffer";
+          xhr.setRequestHeader("Content-Type", "application/x-www-form-urlencoded; charset=UTF-8");
+          xhr.setRequestHeader("Accept", columnarContentType + ", application/json");
+          xhr.onload = function () {
+            var contentType = xhr.getResponseHeader("Content-Type") || "";
+            var responseText;
+            try {
+              if (xhr.status === 200 && contentType.indexOf(columnarContentType) === 0) {
+                callback(decodeColumnarGrid(xhr.response));
+                return;
+              }
+              responseText = new TextDecoder("utf-8").decode(new Uint8Array(xhr.response));
+              if (xhr.status === 200) {
+                callback($.parseJSON(responseText));
+                return;
+              }
+            } catch (e) {
+              // a page which can't be read would otherwise leave the grid
+              // waiting for it
+              showDataError("The data could not be displayed: " + e.message);
+              return;
+            }
+            showDataError(responseText, "The data could not be displayed.");
+          };
+          xhr.onerror = function () {
+            showError("The data could not be displayed.");
+          };
+          xhr.send($.param(d));
+        };
+      } else {
+        dataTableAjax = {
+          url: "../grid_data",
+          type: "POST",
+          data: dataTableParams,
+          error: function (jqXHR) {
+            showDataError(jqXHR.responseText, "The data could not be displayed.");
+          },
+        };
+      }
       dataTableColumnDefs = [
         {
           targets: typeIndices["numeric"],
@@ -1271,16 +1410,7 @@
         callback(result);
       })
       .fail(function (jqXHR) {
-        if (jqXHR.responseText[0] !== "{") showError(jqXHR.responseText);
-        else {
-          var result = $.parseJSON(jqXHR.responseText);
-
-          if (result.error) {
-            showError(result.error);
-          } else {
-            showError("The object could not be displayed.");
-          }
-        }
+        showDataError(jqXHR.responseText, "The object could not be displayed.");
       });
   };
 
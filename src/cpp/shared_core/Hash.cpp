@@ -23,38 +23,251 @@
 
 #include <shared_core/Hash.hpp>
 
+#include <algorithm>
 #include <sstream>
 #include <iomanip>
 
-#include <boost/crc.hpp>
-#include <boost/lexical_cast.hpp>
-
 #include <shared_core/SafeConvert.hpp>
 
 namespace rstudio {
 namespace core {
 namespace hash {   
 
+namespace {
+
+// the (reflected) IEEE 802.3 polynomial
+const std::uint32_t kCrc32Polynomial = 0xedb88320;
+
+// multiplies a and b modulo the polynomial (x^0 is represented by the high bit)
+std::uint32_t multiplyModP(std::uint32_t a, std::uint32_t b)
+{
+   std::uint32_t m = 1u << 31;
+   std::uint32_t p = 0;
+   for (;;)
+   {
+      if (a & m)
+      {
+         p ^= b;
+         if ((a & (m - 1)) == 0)
+            break;
+      }
+      m >>= 1;
+      b = (b & 1) ? (b >> 1) ^ kCrc32Polynomial : b >> 1;
+   }
+   return p;
+}
+
+struct Crc32Tables
+{
+   Crc32Tables()
+   {
+      // slice-by-8 tables: slice[k][n] is the crc of byte n followed by k
+      // zero bytes, so eight bytes can be folded in with eight lookups
+      for (std::uint32_t n = 0; n < 256; n++)
+      {
+         std::uint32_t crc = n;
+         for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? (crc >> 1) ^ kCrc32Polynomial : crc >> 1;
+         slice[0][n] = crc;
+      }
+
+      for (std::uint32_t n = 0; n < 256; n++)
+      {
+         for (int k = 1; k < 8; k++)
+            slice[k][n] = (slice[k - 1][n] >> 8) ^ slice[0][slice[k - 1][n] & 0xff];
+      }
+
+      // powers[k] is x^(2^k) modulo the polynomial (used to combine checksums)
+      std::uint32_t power = 1u << 30;
+      for (int k = 0; k < 32; k++)
+      {
+         powers[k] = power;
+         power = multiplyModP(power, power);
+      }
+   }
+
+   std::uint32_t slice[8][256];
+   std::uint32_t powers[32];
+};
+
+const Crc32Tables& crc32Tables()
+{
+   static const Crc32Tables instance;
+   return instance;
+}
+
+// x^(8 * length) modulo the polynomial, i.e. the operator which shifts a
+// checksum over length zero bytes
+std::uint32_t shiftOperator(std::size_t length)
+{
+   const Crc32Tables& tables = crc32Tables();
+   std::uint32_t p = 1u << 31;
+   int k = 3;
+   while (length)
+   {
+      if (length & 1)
+         p = multiplyModP(tables.powers[k & 31], p);
+      length >>= 1;
+      k++;
+   }
+   return p;
+}
+
+inline std::uint32_t readLittleEndian32(const unsigned char* pBytes)
+{
+   return static_cast<std::uint32_t>(pBytes[0]) |
+          static_cast<std::uint32_t>(pBytes[1]) << 8 |
+          static_cast<std::uint32_t>(pBytes[2]) << 16 |
+          static_cast<std::uint32_t>(pBytes[3]) << 24;
+}
+
+} // anonymous namespace
+
+std::uint32_t crc32(const void* data, std::size_t length, std::uint32_t crc)
+{
+   const Crc32Tables& tables = crc32Tables();
+   const unsigned char* pBytes = static_cast<const unsigned char*>(data);
+
+   crc = ~crc;
+
+   // process 8 bytes at a time
+   while (length >= 8)
+   {
+      std::uint32_t low = readLittleEndian32(pBytes) ^ crc;
+      std::uint32_t high = readLittleEndian32(pBytes + 4);
+      crc = tables.slice[7][low & 0xff] ^
+            tables.slice[6][(low >> 8) & 0xff] ^
+            tables.slice[5][(low >> 16) & 0xff] ^
+            tables.slice[4][low >> 24] ^
+            tables.slice[3][high & 0xff] ^
+            tables.slice[2][(high >> 8) & 0xff] ^
+            tables.slice[1][(high >> 16) & 0xff] ^
+            tables.slice[0][high >> 24];
+      pBytes += 8;
+      length -= 8;
+   }
+
+   // then the remaining bytes
+   while (length--)
+      crc = tables.slice[0][(crc ^ *pBytes++) & 0xff] ^ (crc >> 8);
+
+   return ~crc;
+}
+
+std::uint32_t crc32Combine(std::uint32_t crcA, std::uint32_t crcB, std::size_t lengthB)
+{
+   return multiplyModP(shiftOperator(lengthB), crcA) ^ crcB;
+}
+
 std::string crc32Hash(const std::string& content)
 {
-   boost::crc_32_type result;
-   result.process_bytes(content.data(), content.length());
-   return safe_convert::numberToString(result.checksum());
+   return safe_convert::numberToString(crc32(content.data(), content.length()));
 }
 
 std::string crc32HexHash(const std::string& content)
 {
-   // compute checksum
-   boost::crc_32_type result;
-   result.process_bytes(content.data(), content.length());
-
    // return hex representation; ensure padded to 8 characters
    std::ostringstream output;
    output << std::uppercase << std::setw(8) << std::setfill('0') 
-          << std::hex << result.checksum();
+          << std::hex << crc32(content.data(), content.length());
    return output.str();
 }
 
+const std::size_t ChunkedCrc32::kDefaultChunkSize;
+
+ChunkedCrc32::ChunkedCrc32(std::size_t chunkSize)
+   : chunkSize_(chunkSize > 0 ? chunkSize : kDefaultChunkSize),
+     chunkShift_(shiftOperator(chunkSize_))
+{
+}
+
+void ChunkedCrc32::reset(const std::string& content)
+{
+   chunks_.clear();
+   appendChunks(content, 0, content.length(), &chunks_);
+}
+
+void ChunkedCrc32::replace(const std::string& newContent,
+                           std::size_t offset,
+                           std::size_t length,
+                           std::size_t replacementLength)
+{
+   // the replacement must be consistent with the content we know of;
+   // if it isn't then start over
+   std::size_t oldSize = size();
+   if (offset + length > oldSize ||
+       oldSize - length + replacementLength != newContent.length())
+   {
+      reset(newContent);
+      return;
+   }
+
+   // find the first chunk touched by the replacement (an append extends the
+   // last chunk rather than starting a new one)
+   std::size_t first = 0;
+   std::size_t start = 0;
+   while (first < chunks_.size() && start + chunks_[first].length <= offset)
+      start += chunks_[first++].length;
+   if (first == chunks_.size() && first > 0)
+      start -= chunks_[--first].length;
+
+   // find the end of the chunks touched by the replacement
+   std::size_t last = first;
+   std::size_t end = start;
+   while (last < chunks_.size() && (last == first || end < offset + length))
+      end += chunks_[last++].length;
+
+   // absorb the next chunk rather than leave a small one behind
+   std::size_t regionLength = end - start - length + replacementLength;
+   std::size_t remainder = regionLength % chunkSize_;
+   if (remainder != 0 && remainder < chunkSize_ / 2 && last < chunks_.size())
+   {
+      regionLength += chunks_[last].length;
+      end += chunks_[last++].length;
+   }
+
+   // re-hash the region and splice its chunks in
+   std::vector<Chunk> chunks;
+   appendChunks(newContent, start, regionLength, &chunks);
+   chunks_.erase(chunks_.begin() + first, chunks_.begin() + last);
+   chunks_.insert(chunks_.begin() + first, chunks.begin(), chunks.end());
+}
+
+std::uint32_t ChunkedCrc32::checksum() const
+{
+   std::uint32_t crc = 0;
+   for (const Chunk& chunk : chunks_)
+   {
+      std::uint32_t shift = chunk.length == chunkSize_ ? chunkShift_ : shiftOperator(chunk.length);
+      crc = multiplyModP(shift, crc) ^ chunk.crc;
+   }
+   return crc;
+}
+
+std::size_t ChunkedCrc32::size() const
+{
+   std::size_t size = 0;
+   for (const Chunk& chunk : chunks_)
+      size += chunk.length;
+   return size;
+}
+
+void ChunkedCrc32::appendChunks(const std::string& content,
+                                std::size_t offset,
+                                std::size_t length,
+                                std::vector<Chunk>* pChunks) const
+{
+   while (length > 0)
+   {
+      Chunk chunk;
+      chunk.length = std::min(length, chunkSize_);
+      chunk.crc = crc32(content.data() + offset, chunk.length);
+      pChunks->push_back(chunk);
+      offset += chunk.length;
+      length -= chunk.length;
+   }
+}
+
 } // namespace hash
 } // namespace core
 } // namespace rstudio
@@ -0,0 +1,177 @@
+/*
+ * HashTests.cpp
+ *
+ * Copyright (C) 2022 by RStudio, PBC
+ *
+ * Unless you have received this program directly from RStudio pursuant to the terms of a commercial license agreement
+ * with RStudio, then this program is licensed to you under the following terms:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <random>
+
+#include <boost/crc.hpp>
+
+#include <shared_core/Hash.hpp>
+
+namespace rstudio {
+namespace core {
+namespace hash {
+namespace {
+
+std::uint32_t boostCrc32(const std::string& content)
+{
+   boost::crc_32_type result;
+   result.process_bytes(content.data(), content.length());
+   return result.checksum();
+}
+
+std::string randomContent(std::size_t length, std::mt19937* pGenerator)
+{
+   std::uniform_int_distribution<int> distribution(0, 255);
+   std::string content(length, '\0');
+   for (char& ch : content)
+      ch = static_cast<char>(distribution(*pGenerator));
+   return content;
+}
+
+std::uint32_t fastCrc32(const std::string& content)
+{
+   return crc32(content.data(), content.length());
+}
+
+} // anonymous namespace
+
+TEST_CASE("CRC-32")
+{
+   std::mt19937 generator(42);
+
+   SECTION("Known checksums")
+   {
+      CHECK(crc32Hash("") == "0");
+      CHECK(crc32HexHash("123456789") == "CBF43926");
+      CHECK(crc32Hash("The quick brown fox jumps over the lazy dog") == "1095738169");
+   }
+
+   SECTION("Matches boost for all lengths and alignments")
+   {
+      std::string content = randomContent(1024, &generator);
+      for (std::size_t offset = 0; offset < 8; offset++)
+      {
+         for (std::size_t length = 0; offset + length <= content.length(); length += 7)
+         {
+            std::string slice = content.substr(offset, length);
+            REQUIRE(crc32(content.data() + offset, length) == boostCrc32(slice));
+         }
+      }
+   }
+
+   SECTION("Checksums can be continued and combined")
+   {
+      std::string a = randomContent(1000, &generator);
+      std::string b = randomContent(3333, &generator);
+      std::uint32_t crcA = crc32(a.data(), a.length());
+      std::uint32_t crcB = crc32(b.data(), b.length());
+      std::uint32_t expected = boostCrc32(a + b);
+
+      CHECK(crc32(b.data(), b.length(), crcA) == expected);
+      CHECK(crc32Combine(crcA, crcB, b.length()) == expected);
+      CHECK(crc32Combine(crcA, 0, 0) == crcA);
+      CHECK(crc32Combine(0, crcB, b.length()) == crcB);
+   }
+
+   SECTION("Chunked checksums follow range replacements")
+   {
+      std::string content = randomContent(10000, &generator);
+      ChunkedCrc32 chunked(256);
+      chunked.reset(content);
+      CHECK(chunked.checksum() == boostCrc32(content));
+
+      std::uniform_int_distribution<std::size_t> lengths(0, 600);
+      for (int i = 0; i < 500; i++)
+      {
+         std::uniform_int_distribution<std::size_t> offsets(0, content.length());
+         std::size_t offset = offsets(generator);
+         std::size_t length = std::min(lengths(generator), content.length() - offset);
+         std::string replacement = randomContent(lengths(generator) / (i % 4 + 1), &generator);
+
+         content.replace(offset, length, replacement);
+         chunked.replace(content, offset, length, replacement.length());
+         REQUIRE(chunked.size() == content.length());
+         REQUIRE(chunked.checksum() == boostCrc32(content));
+      }
+
+      // appending to and clearing the content
+      content.append("appended");
+      chunked.replace(content, content.length() - 8, 0, 8);
+      CHECK(chunked.checksum() == boostCrc32(content));
+
+      std::size_t length = content.length();
+      content.clear();
+      chunked.replace(content, 0, length, 0);
+      CHECK(chunked.checksum() == 0);
+   }
+
+   SECTION("Chunked checksums start over after an inconsistent replacement")
+   {
+      ChunkedCrc32 chunked;
+      chunked.reset("hello");
+      chunked.replace("hello, world", 10, 0, 7);
+      CHECK(chunked.checksum() == boostCrc32("hello, world"));
+   }
+
+   SECTION("Large documents match the reference checksum")
+   {
+      // a document of the size of a large script or notebook
+      std::string content = randomContent(4 * 1024 * 1024, &generator);
+      CHECK(fastCrc32(content) == boostCrc32(content));
+
+      // combining the checksums of its pieces gives the same result, however
+      // they're grouped
+      std::string a = content.substr(0, 1000000);
+      std::string b = content.substr(1000000, 3);
+      std::string c = content.substr(1000003);
+      std::uint32_t crcA = fastCrc32(a), crcB = fastCrc32(b), crcC = fastCrc32(c);
+      CHECK(crc32Combine(crc32Combine(crcA, crcB, b.length()), crcC, c.length()) ==
+            boostCrc32(content));
+      CHECK(crc32Combine(crcA, crc32Combine(crcB, crcC, c.length()), b.length() + c.length()) ==
+            boostCrc32(content));
+   }
+
+   SECTION("Incremental updates of a large document match rehashing it")
+   {
+      std::string content = randomContent(4 * 1024 * 1024, &generator);
+      ChunkedCrc32 chunked;
+      chunked.reset(content);
+
+      std::uniform_int_distribution<std::size_t> offsets(0, content.length() - 1);
+      for (int i = 0; i < 100; i++)
+      {
+         std::size_t offset = offsets(generator);
+         content.replace(offset, 1, "ab");
+         chunked.replace(content, offset, 1, 2);
+      }
+
+      CHECK(chunked.size() == content.length());
+      CHECK(chunked.checksum() == boostCrc32(content));
+   }
+}
+
+} // end namespace hash
+} // end namespace core
+} // end namespace rstudio
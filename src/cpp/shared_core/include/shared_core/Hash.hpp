@@ -24,7 +24,10 @@
 #ifndef SHARED_CORE_HASH_HPP
 #define SHARED_CORE_HASH_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace rstudio {
 namespace core {
@@ -34,6 +37,58 @@ std::string crc32Hash(const std::string& content);
 
 std::string crc32HexHash(const std::string& content);
 
+// CRC-32 (the IEEE 802.3 polynomial, as used by zlib and boost::crc_32_type) of
+// a buffer. Pass the checksum of preceding data as crc to continue it.
+std::uint32_t crc32(const void* data, std::size_t length, std::uint32_t crc = 0);
+
+// CRC-32 of the concatenation A + B, given the CRC-32 of A, the CRC-32 of B and
+// the length of B (neither buffer needs to be re-read).
+std::uint32_t crc32Combine(std::uint32_t crcA, std::uint32_t crcB, std::size_t lengthB);
+
+// The CRC-32 of content held as a sequence of chunks, each with its own
+// checksum. Replacing a range of the content only re-hashes the chunks it
+// touches, and the checksum of the whole is combined from the chunk checksums.
+class ChunkedCrc32
+{
+public:
+   static const std::size_t kDefaultChunkSize = 32 * 1024;
+
+   explicit ChunkedCrc32(std::size_t chunkSize = kDefaultChunkSize);
+
+   // computes the chunk checksums of content
+   void reset(const std::string& content);
+
+   // updates the chunk checksums after a content.replace(offset, length, ...)
+   // which inserted replacementLength bytes; newContent is the content as of
+   // after the replacement
+   void replace(const std::string& newContent,
+                std::size_t offset,
+                std::size_t length,
+                std::size_t replacementLength);
+
+   // the CRC-32 of the whole content (the same as crc32() of the content)
+   std::uint32_t checksum() const;
+
+   // the length of the content
+   std::size_t size() const;
+
+private:
+   struct Chunk
+   {
+      std::size_t length;
+      std::uint32_t crc;
+   };
+
+   void appendChunks(const std::string& content,
+                     std::size_t offset,
+                     std::size_t length,
+                     std::vector<Chunk>* pChunks) const;
+
+   std::size_t chunkSize_;
+   std::uint32_t chunkShift_;
+   std::vector<Chunk> chunks_;
+};
+
 } // namespace hash
 } // namespace core 
 } // namespace rstudio
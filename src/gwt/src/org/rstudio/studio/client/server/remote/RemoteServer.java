@@ -6130,6 +6130,17 @@ public class RemoteServer implements Server
       sendRequest(RPC_SCOPE, "set_job_listening", params, callback);
    }
 
+   @Override
+   public void getJobOutputBefore(String id, int before, int count,
+                                  ServerRequestCallback<JsArray<JobOutput>> callback)
+   {
+      JSONArray params = new JSONArray();
+      params.set(0, new JSONString(id));
+      params.set(1, new JSONNumber(before));
+      params.set(2, new JSONNumber(count));
+      sendRequest(RPC_SCOPE, "job_output_before", params, callback);
+   }
+
    @Override
    public void executeJobAction(String id, String action,
                                 ServerRequestCallback<Void> callback)
@@ -23,6 +23,8 @@ public interface JobsServerOperations
 {
    void setJobListening(String id, boolean listening, boolean bypassLauncherCall,
                         ServerRequestCallback<JsArray<JobOutput> > output);
+   void getJobOutputBefore(String id, int before, int count,
+                           ServerRequestCallback<JsArray<JobOutput> > output);
    void startJob(JobLaunchSpec spec, ServerRequestCallback<String> callback);
    void clearJobs(ServerRequestCallback<Void> callback);
    void executeJobAction(String id, String action, ServerRequestCallback<Void> callback);